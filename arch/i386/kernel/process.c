@@ -64,6 +64,9 @@ asmlinkage int sys_idle(void)
 	/* endless idle loop with no priority at all */
 	current->counter = -100;
 	for (;;) {
+		/* clear pages for later while there's nothing else to do */
+		while (!need_resched && zero_pool_fill())
+			/* nothing */;
 		if (hlt_works_ok && !hlt_counter && !need_resched)
 			__asm__("hlt");
 		schedule();
@@ -257,6 +260,15 @@ asmlinkage int sys_fork(struct pt_regs regs)
 	return do_fork(COPYVM | SIGCHLD, regs.esp, &regs);
 }
 
+/*
+ * vfork() doesn't copy anything: the child runs in our memory until it
+ * calls execve() or _exit(), and we sleep until then.
+ */
+asmlinkage int sys_vfork(struct pt_regs regs)
+{
+	return do_fork(COPYVFORK | SIGCHLD, regs.esp, &regs);
+}
+
 asmlinkage int sys_clone(struct pt_regs regs)
 {
 #ifdef CLONE_ACTUALLY_WORKS_OK
@@ -615,6 +615,48 @@ void ll_rw_page(int rw, int dev, int page, char * buffer)
 	down(&sem);
 }
 
+/*
+ * Like ll_rw_page(), but for 'nr' consecutive pages of the device, each
+ * with its own buffer.  All the requests are queued before we wait, so
+ * the driver gets them back to back instead of one per disk revolution.
+ * The semaphore starts at 1-nr and lets us through after the last one.
+ */
+void ll_rw_pages(int rw, int dev, int page, char ** buffers, int nr)
+{
+	struct request * req;
+	unsigned int major = MAJOR(dev);
+	struct semaphore sem = MUTEX_LOCKED;
+	int i;
+
+	if (major >= MAX_BLKDEV || !(blk_dev[major].request_fn)) {
+		printk("Trying to read nonexistent block-device %04x (%d)\n",dev,page*8);
+		return;
+	}
+	if (rw!=READ && rw!=WRITE)
+		panic("Bad block dev command, must be R/W");
+	if (rw == WRITE && is_read_only(dev)) {
+		printk("Can't page to read-only device 0x%X\n",dev);
+		return;
+	}
+	sem.count = 1 - nr;
+	for (i = 0; i < nr; i++) {
+		cli();
+		req = get_request_wait(NR_REQUEST, dev);
+		sti();
+		req->cmd = rw;
+		req->errors = 0;
+		req->sector = (page + i) << 3;
+		req->nr_sectors = 8;
+		req->current_nr_sectors = 8;
+		req->buffer = buffers[i];
+		req->sem = &sem;
+		req->bh = NULL;
+		req->next = NULL;
+		add_request(major+blk_dev,req);
+	}
+	down(&sem);
+}
+
 /* This function can be used to request a number of buffers from a block
    device. Currently the only restriction is that all buffers must belong to
    the same device */
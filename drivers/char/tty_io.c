@@ -1750,7 +1750,7 @@ void do_SAK( struct tty_struct *tty)
 		    ((session > 0) && ((*p)->session == session)))
 			send_sig(SIGKILL, *p, 1);
 		else {
-			for (i=0; i < NR_OPEN; i++) {
+			for (i=0; i < (*p)->files->max_fds; i++) {
 				filp = (*p)->files->fd[i];
 				if (filp && (filp->f_op == &tty_fops) &&
 				    (filp->private_data == tty)) {
@@ -174,22 +174,129 @@ unsigned long * create_elf_tables(char * p,int argc,int envc,struct elfhdr * exe
 }
 
 
+/*
+ * What exec reads out of an ELF file besides the pages it maps: the first
+ * 128 bytes, the program headers and the name of the interpreter.  It is
+ * kept in the exec cache, so a binary that is run over and over, and the
+ * ld.so behind it, are only read and checked once.
+ */
+struct elf_cached {
+	char buf[128];		/* the start of the file, as bprm->buf */
+	int phsize;		/* bytes of program headers following */
+	int interp_len;		/* then the interpreter's name; 0 if none */
+};
+
+#define ELF_CACHED_PHDR(c)	((struct elf_phdr *) ((c) + 1))
+#define ELF_CACHED_INTERP(c)	((char *) ELF_CACHED_PHDR(c) + (c)->phsize)
+
+/*
+ * Look up an executable or interpreter in the exec cache, reading it on
+ * a miss.  'buf' holds the first 128 bytes of the file if 'have_buf' is
+ * set, and is filled in otherwise.  A file that isn't ELF gets an entry
+ * with no program headers, which is all an a.out interpreter needs.
+ */
+static struct exec_cache * elf_cache_get(struct inode * inode, char * buf,
+	int have_buf, int * error)
+{
+	struct elfhdr * ex = (struct elfhdr *) buf;
+	struct exec_cache * ec;
+	struct elf_cached * c;
+	struct elf_phdr * phdr = NULL, * ppnt;
+	int phsize = 0, interp_len = 0;
+	int old_fs, retval, i, keep = 1;
+	unsigned long gen;
+
+	ec = exec_cache_find(inode, &elf_format);
+	if (ec) {
+		if (!have_buf)
+			memcpy(buf, ((struct elf_cached *) EXEC_CACHE_DATA(ec))->buf, 128);
+		return ec;
+	}
+
+	gen = exec_cache_gen;
+	old_fs = get_fs();
+	set_fs(get_ds());
+	retval = 0;
+	if (!have_buf)
+		retval = read_exec(inode, 0, buf, 128);
+	if (retval >= 0 && ex->e_ident[0] == 0x7f &&
+	    strncmp(&ex->e_ident[1], "ELF", 3) == 0) {
+		phsize = ex->e_phentsize * ex->e_phnum;
+		retval = -ENOEXEC;
+		if (ex->e_phentsize == sizeof(struct elf_phdr) &&
+		    phsize > 0 && phsize <= PAGE_SIZE) {
+			retval = -ENOMEM;
+			phdr = (struct elf_phdr *) kmalloc(phsize, GFP_KERNEL);
+		}
+		if (phdr) {
+			retval = read_exec(inode, ex->e_phoff, (char *) phdr, phsize);
+			if (retval >= 0 && retval != phsize)
+				retval = -ENOEXEC;
+		}
+		for (i = 0, ppnt = phdr; retval >= 0 && i < ex->e_phnum; i++, ppnt++)
+			if (ppnt->p_type == PT_INTERP) {
+				interp_len = ppnt->p_filesz;
+				if (interp_len <= 0 || interp_len > PAGE_SIZE)
+					retval = -ENOEXEC;
+				break;
+			}
+	}
+	ec = NULL;
+	if (retval >= 0) {
+		retval = -ENOMEM;
+		ec = exec_cache_alloc(sizeof(*c) + phsize + interp_len);
+	}
+	if (ec) {
+		c = (struct elf_cached *) EXEC_CACHE_DATA(ec);
+		memcpy(c->buf, buf, 128);
+		c->phsize = phsize;
+		c->interp_len = interp_len;
+		if (phsize)
+			memcpy(ELF_CACHED_PHDR(c), phdr, phsize);
+		retval = 0;
+		if (interp_len) {
+			retval = read_exec(inode, ppnt->p_offset,
+					   ELF_CACHED_INTERP(c), interp_len);
+			ELF_CACHED_INTERP(c)[interp_len - 1] = '\0';
+		}
+		/*
+		 * Our caller read 'buf' before we noted exec_cache_gen: read
+		 * it again, and only keep the entry if nothing has changed.
+		 */
+		if (retval >= 0 && have_buf) {
+			memset(c->buf, 0, 128);
+			if (read_exec(inode, 0, c->buf, 128) < 0 ||
+			    memcmp(c->buf, buf, 128))
+				keep = 0;
+		}
+		if (retval < 0) {
+			exec_cache_put(ec);
+			ec = NULL;
+		} else if (keep)
+			exec_cache_add(ec, inode, &elf_format, gen);
+	}
+	set_fs(old_fs);
+	if (phdr)
+		kfree(phdr);
+	*error = retval;
+	return ec;
+}
+
 /* This is much more generalized than the library routine read function,
    so we keep this separate.  Technically the library read function
    is only provided so that we can read a.out libraries that have
    an ELF header */
 
 static unsigned int load_elf_interp(struct elfhdr * interp_elf_ex,
-			     struct inode * interpreter_inode)
+			     struct inode * interpreter_inode,
+			     struct elf_phdr * elf_phdata)
 {
         struct file * file;
-	struct elf_phdr *elf_phdata  =  NULL;
 	struct elf_phdr *eppnt;
 	unsigned int len;
 	unsigned int load_addr;
 	int elf_exec_fileno;
 	int elf_bss;
-	int old_fs, retval;
 	unsigned int last_bss;
 	int error;
 	int i, k;
@@ -207,21 +314,11 @@ static unsigned int load_elf_interp(struct elfhdr * interp_elf_ex,
 		return 0xffffffff;
 	};
 	
-	/* Now read in all of the header information */
+	/* The header information comes from the exec cache */
 	
-	if(sizeof(struct elf_phdr) * interp_elf_ex->e_phnum > PAGE_SIZE) 
+	if(!elf_phdata)
 	    return 0xffffffff;
 	
-	elf_phdata =  (struct elf_phdr *) 
-		kmalloc(sizeof(struct elf_phdr) * interp_elf_ex->e_phnum, GFP_KERNEL);
-	if(!elf_phdata) return 0xffffffff;
-	
-	old_fs = get_fs();
-	set_fs(get_ds());
-	retval = read_exec(interpreter_inode, interp_elf_ex->e_phoff, (char *) elf_phdata,
-			   sizeof(struct elf_phdr) * interp_elf_ex->e_phnum);
-	set_fs(old_fs);
-	
 	elf_exec_fileno = open_inode(interpreter_inode, O_RDONLY);
 	if (elf_exec_fileno < 0) return 0xffffffff;
 	file = current->files->fd[elf_exec_fileno];
@@ -249,10 +346,8 @@ static unsigned int load_elf_interp(struct elfhdr * interp_elf_ex,
 
 	
 	SYS(close)(elf_exec_fileno);
-	if(error < 0 && error > -1024) {
-	        kfree(elf_phdata);
+	if(error < 0 && error > -1024)
 		return 0xffffffff;
-	}
 
 	padzero(elf_bss);
 	len = (elf_bss + 0xfff) & 0xfffff000; /* What we have mapped so far */
@@ -262,7 +357,6 @@ static unsigned int load_elf_interp(struct elfhdr * interp_elf_ex,
 	  do_mmap(NULL, len, last_bss-len,
 		  PROT_READ|PROT_WRITE|PROT_EXEC,
 		  MAP_FIXED|MAP_PRIVATE, 0);
-	kfree(elf_phdata);
 
 	return ((unsigned int) interp_elf_ex->e_entry) + load_addr;
 }
@@ -329,6 +423,8 @@ static int load_elf_binary(struct linux_binprm * bprm, struct pt_regs * regs)
 	int old_fs;
 	int error;
 	struct elf_phdr * elf_ppnt, *elf_phdata;
+	struct exec_cache * ec, * interp_ec = NULL;
+	struct elf_cached * cached, * interp_cached;
 	int elf_exec_fileno;
 	unsigned int elf_bss, k, elf_brk;
 	int retval;
@@ -362,21 +458,15 @@ static int load_elf_binary(struct linux_binprm * bprm, struct pt_regs * regs)
 		return -ENOEXEC;
 	};
 	
-	/* Now read in all of the header information */
-	
-	elf_phdata = (struct elf_phdr *) kmalloc(elf_ex.e_phentsize * 
-						 elf_ex.e_phnum, GFP_KERNEL);
+	/* Now get all of the header information, from the exec cache if we can */
 	
-	old_fs = get_fs();
-	set_fs(get_ds());
-	retval = read_exec(bprm->inode, elf_ex.e_phoff, (char *) elf_phdata,
-			   elf_ex.e_phentsize * elf_ex.e_phnum);
-	set_fs(old_fs);
-	if (retval < 0) {
-	        kfree (elf_phdata);
+	ec = elf_cache_get(bprm->inode, bprm->buf, 1, &retval);
+	if (!ec) {
 		MOD_DEC_USE_COUNT;
 		return retval;
 	}
+	cached = (struct elf_cached *) EXEC_CACHE_DATA(ec);
+	elf_phdata = ELF_CACHED_PHDR(cached);
 	
 	elf_ppnt = elf_phdata;
 	
@@ -386,7 +476,7 @@ static int load_elf_binary(struct linux_binprm * bprm, struct pt_regs * regs)
 	elf_exec_fileno = open_inode(bprm->inode, O_RDONLY);
 
 	if (elf_exec_fileno < 0) {
-	        kfree (elf_phdata);
+	        exec_cache_put(ec);
 		MOD_DEC_USE_COUNT;
 		return elf_exec_fileno;
 	}
@@ -403,15 +493,12 @@ static int load_elf_binary(struct linux_binprm * bprm, struct pt_regs * regs)
 	set_fs(get_ds());
 	
 	for(i=0;i < elf_ex.e_phnum; i++){
-		if(elf_ppnt->p_type == PT_INTERP) {
+		if(elf_ppnt->p_type == PT_INTERP && !elf_interpreter) {
 			/* This is the program interpreter used for shared libraries - 
 			   for now assume that this is an a.out format binary */
 			
-			elf_interpreter = (char *) kmalloc(elf_ppnt->p_filesz, 
-							   GFP_KERNEL);
-			
-			retval = read_exec(bprm->inode,elf_ppnt->p_offset,elf_interpreter,
-					   elf_ppnt->p_filesz);
+			elf_interpreter = ELF_CACHED_INTERP(cached);
+			retval = 0;
 			/* If the program interpreter is one of these two,
 			   then assume an iBCS2 image. Otherwise assume
 			   a native linux image. */
@@ -424,7 +511,8 @@ static int load_elf_binary(struct linux_binprm * bprm, struct pt_regs * regs)
 			if(retval >= 0)
 				retval = namei(elf_interpreter, &interpreter_inode);
 			if(retval >= 0)
-				retval = read_exec(interpreter_inode,0,bprm->buf,128);
+				interp_ec = elf_cache_get(interpreter_inode,
+							  bprm->buf, 0, &retval);
 			
 			if(retval >= 0){
 				interp_ex = *((struct exec *) bprm->buf);		/* exec-header */
@@ -432,8 +520,7 @@ static int load_elf_binary(struct linux_binprm * bprm, struct pt_regs * regs)
 				
 			};
 			if(retval < 0) {
-			  kfree (elf_phdata);
-			  kfree(elf_interpreter);
+			  exec_cache_put(ec);
 			  MOD_DEC_USE_COUNT;
 			  return retval;
 			};
@@ -447,8 +534,7 @@ static int load_elf_binary(struct linux_binprm * bprm, struct pt_regs * regs)
 	if(elf_interpreter){
 	        interpreter_type = INTERPRETER_ELF | INTERPRETER_AOUT;
 		if(retval < 0) {
-			kfree(elf_interpreter);
-			kfree(elf_phdata);
+			exec_cache_put(ec);
 			MOD_DEC_USE_COUNT;
 			return -ELIBACC;
 		};
@@ -464,8 +550,8 @@ static int load_elf_binary(struct linux_binprm * bprm, struct pt_regs * regs)
 
 		if(!interpreter_type)
 		  {
-		    kfree(elf_interpreter);
-		    kfree(elf_phdata);
+		    exec_cache_put(interp_ec);
+		    exec_cache_put(ec);
 		    MOD_DEC_USE_COUNT;
 		    return -ELIBBAD;
 		  };
@@ -487,10 +573,9 @@ static int load_elf_binary(struct linux_binprm * bprm, struct pt_regs * regs)
 		  };
 		};
 		if (!bprm->p) {
-		        if(elf_interpreter) {
-			      kfree(elf_interpreter);
-			}
-		        kfree (elf_phdata);
+		        if(interp_ec)
+			      exec_cache_put(interp_ec);
+		        exec_cache_put(ec);
 			MOD_DEC_USE_COUNT;
 			return -E2BIG;
 		}
@@ -522,7 +607,7 @@ static int load_elf_binary(struct linux_binprm * bprm, struct pt_regs * regs)
 	elf_ppnt = elf_phdata;
 	for(i=0;i < elf_ex.e_phnum; i++){
 		
-		if(elf_ppnt->p_type == PT_INTERP) {
+		if(elf_ppnt->p_type == PT_INTERP && interp_ec) {
 			/* Set these up so that we are able to load the interpreter */
 		  /* Now load the interpreter into user address space */
 		  set_fs(old_fs);
@@ -530,18 +615,22 @@ static int load_elf_binary(struct linux_binprm * bprm, struct pt_regs * regs)
 		  if(interpreter_type & 1) elf_entry = 
 		    load_aout_interp(&interp_ex, interpreter_inode);
 
+		  interp_cached = (struct elf_cached *) EXEC_CACHE_DATA(interp_ec);
 		  if(interpreter_type & 2) elf_entry = 
-		    load_elf_interp(&interp_elf_ex, interpreter_inode);
+		    load_elf_interp(&interp_elf_ex, interpreter_inode,
+				    interp_cached->phsize ?
+				    ELF_CACHED_PHDR(interp_cached) : NULL);
 
 		  old_fs = get_fs();
 		  set_fs(get_ds());
 
 		  iput(interpreter_inode);
-		  kfree(elf_interpreter);
+		  exec_cache_put(interp_ec);
+		  interp_ec = NULL;
 			
 		  if(elf_entry == 0xffffffff) { 
 		    printk("Unable to load interpreter\n");
-		    kfree(elf_phdata);
+		    exec_cache_put(ec);
 		    send_sig(SIGSEGV, current, 0);
 		    MOD_DEC_USE_COUNT;
 		    return 0;
@@ -578,7 +667,7 @@ static int load_elf_binary(struct linux_binprm * bprm, struct pt_regs * regs)
 	};
 	set_fs(old_fs);
 	
-	kfree(elf_phdata);
+	exec_cache_put(ec);
 	
 	if(interpreter_type != INTERPRETER_AOUT) SYS(close)(elf_exec_fileno);
 	current->personality = (ibcs2_interpreter ? PER_SVR4 : PER_LINUX);
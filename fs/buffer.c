@@ -368,7 +368,7 @@ asmlinkage int sys_fsync(unsigned int fd)
 	struct file * file;
 	struct inode * inode;
 
-	if (fd>=NR_OPEN || !(file=current->files->fd[fd]) || !(inode=file->f_inode))
+	if (fd >= current->files->max_fds || !(file=current->files->fd[fd]) || !(inode=file->f_inode))
 		return -EBADF;
 	if (!file->f_op || !file->f_op->fsync)
 		return -EINVAL;
@@ -1333,6 +1333,35 @@ static inline unsigned long try_to_share_buffers(unsigned long address,
 	return try_to_load_aligned(address, dev, b, size);
 }
 
+/*
+ * Return the buffer page that holds blocks b[] if they are all in the
+ * cache, up to date and laid out in page order, with a reference taken
+ * on it; 0 otherwise.  This doesn't sleep and doesn't read anything: it
+ * is for mapping pages that happen to be around already.
+ */
+unsigned long get_cached_page(dev_t dev, int b[], int size)
+{
+	struct buffer_head * bh;
+	unsigned long page = 0;
+	unsigned long offset;
+
+	for (offset = 0 ; offset < PAGE_SIZE ; offset += size) {
+		if (!*b)
+			return 0;
+		bh = find_buffer(dev, *b++, size);
+		if (!bh || !bh->b_uptodate || bh->b_lock)
+			return 0;
+		if (!offset) {
+			page = (unsigned long) bh->b_data;
+			if (page & ~PAGE_MASK)
+				return 0;
+		} else if (page + offset != (unsigned long) bh->b_data)
+			return 0;
+	}
+	mem_map[MAP_NR(page)]++;
+	return page;
+}
+
 /*
  * bread_page reads four buffers into memory at the desired address. It's
  * a function of its own, as there is some speed to be got by reading them
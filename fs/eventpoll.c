@@ -0,0 +1,494 @@
+/*
+ *  linux/fs/eventpoll.c
+ *
+ *  Persistent interest sets (epoll_create/epoll_ctl/epoll_wait).
+ *
+ *  select() rebuilds its wait table and calls every file's select routine
+ *  on every call, so its cost grows with the number of descriptors even
+ *  when only one of them is ready.  Here the interest set is kept in the
+ *  kernel: each watched file is hooked into its wait queues once, with a
+ *  wait_queue entry whose func puts the item on a ready list when the
+ *  queue is woken.  epoll_wait() then only re-checks the items on that
+ *  list, so a wait costs O(ready) instead of O(n).
+ *
+ *  Readiness is level-triggered: an item that is still ready after it
+ *  has been reported stays on the ready list for the next epoll_wait().
+ */
+
+#include <linux/types.h>
+#include <linux/fs.h>
+#include <linux/kernel.h>
+#include <linux/sched.h>
+#include <linux/stat.h>
+#include <linux/fcntl.h>
+#include <linux/errno.h>
+#include <linux/malloc.h>
+#include <linux/mm.h>
+#include <linux/eventpoll.h>
+
+#include <asm/segment.h>
+#include <asm/system.h>
+
+#define ROUND_UP(x,y) (((x)+(y)-1)/(y))
+
+#define EP_HASH(file,fd) \
+	((((unsigned long) (file) >> 4) ^ (fd)) & (EP_HASH_SIZE-1))
+
+#define EP_ITEM(table) \
+	((struct epitem *) ((char *) (table) - (unsigned long) &((struct epitem *) 0)->table))
+
+static struct file_operations eventpoll_fops;
+
+/*
+ * Called from wake_up()/wake_up_interruptible(), possibly from an
+ * interrupt: queue the item (once) and wake whoever is in epoll_wait().
+ */
+static void ep_poll_callback(struct wait_queue * wait)
+{
+	struct epitem * item = ((struct ep_wait *) wait)->item;
+	struct eventpoll * ep = item->ep;
+	unsigned long flags;
+
+	save_flags(flags);
+	cli();
+	if (!item->ready && (item->events & ~EPOLLONESHOT)) {
+		item->ready = 1;
+		item->rdnext = NULL;
+		*ep->rdtail = item;
+		ep->rdtail = &item->rdnext;
+	}
+	restore_flags(flags);
+	wake_up_interruptible(&ep->wait);
+}
+
+/*
+ * select_wait() hook: hook the item into a wait queue, unless it is
+ * already there (sockets use the same queue for every sel_type).
+ */
+static void ep_queue(struct wait_queue ** whead, select_table * table)
+{
+	struct epitem * item = EP_ITEM(table);
+	struct ep_wait * w;
+
+	for (w = item->waits; w; w = w->next)
+		if (w->whead == whead)
+			return;
+	w = (struct ep_wait *) kmalloc(sizeof(*w), GFP_KERNEL);
+	if (!w)
+		return;
+	w->wait.task = NULL;
+	w->wait.next = NULL;
+	w->wait.func = ep_poll_callback;
+	w->whead = whead;
+	w->item = item;
+	w->next = item->waits;
+	item->waits = w;
+	add_wait_queue(whead, &w->wait);
+}
+
+/*
+ * Ask the file which of the requested events are ready, hooking the
+ * item into the file's wait queues for those that are not.  The second
+ * select call closes the window between the check and the hookup, in
+ * the same way as check() in fs/select.c.
+ */
+static unsigned long ep_item_poll(struct epitem * item)
+{
+	struct file * file = item->file;
+	struct inode * inode = file->f_inode;
+	int (*select) (struct inode *, struct file *, int, select_table *);
+	unsigned long revents = 0;
+
+	if (!file->f_op || !(select = file->f_op->select))
+		return item->events & (EPOLLIN | EPOLLOUT);
+	if ((item->events & EPOLLIN) &&
+	    (select(inode, file, SEL_IN, &item->table) ||
+	     select(inode, file, SEL_IN, NULL)))
+		revents |= EPOLLIN;
+	if ((item->events & EPOLLOUT) &&
+	    (select(inode, file, SEL_OUT, &item->table) ||
+	     select(inode, file, SEL_OUT, NULL)))
+		revents |= EPOLLOUT;
+	if ((item->events & EPOLLPRI) &&
+	    (select(inode, file, SEL_EX, &item->table) ||
+	     select(inode, file, SEL_EX, NULL)))
+		revents |= EPOLLPRI;
+	return revents;
+}
+
+static void ep_add_ready(struct eventpoll * ep, struct epitem * item)
+{
+	unsigned long flags;
+
+	save_flags(flags);
+	cli();
+	if (!item->ready) {
+		item->ready = 1;
+		item->rdnext = NULL;
+		*ep->rdtail = item;
+		ep->rdtail = &item->rdnext;
+	}
+	restore_flags(flags);
+}
+
+static void ep_del_ready(struct eventpoll * ep, struct epitem * item)
+{
+	struct epitem ** p;
+	unsigned long flags;
+
+	save_flags(flags);
+	cli();
+	if (item->ready) {
+		for (p = &ep->rdlist; *p; p = &(*p)->rdnext) {
+			if (*p != item)
+				continue;
+			*p = item->rdnext;
+			if (ep->rdtail == &item->rdnext)
+				ep->rdtail = p;
+			break;
+		}
+		item->ready = 0;
+	}
+	restore_flags(flags);
+}
+
+static struct epitem * ep_find(struct eventpoll * ep, struct file * file, int fd)
+{
+	struct epitem * item;
+
+	for (item = ep->hash[EP_HASH(file,fd)]; item; item = item->next)
+		if (item->file == file && item->fd == fd)
+			return item;
+	return NULL;
+}
+
+static void ep_remove(struct eventpoll * ep, struct epitem * item)
+{
+	struct epitem ** p;
+	struct ep_wait * w;
+
+	while ((w = item->waits) != NULL) {
+		item->waits = w->next;
+		remove_wait_queue(w->whead, &w->wait);
+		kfree_s(w, sizeof(*w));
+	}
+	ep_del_ready(ep, item);
+	for (p = &ep->hash[EP_HASH(item->file,item->fd)]; *p; p = &(*p)->next)
+		if (*p == item) {
+			*p = item->next;
+			break;
+		}
+	for (p = &item->file->f_epitems; *p; p = &(*p)->fnext)
+		if (*p == item) {
+			*p = item->fnext;
+			break;
+		}
+	ep->nitems--;
+	kfree_s(item, sizeof(*item));
+}
+
+static int ep_insert(struct eventpoll * ep, struct file * file, int fd,
+	unsigned long events, unsigned long data)
+{
+	struct epitem * item;
+	int hash = EP_HASH(file,fd);
+
+	item = (struct epitem *) kmalloc(sizeof(*item), GFP_KERNEL);
+	if (!item)
+		return -ENOMEM;
+	item->ep = ep;
+	item->file = file;
+	item->fd = fd;
+	item->ready = 0;
+	item->rdnext = NULL;
+	item->events = events;
+	item->data = data;
+	item->waits = NULL;
+	item->table.nr = 0;
+	item->table.entry = NULL;
+	item->table.queue = ep_queue;
+	item->next = ep->hash[hash];
+	ep->hash[hash] = item;
+	item->fnext = file->f_epitems;
+	file->f_epitems = item;
+	ep->nitems++;
+	if (ep_item_poll(item))
+		ep_add_ready(ep, item);
+	return 0;
+}
+
+/*
+ * Pull the ready list and report what is really ready.  Items that
+ * are not ready any more just drop off the list (they stay hooked into
+ * their wait queues); items that are get queued again, so a
+ * level-triggered descriptor is seen again by the next call.
+ */
+static int ep_collect(struct eventpoll * ep, struct epoll_event * events, int maxevents)
+{
+	struct epitem * list, * item, ** tail;
+	unsigned long flags, revents;
+	int count = 0;
+
+	save_flags(flags);
+	cli();
+	list = ep->rdlist;
+	ep->rdlist = NULL;
+	ep->rdtail = &ep->rdlist;
+	restore_flags(flags);
+
+	while ((item = list) != NULL && count < maxevents) {
+		list = item->rdnext;
+		item->ready = 0;
+		revents = ep_item_poll(item);
+		if (!revents)
+			continue;
+		put_fs_long(revents, &events[count].events);
+		put_fs_long(item->data, &events[count].data);
+		count++;
+		if (item->events & EPOLLONESHOT)
+			item->events = EPOLLONESHOT;
+		else
+			ep_add_ready(ep, item);
+	}
+
+	/* whatever we did not get to goes back in front, in order */
+	if (list) {
+		save_flags(flags);
+		cli();
+		for (tail = &list; *tail; tail = &(*tail)->rdnext)
+			/* nothing */;
+		*tail = ep->rdlist;
+		if (ep->rdtail == &ep->rdlist)
+			ep->rdtail = tail;
+		ep->rdlist = list;
+		restore_flags(flags);
+	}
+	return count;
+}
+
+static int eventpoll_select(struct inode * inode, struct file * file,
+	int sel_type, select_table * wait)
+{
+	struct eventpoll * ep = (struct eventpoll *) file->private_data;
+
+	if (sel_type != SEL_IN)
+		return 0;
+	if (ep->rdlist)
+		return 1;
+	select_wait(&ep->wait, wait);
+	return 0;
+}
+
+/*
+ * The set is freed when the file is closed and nobody in
+ * eventpoll_release() is still waiting for its semaphore.
+ */
+static void ep_put(struct eventpoll * ep)
+{
+	if (!--ep->count)
+		kfree_s(ep, sizeof(*ep));
+}
+
+static void eventpoll_close(struct inode * inode, struct file * file)
+{
+	struct eventpoll * ep = (struct eventpoll *) file->private_data;
+	int i;
+
+	if (!ep)
+		return;
+	down(&ep->sem);
+	for (i = 0; i < EP_HASH_SIZE; i++)
+		while (ep->hash[i])
+			ep_remove(ep, ep->hash[i]);
+	up(&ep->sem);
+	file->private_data = NULL;
+	ep_put(ep);
+}
+
+static int eventpoll_lseek(struct inode * inode, struct file * file, off_t offset, int orig)
+{
+	return -ESPIPE;
+}
+
+static struct file_operations eventpoll_fops = {
+	eventpoll_lseek,
+	NULL,			/* read */
+	NULL,			/* write */
+	NULL,			/* readdir */
+	eventpoll_select,
+	NULL,			/* ioctl */
+	NULL,			/* mmap */
+	NULL,			/* no special open code */
+	eventpoll_close,
+	NULL
+};
+
+/*
+ * The file is going away for good (close_fp): drop it from every
+ * interest set that is watching it.
+ */
+void eventpoll_release(struct file * file)
+{
+	struct epitem * item, * p;
+
+	while ((item = file->f_epitems) != NULL) {
+		struct eventpoll * ep = item->ep;
+
+		ep->count++;
+		down(&ep->sem);
+		/* down() may have slept, and the item been removed meanwhile */
+		for (p = file->f_epitems; p; p = p->fnext)
+			if (p == item)
+				break;
+		if (p && item->ep == ep)
+			ep_remove(ep, item);
+		up(&ep->sem);
+		ep_put(ep);
+	}
+}
+
+asmlinkage int sys_epoll_create(int size)
+{
+	struct eventpoll * ep;
+	struct inode * inode;
+	struct file * file;
+	int fd, i;
+
+	if (size <= 0)
+		return -EINVAL;
+	fd = get_unused_fd(0);
+	if (fd < 0)
+		return fd;
+	ep = (struct eventpoll *) kmalloc(sizeof(*ep), GFP_KERNEL);
+	if (!ep)
+		return -ENOMEM;
+	ep->sem = MUTEX;
+	ep->wait = NULL;
+	ep->rdlist = NULL;
+	ep->rdtail = &ep->rdlist;
+	ep->nitems = 0;
+	ep->count = 1;
+	for (i = 0; i < EP_HASH_SIZE; i++)
+		ep->hash[i] = NULL;
+	if (!(file = get_empty_filp())) {
+		kfree_s(ep, sizeof(*ep));
+		return -ENFILE;
+	}
+	if (!(inode = get_empty_inode())) {
+		put_filp(file);
+		kfree_s(ep, sizeof(*ep));
+		return -ENFILE;
+	}
+	inode->i_mode = S_IRUSR | S_IWUSR;
+	inode->i_uid = current->fsuid;
+	inode->i_gid = current->fsgid;
+	file->f_inode = inode;
+	file->f_op = &eventpoll_fops;
+	file->f_mode = 1;
+	file->f_flags = O_RDONLY;
+	file->f_pos = 0;
+	file->private_data = ep;
+	fd_install(fd, file);
+	return fd;
+}
+
+asmlinkage int sys_epoll_ctl(int epfd, int op, int fd, struct epoll_event * event)
+{
+	struct file * file, * tfile;
+	struct eventpoll * ep;
+	struct epitem * item;
+	unsigned long events = 0, data = 0;
+	int error;
+
+	if (epfd < 0 || epfd >= current->files->max_fds || !(file = current->files->fd[epfd]))
+		return -EBADF;
+	if (fd < 0 || fd >= current->files->max_fds || !(tfile = current->files->fd[fd]) ||
+	    !tfile->f_inode)
+		return -EBADF;
+	if (file->f_op != &eventpoll_fops || tfile->f_op == &eventpoll_fops || file == tfile)
+		return -EINVAL;
+	ep = (struct eventpoll *) file->private_data;
+	if (op != EPOLL_CTL_DEL) {
+		error = verify_area(VERIFY_READ, event, sizeof(*event));
+		if (error)
+			return error;
+		events = get_fs_long(&event->events);
+		data = get_fs_long(&event->data);
+		events &= EPOLLIN | EPOLLOUT | EPOLLPRI | EPOLLONESHOT;
+	}
+	down(&ep->sem);
+	item = ep_find(ep, tfile, fd);
+	error = -EINVAL;
+	switch (op) {
+		case EPOLL_CTL_ADD:
+			error = -EEXIST;
+			if (!item)
+				error = ep_insert(ep, tfile, fd, events, data);
+			break;
+		case EPOLL_CTL_DEL:
+			error = -ENOENT;
+			if (item) {
+				ep_remove(ep, item);
+				error = 0;
+			}
+			break;
+		case EPOLL_CTL_MOD:
+			error = -ENOENT;
+			if (item) {
+				item->events = events;
+				item->data = data;
+				ep_del_ready(ep, item);
+				if (ep_item_poll(item))
+					ep_add_ready(ep, item);
+				error = 0;
+			}
+			break;
+	}
+	up(&ep->sem);
+	return error;
+}
+
+asmlinkage int sys_epoll_wait(int epfd, struct epoll_event * events,
+	int maxevents, int timeout)
+{
+	struct wait_queue wait = { current, NULL };
+	struct eventpoll * ep;
+	struct file * file;
+	int count, error;
+
+	if (epfd < 0 || epfd >= current->files->max_fds || !(file = current->files->fd[epfd]))
+		return -EBADF;
+	if (file->f_op != &eventpoll_fops)
+		return -EINVAL;
+	if (maxevents <= 0 || maxevents > INT_MAX / sizeof(struct epoll_event))
+		return -EINVAL;
+	error = verify_area(VERIFY_WRITE, events, maxevents * sizeof(*events));
+	if (error)
+		return error;
+	ep = (struct eventpoll *) file->private_data;
+
+	if (timeout < 0)
+		current->timeout = ~0UL;
+	else if (timeout == 0)
+		current->timeout = 0;
+	else
+		current->timeout = jiffies + 1 + ROUND_UP((unsigned long) timeout * HZ, 1000);
+
+	add_wait_queue(&ep->wait, &wait);
+	for (;;) {
+		down(&ep->sem);
+		count = ep_collect(ep, events, maxevents);
+		up(&ep->sem);
+		if (count || !current->timeout || (current->signal & ~current->blocked))
+			break;
+		current->state = TASK_INTERRUPTIBLE;
+		if (!ep->rdlist)
+			schedule();
+		current->state = TASK_RUNNING;
+	}
+	remove_wait_queue(&ep->wait, &wait);
+	current->timeout = 0;
+	if (!count && (current->signal & ~current->blocked))
+		return -EINTR;
+	return count;
+}
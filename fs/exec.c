@@ -52,6 +52,7 @@
 
 #include <asm/system.h>
 #include <asm/segment.h>
+#include <asm/bitops.h>
 #include <asm/pgtable.h>
 
 #include <linux/config.h>
@@ -81,6 +82,8 @@ static struct linux_binfmt aout_format = {
 
 static struct linux_binfmt *formats = &aout_format;
 
+static void exec_cache_flush(struct linux_binfmt * fmt);
+
 //每一种可执行文件类型被添加进内核时，都通过函数register_binfmt
 //将该类可执行文件对应的linux_binfmt结构件注册到内核
 //可执行文件的注册就是将其对应的linux_binfmt结构链接到全局链表formats中
@@ -116,6 +119,7 @@ int unregister_binfmt(struct linux_binfmt * fmt)
 	while (*tmp) {
 		if (fmt == *tmp) {
 			*tmp = fmt->next;
+			exec_cache_flush(fmt);
 			return 0;
 		}
 		tmp = &(*tmp)->next;
@@ -126,7 +130,7 @@ int unregister_binfmt(struct linux_binfmt * fmt)
 int open_inode(struct inode * inode, int mode)
 {
 	int error, fd;
-	struct file *f, **fpp;
+	struct file *f;
 
 	if (!inode->i_op || !inode->i_op->default_file_ops)
 		return -EINVAL;
@@ -134,26 +138,12 @@ int open_inode(struct inode * inode, int mode)
 	f = get_empty_filp();
 	if (!f)
 		return -ENFILE;
-	fd = 0;
-	//fpp指向当前进程文件描述符数组头
-	fpp = current->files->fd;
-	//遍历当前进程的文件描述符数组，寻找一个空闲项
-	for (;;) {
-		//如果此项为空
-		if (!*fpp)
-			break;
-		//如果fd大于进程所能打开的最多的文件数（即文件描述符数组容量）
-		//说明寻找空项失败，返回-EMFILE
-		if (++fd >= NR_OPEN) {
-			f->f_count--;
-			return -EMFILE;
-		}
-		//遍历数组下一项
-		fpp++;
+	fd = get_unused_fd(0);
+	if (fd < 0) {
+		put_filp(f);
+		return fd;
 	}
-	//执行到这里，说明寻找到一项空闲的文件描述符
-	//则将f填充到此空闲的文件描述符中
-	*fpp = f;
+	fd_install(fd, f);
 	//初始化此file对象
 	f->f_flags = mode;
 	f->f_mode = (mode+1) & O_ACCMODE;
@@ -196,8 +186,8 @@ int open_inode(struct inode * inode, int mode)
 	if (f->f_op->open) {
 		error = f->f_op->open(inode,f);	//file对象可在具体文件系统中再进行进一步的初始化
 		if (error) {
-			*fpp = NULL;
-			f->f_count--;	//减少file对象的引用计数
+			put_unused_fd(fd);
+			put_filp(f);	//减少file对象的引用计数
 			return error;
 		}
 	}
@@ -485,8 +475,8 @@ static int count(char ** argv)
 unsigned long copy_strings(int argc,char ** argv,unsigned long *page,
 		unsigned long p, int from_kmem)
 {
-	char *tmp, *pag = NULL;
-	int len, offset = 0;
+	char *tmp, *pag;
+	int len, chunk;
 	unsigned long old_fs, new_fs;
 
 	if (!p)
@@ -520,36 +510,28 @@ unsigned long copy_strings(int argc,char ** argv,unsigned long *page,
 			set_fs(old_fs);
 			return 0;
 		}
-		//开始一个一个地复制字符串中的字符
+		/*
+		 * Copy the string down into the argument pages, as much of it
+		 * at a time as fits below p in the current page, rather than a
+		 * byte at a time.  The pages are filled from the top down, like
+		 * the stack they will become.
+		 */
 		while (len) {
-			//p可以看作是物理页面的指针，offset可看作是p当前所指向的物理页面内的偏移量
-			--p; --tmp; --len;
-			if (--offset < 0) {
-				offset = p % PAGE_SIZE;	//对PAGE_SIZE取模，以使p自减到一定值后，指向下一个页面
-				//如果要复制的argv *和argv **参数都来自于内核空间 则需要将fs恢复到用户态数据段
-				if (from_kmem==2)
-					set_fs(old_fs);
-			/*
-				struct linux_binprm结构的page数组模拟或者说实现了此时的用户参数堆栈
-				将argv和envp参数字符串复制到进程空间最上方的堆栈的时候，是以入栈的方式
-				压入堆栈的，page数组是一个最大具有128KB空间，32个物理页面的空间
-				而局部变量offset则模拟了堆栈顶部的指针。每复制一个参数字符串，都将其放入
-				offset指向的page数组中的某一页物理内存中，并且offser自减，而且由于page数组
-				中的物理页面是从数组末尾向数组首项分配的，所以此过程完全模拟了压栈的过程
-				分配物理页面的过程也模拟了栈的自动增长过程，而且利用连续的数组，屏蔽了不连续的
-				物理地址，感觉此函数技巧多，颇为精湛
-							
-			*/
-				if (!(pag = (char *) page[p/PAGE_SIZE]) &&	//如果当前数组项为空（物理页面指针为空）
-				    !(pag = (char *) page[p/PAGE_SIZE] =	//则需要为此项分配一夜物理内存
-				      (unsigned long *) get_free_page(GFP_USER))) //GFP_USER是将fs恢复到用户态数据段的原因？
-					return 0;	//分配失败，则返回0
-				//如果要复制的argv *和argv **参数都来自于内核空间 则需要将fs设置为内核数据段
-				if (from_kmem==2)
-					set_fs(new_fs);
-
+			chunk = p % PAGE_SIZE;
+			if (!chunk)
+				chunk = PAGE_SIZE;
+			if (chunk > len)
+				chunk = len;
+			p -= chunk;
+			tmp -= chunk;
+			len -= chunk;
+			if (!page[p/PAGE_SIZE] &&
+			    !(page[p/PAGE_SIZE] = get_free_page(GFP_USER))) {
+				set_fs(old_fs);
+				return 0;
 			}
-			*(pag + offset) = get_fs_byte(tmp);
+			pag = (char *) page[p/PAGE_SIZE];
+			memcpy_fromfs(pag + p % PAGE_SIZE, tmp, chunk);
 		}
 	}
 	//如果要复制的argv *和argv **参数都来自于内核空间 则需要将fs恢复到用户态数据段
@@ -648,6 +630,138 @@ end_readexec:
 }
 
 
+/*
+ * The exec cache.  Entries are found by device, inode number and format,
+ * and get_write_access() drops those of a file before anybody can change
+ * it, so an entry that is found is good.  Only files on block devices are
+ * kept: for nfs we wouldn't see the other writers.  The list is kept in
+ * order of use and the oldest entry goes when it is full.  Users hold a
+ * count, so an entry dropped under an exec that sleeps stays until that
+ * exec is done with it.
+ *
+ * A format fills an entry with reads that can sleep, and a writer could
+ * open, change and close the file meanwhile.  exec_cache_gen counts
+ * get_write_access() calls: the format notes it before its first read,
+ * and exec_cache_add() drops the entry if it has moved since.
+ */
+
+#define EXEC_CACHE_MAX	64
+
+static struct exec_cache * exec_cache_list = NULL;
+static int exec_cache_nr = 0;
+unsigned long exec_cache_gen = 0;
+
+void exec_cache_put(struct exec_cache * ec)
+{
+	if (!--ec->ec_count)
+		kfree(ec);
+}
+
+static void exec_cache_unlink(struct exec_cache ** p)
+{
+	struct exec_cache * ec = *p;
+
+	*p = ec->ec_next;
+	exec_cache_nr--;
+	exec_cache_put(ec);
+}
+
+struct exec_cache * exec_cache_alloc(int len)
+{
+	struct exec_cache * ec;
+
+	ec = (struct exec_cache *) kmalloc(sizeof(*ec) + len, GFP_KERNEL);
+	if (ec) {
+		ec->ec_next = NULL;
+		ec->ec_fmt = NULL;
+		ec->ec_count = 1;
+		ec->ec_len = len;
+	}
+	return ec;
+}
+
+struct exec_cache * exec_cache_find(struct inode * inode, struct linux_binfmt * fmt)
+{
+	struct exec_cache ** p, * ec;
+
+	for (p = &exec_cache_list ; (ec = *p) != NULL ; p = &ec->ec_next) {
+		if (ec->ec_dev != inode->i_dev || ec->ec_ino != inode->i_ino ||
+		    ec->ec_fmt != fmt)
+			continue;
+		if (ec->ec_size != inode->i_size || ec->ec_mtime != inode->i_mtime ||
+		    ec->ec_ctime != inode->i_ctime) {
+			exec_cache_unlink(p);
+			return NULL;
+		}
+		*p = ec->ec_next;
+		ec->ec_next = exec_cache_list;
+		exec_cache_list = ec;
+		ec->ec_count++;
+		return ec;
+	}
+	return NULL;
+}
+
+/*
+ * Enter a filled-in entry for 'inode', read since exec_cache_gen was
+ * 'gen'.  The caller keeps its own count.
+ */
+void exec_cache_add(struct exec_cache * ec, struct inode * inode,
+	struct linux_binfmt * fmt, unsigned long gen)
+{
+	struct exec_cache ** p;
+
+	if (!inode->i_op || !inode->i_op->bmap || inode->i_wcount ||
+	    gen != exec_cache_gen)
+		return;
+	for (p = &exec_cache_list ; *p != NULL ; ) {
+		if (((*p)->ec_dev == inode->i_dev && (*p)->ec_ino == inode->i_ino &&
+		     (*p)->ec_fmt == fmt) ||
+		    (exec_cache_nr >= EXEC_CACHE_MAX && !(*p)->ec_next)) {
+			exec_cache_unlink(p);
+			continue;
+		}
+		p = &(*p)->ec_next;
+	}
+	ec->ec_fmt = fmt;
+	ec->ec_dev = inode->i_dev;
+	ec->ec_ino = inode->i_ino;
+	ec->ec_size = inode->i_size;
+	ec->ec_mtime = inode->i_mtime;
+	ec->ec_ctime = inode->i_ctime;
+	ec->ec_count++;
+	ec->ec_next = exec_cache_list;
+	exec_cache_list = ec;
+	exec_cache_nr++;
+}
+
+void exec_cache_invalidate(struct inode * inode)
+{
+	struct exec_cache ** p, * ec;
+
+	exec_cache_gen++;
+	p = &exec_cache_list;
+	while ((ec = *p) != NULL) {
+		if (ec->ec_dev == inode->i_dev && ec->ec_ino == inode->i_ino)
+			exec_cache_unlink(p);
+		else
+			p = &ec->ec_next;
+	}
+}
+
+static void exec_cache_flush(struct linux_binfmt * fmt)
+{
+	struct exec_cache ** p, * ec;
+
+	p = &exec_cache_list;
+	while ((ec = *p) != NULL) {
+		if (ec->ec_fmt == fmt)
+			exec_cache_unlink(p);
+		else
+			p = &ec->ec_next;
+	}
+}
+
 /*
  * This function flushes out all traces of the currently running executable so
  * that a new one can be started
@@ -676,6 +790,7 @@ void flush_old_exec(struct linux_binprm * bprm)
 	current->comm[i] = '\0';
 
 	/* Release all of the old mmap stuff. */
+	vfork_release(current);
 	exit_mmap(current);
 
 	//About the ldt and gdt processing
@@ -693,10 +808,10 @@ void flush_old_exec(struct linux_binprm * bprm)
 			current->sigaction[i].sa_handler = NULL;
 	}
 	//关闭该关闭的文件句柄
-	for (i=0 ; i<NR_OPEN ; i++)
-		if (FD_ISSET(i,&current->files->close_on_exec))
+	for (i=0 ; i<current->files->max_fds ; i++)
+		if (test_bit(i,current->files->close_on_exec))
 			sys_close(i);
-	FD_ZERO(&current->files->close_on_exec);
+	memset(current->files->close_on_exec, 0, current->files->max_fds / 8);
 	//清除当前进程的用户级页表，内核级页表依然保留
 	clear_page_tables(current);
 	if (last_task_used_math == current)
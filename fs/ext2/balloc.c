@@ -88,7 +88,7 @@ static void read_block_bitmap (struct super_block * sb,
  *
  * Notes:
  * 1/ There is one cache per mounted file system.
- * 2/ If the file system contains less than EXT2_MAX_GROUP_LOADED groups,
+ * 2/ If the file system contains no more groups than the cache holds,
  *    this function reads the bitmap without maintaining a LRU cache.
  */
 static int load__block_bitmap (struct super_block * sb,
@@ -104,7 +104,7 @@ static int load__block_bitmap (struct super_block * sb,
 			    "block_group = %d, groups_count = %lu",
 			    block_group, sb->u.ext2_sb.s_groups_count);
 
-	if (sb->u.ext2_sb.s_groups_count <= EXT2_MAX_GROUP_LOADED) {
+	if (sb->u.ext2_sb.s_groups_count <= sb->u.ext2_sb.s_max_group_loaded) {
 		if (sb->u.ext2_sb.s_block_bitmap[block_group]) {
 			if (sb->u.ext2_sb.s_block_bitmap_number[block_group] !=
 			    block_group)
@@ -134,10 +134,10 @@ static int load__block_bitmap (struct super_block * sb,
 		sb->u.ext2_sb.s_block_bitmap_number[0] = block_bitmap_number;
 		sb->u.ext2_sb.s_block_bitmap[0] = block_bitmap;
 	} else {
-		if (sb->u.ext2_sb.s_loaded_block_bitmaps < EXT2_MAX_GROUP_LOADED)
+		if (sb->u.ext2_sb.s_loaded_block_bitmaps < sb->u.ext2_sb.s_max_group_loaded)
 			sb->u.ext2_sb.s_loaded_block_bitmaps++;
 		else
-			brelse (sb->u.ext2_sb.s_block_bitmap[EXT2_MAX_GROUP_LOADED - 1]);
+			brelse (sb->u.ext2_sb.s_block_bitmap[sb->u.ext2_sb.s_max_group_loaded - 1]);
 		for (j = sb->u.ext2_sb.s_loaded_block_bitmaps - 1; j > 0;  j--) {
 			sb->u.ext2_sb.s_block_bitmap_number[j] =
 				sb->u.ext2_sb.s_block_bitmap_number[j - 1];
@@ -156,7 +156,7 @@ static inline int load_block_bitmap (struct super_block * sb,
 	    sb->u.ext2_sb.s_block_bitmap_number[0] == block_group)
 		return 0;
 	
-	if (sb->u.ext2_sb.s_groups_count <= EXT2_MAX_GROUP_LOADED && 
+	if (sb->u.ext2_sb.s_groups_count <= sb->u.ext2_sb.s_max_group_loaded && 
 	    sb->u.ext2_sb.s_block_bitmap_number[block_group] == block_group &&
 	    sb->u.ext2_sb.s_block_bitmap[block_group]) 
 		return block_group;
@@ -164,6 +164,81 @@ static inline int load_block_bitmap (struct super_block * sb,
 	return load__block_bitmap (sb, block_group);
 }
 
+/*
+ * Every group has a bound on its longest free run in s_group_run, and
+ * s_run_hist counts the groups by the bit length of that bound.  A bound
+ * starts out as the group's free count, is raised when a free makes a
+ * longer run, and becomes exact whenever a search reads the whole bitmap
+ * without finding the run it wanted.  Allocation can then pass over the
+ * groups that can't hold a request, and see whether any group can at
+ * all, without reading their bitmaps.
+ */
+static inline int run_bucket (unsigned int run)
+{
+	int b = 0;
+
+	while (run) {
+		b++;
+		run >>= 1;
+	}
+	return b;
+}
+
+static void set_group_run (struct super_block * sb, unsigned int group,
+			   unsigned int run)
+{
+	unsigned short * r = sb->u.ext2_sb.s_group_run + group;
+
+	sb->u.ext2_sb.s_run_hist[run_bucket (*r)]--;
+	*r = run;
+	sb->u.ext2_sb.s_run_hist[run_bucket (run)]++;
+}
+
+static int any_group_run (struct super_block * sb, unsigned int want)
+{
+	int b;
+
+	for (b = run_bucket (want); b < EXT2_RUN_BUCKETS; b++)
+		if (sb->u.ext2_sb.s_run_hist[b])
+			return 1;
+	return 0;
+}
+
+void ext2_init_group_runs (struct super_block * sb)
+{
+	struct ext2_group_desc * gdp;
+	unsigned int i, run;
+
+	memset (sb->u.ext2_sb.s_run_hist, 0, sizeof (sb->u.ext2_sb.s_run_hist));
+	for (i = 0; i < sb->u.ext2_sb.s_groups_count; i++) {
+		gdp = get_group_desc (sb, i, NULL);
+		run = gdp->bg_free_blocks_count;
+		if (run > EXT2_BLOCKS_PER_GROUP(sb))
+			run = EXT2_BLOCKS_PER_GROUP(sb);
+		sb->u.ext2_sb.s_group_run[i] = run;
+		sb->u.ext2_sb.s_run_hist[run_bucket (run)]++;
+	}
+}
+
+/*
+ * Length of the free run around bits [start, end) of a group bitmap,
+ * which are free.  Whole free bytes are skipped at a time.
+ */
+static int run_around (unsigned char * map, int start, int end, int limit)
+{
+	while (start > 0 && !test_bit (start - 1, map))
+		if (!(start & 7) && !map[(start >> 3) - 1])
+			start -= 8;
+		else
+			start--;
+	while (end < limit && !test_bit (end, map))
+		if (!(end & 7) && end + 8 <= limit && !map[end >> 3])
+			end += 8;
+		else
+			end++;
+	return end - start;
+}
+
 void ext2_free_blocks (struct super_block * sb, unsigned long block,
 		       unsigned long count)
 {
@@ -172,7 +247,7 @@ void ext2_free_blocks (struct super_block * sb, unsigned long block,
 	unsigned long block_group;
 	unsigned long bit;
 	unsigned long i;
-	int bitmap_nr;
+	int bitmap_nr, run;
 	struct ext2_group_desc * gdp;
 	struct ext2_super_block * es;
 
@@ -227,6 +302,10 @@ void ext2_free_blocks (struct super_block * sb, unsigned long block,
 			es->s_free_blocks_count++;
 		}
 	}
+	run = run_around ((unsigned char *) bh->b_data, bit, bit + count,
+			  EXT2_BLOCKS_PER_GROUP(sb));
+	if (run > sb->u.ext2_sb.s_group_run[block_group])
+		set_group_run (sb, block_group, run);
 	
 	mark_buffer_dirty(bh2, 1);
 	mark_buffer_dirty(sb->u.ext2_sb.s_sbh, 1);
@@ -242,20 +321,63 @@ void ext2_free_blocks (struct super_block * sb, unsigned long block,
 }
 
 /*
- * ext2_new_block uses a goal block to assist allocation.  If the goal is
+ * Number of free blocks at bit j of a group bitmap, up to max.
+ */
+static int free_run (char * map, int j, int max, int limit)
+{
+	int k;
+
+	for (k = 0; k < max && j + k < limit && !test_bit (j + k, map); k++)
+		;
+	return k;
+}
+
+/*
+ * Find a run of at least 'want' free blocks at or after bit j, or -1.
+ * If 'longest' is given, the longest shorter run passed over is left in it.
+ */
+static int find_free_run (char * map, int j, int want, int limit,
+			  int * longest)
+{
+	int run;
+
+	if (longest)
+		*longest = 0;
+	while (j < limit) {
+		j = find_next_zero_bit ((unsigned long *) map, limit, j);
+		if (j >= limit)
+			break;
+		run = free_run (map, j, want, limit);
+		if (run >= want)
+			return j;
+		if (longest && run > *longest)
+			*longest = run;
+		j += run;
+	}
+	return -1;
+}
+
+/*
+ * ext2_new_blocks uses a goal block to assist allocation.  If the goal is
  * free, or there is a free block within 32 blocks of the goal, that block
  * is allocated.  Otherwise a forward search is made for a free block; within 
  * each block group the search first looks for an entire free byte in the block
  * bitmap, and then for any free bit if that fails.
+ *
+ * Up to *count blocks are allocated as one run starting at the block
+ * found, and *count is set to the number we got.  Only the first one is
+ * cleared.  When the goal itself wasn't free, a run long enough for the
+ * whole request is looked for in the rest of the group first, so that
+ * files growing at the same time get runs of their own instead of
+ * taking turns at every free block.
  */
-int ext2_new_block (struct super_block * sb, unsigned long goal,
-		    u32 * prealloc_count,
-		    u32 * prealloc_block)
+int ext2_new_blocks (struct super_block * sb, unsigned long goal, int * count)
 {
 	struct buffer_head * bh;
 	struct buffer_head * bh2;
 	char * p, * r;
-	int i, j, k, tmp;
+	int i, j, k, n, tmp;
+	int want, run, goal_hit = 0;
 	unsigned long lmap;
 	int bitmap_nr;
 	struct ext2_group_desc * gdp;
@@ -265,7 +387,7 @@ int ext2_new_block (struct super_block * sb, unsigned long goal,
 	static int goal_hits = 0, goal_attempts = 0;
 #endif
 	if (!sb) {
-		printk ("ext2_new_block: nonexistent device");
+		printk ("ext2_new_blocks: nonexistent device");
 		return 0;
 	}
 	lock_super (sb);
@@ -304,6 +426,7 @@ repeat:
 			goal_hits++;
 			ext2_debug ("goal bit allocated.\n");
 #endif
+			goal_hit = 1;
 			goto got_block;
 		}
 		if (j) {
@@ -357,8 +480,35 @@ repeat:
 	ext2_debug ("Bit not found in block group %d.\n", i);
 
 	/*
-	 * Now search the rest of the groups.  We assume that 
-	 * i and gdp correctly point to the last group visited.
+	 * Now search the rest of the groups, first for one with a run long
+	 * enough for the whole request.  The run summaries let us skip the
+	 * groups that can't have one without reading their bitmaps, and every
+	 * group searched in vain gets an exact summary, so it is skipped
+	 * until something is freed in it.
+	 */
+	if (*count > 1 && any_group_run (sb, *count)) {
+		for (k = 0, n = i; k < sb->u.ext2_sb.s_groups_count; k++) {
+			n++;
+			if (n >= sb->u.ext2_sb.s_groups_count)
+				n = 0;
+			if (sb->u.ext2_sb.s_group_run[n] < *count)
+				continue;
+			bitmap_nr = load_block_bitmap (sb, n);
+			bh = sb->u.ext2_sb.s_block_bitmap[bitmap_nr];
+			j = find_free_run (bh->b_data, 0, *count,
+					   EXT2_BLOCKS_PER_GROUP(sb), &run);
+			if (j >= 0) {
+				i = n;
+				gdp = get_group_desc (sb, i, &bh2);
+				goto got_block;
+			}
+			set_group_run (sb, n, run);
+		}
+	}
+
+	/*
+	 * Failing that, take the first group with any free block.  We
+	 * assume that i and gdp correctly point to the last group visited.
 	 */
 	for (k = 0; k < sb->u.ext2_sb.s_groups_count; k++) {
 		i++;
@@ -382,7 +532,7 @@ repeat:
 		j = find_first_zero_bit ((unsigned long *) bh->b_data,
 					 EXT2_BLOCKS_PER_GROUP(sb));
 	if (j >= EXT2_BLOCKS_PER_GROUP(sb)) {
-		ext2_error (sb, "ext2_new_block",
+		ext2_error (sb, "ext2_new_blocks",
 			    "Free blocks count corrupted for block group %d", i);
 		unlock_super (sb);
 		return 0;
@@ -400,43 +550,42 @@ got_block:
 
 	ext2_debug ("using block group %d(%d)\n", i, gdp->bg_free_blocks_count);
 
+	want = *count;
+	if (want > gdp->bg_free_blocks_count)
+		want = gdp->bg_free_blocks_count;
+	run = free_run (bh->b_data, j, want, EXT2_BLOCKS_PER_GROUP(sb));
+	if (run < want && !goal_hit) {
+		k = find_free_run (bh->b_data, j, want, EXT2_BLOCKS_PER_GROUP(sb),
+				   NULL);
+		if (k >= 0) {
+			j = k;
+			run = want;
+		}
+	}
+
 	tmp = j + i * EXT2_BLOCKS_PER_GROUP(sb) + es->s_first_data_block;
 
 	if (test_opt (sb, CHECK_STRICT) &&
 	    (tmp == gdp->bg_block_bitmap ||
 	     tmp == gdp->bg_inode_bitmap ||
 	     in_range (tmp, gdp->bg_inode_table, sb->u.ext2_sb.s_itb_per_group)))
-		ext2_panic (sb, "ext2_new_block",
+		ext2_panic (sb, "ext2_new_blocks",
 			    "Allocating block in system zone - "
 			    "block = %u", tmp);
 
 	if (set_bit (j, bh->b_data)) {
-		ext2_warning (sb, "ext2_new_block",
+		ext2_warning (sb, "ext2_new_blocks",
 			      "bit already set for block %d", j);
 		goto repeat;
 	}
 
 	ext2_debug ("found bit %d\n", j);
 
-	/*
-	 * Do block preallocation now if required.
-	 */
-#ifdef EXT2_PREALLOCATE
-	if (prealloc_block) {
-		*prealloc_count = 0;
-		*prealloc_block = tmp + 1;
-		for (k = 1;
-		     k < 8 && (j + k) < EXT2_BLOCKS_PER_GROUP(sb); k++) {
-			if (set_bit (j + k, bh->b_data))
-				break;
-			(*prealloc_count)++;
-		}	
-		gdp->bg_free_blocks_count -= *prealloc_count;
-		es->s_free_blocks_count -= *prealloc_count;
-		ext2_debug ("Preallocated a further %lu bits.\n",
-			    *prealloc_count);
-	}
-#endif
+	for (k = 1; k < run; k++)
+		if (set_bit (j + k, bh->b_data))
+			break;
+	run = k;
+	ext2_debug ("Allocated a further %d bits.\n", run - 1);
 
 	j = tmp;
 
@@ -447,14 +596,14 @@ got_block:
 	}
 
 	if (j >= es->s_blocks_count) {
-		ext2_error (sb, "ext2_new_block",
+		ext2_error (sb, "ext2_new_blocks",
 			    "block >= blocks count - "
 			    "block_group = %d, block=%d", i, j);
 		unlock_super (sb);
 		return 0;
 	}
 	if (!(bh = getblk (sb->s_dev, j, sb->s_blocksize))) {
-		ext2_error (sb, "ext2_new_block", "cannot get block %d", j);
+		ext2_error (sb, "ext2_new_blocks", "cannot get block %d", j);
 		unlock_super (sb);
 		return 0;
 	}
@@ -466,15 +615,39 @@ got_block:
 	ext2_debug ("allocating block %d. "
 		    "Goal hits %d of %d.\n", j, goal_hits, goal_attempts);
 
-	gdp->bg_free_blocks_count--;
+	gdp->bg_free_blocks_count -= run;
+	if (sb->u.ext2_sb.s_group_run[i] > gdp->bg_free_blocks_count)
+		set_group_run (sb, i, gdp->bg_free_blocks_count);
 	mark_buffer_dirty(bh2, 1);
-	es->s_free_blocks_count--;
+	es->s_free_blocks_count -= run;
 	mark_buffer_dirty(sb->u.ext2_sb.s_sbh, 1);
 	sb->s_dirt = 1;
 	unlock_super (sb);
+	*count = run;
 	return j;
 }
 
+int ext2_new_block (struct super_block * sb, unsigned long goal,
+		    u32 * prealloc_count,
+		    u32 * prealloc_block)
+{
+	int count = 1;
+	int block;
+
+#ifdef EXT2_PREALLOCATE
+	if (prealloc_block)
+		count = EXT2_PREALLOC_MIN;
+#endif
+	block = ext2_new_blocks (sb, goal, &count);
+#ifdef EXT2_PREALLOCATE
+	if (block && prealloc_block) {
+		*prealloc_block = block + 1;
+		*prealloc_count = count - 1;
+	}
+#endif
+	return block;
+}
+
 unsigned long ext2_count_free_blocks (struct super_block * sb)
 {
 #ifdef EXT2FS_DEBUG
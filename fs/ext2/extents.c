@@ -0,0 +1,706 @@
+/*
+ *  linux/fs/ext2/extents.c
+ *
+ *  Extent mapped files.
+ */
+
+/*
+ * A file with EXT2_EXTENTS_FL maps its blocks with (logical, physical,
+ * length) records instead of one pointer per block.  The records live in
+ * a small B-tree whose root fills i_block: with four records there, a
+ * file written in a few runs needs no metadata blocks at all, and the
+ * deepest realistic tree is two levels of blocks holding hundreds of
+ * records each.  Looking a block up is a binary search at each level,
+ * and the last extent found is remembered in the inode, so a sequential
+ * read does the search once per extent rather than once per block.
+ *
+ * The tree is only changed under the inode semaphore: writes and
+ * truncates on ext2 regular files already hold it.  Lookups don't take
+ * it; every change that could sleep gets its buffers first and then
+ * edits the nodes in one go, so a lookup never sees half of a split.
+ */
+
+#include <linux/errno.h>
+#include <linux/fs.h>
+#include <linux/ext2_fs.h>
+#include <linux/sched.h>
+#include <linux/stat.h>
+#include <linux/locks.h>
+#include <linux/string.h>
+
+#define EXT_ROOT(inode)	((struct ext2_extent_header *) (inode)->u.ext2_i.i_data)
+#define EXT_EXTENT(hdr)	((struct ext2_extent *) ((hdr) + 1))
+#define EXT_INDEX(hdr)	((struct ext2_extent_idx *) ((hdr) + 1))
+/* both kinds of record are 12 bytes and start with their first block */
+#define EXT_RECSIZE	sizeof (struct ext2_extent)
+#define EXT_KEY(hdr, i)	(EXT_EXTENT(hdr)[i].ee_block)
+
+#define EXT_ROOT_MAX	((EXT2_N_BLOCKS * sizeof (__u32) - \
+			  sizeof (struct ext2_extent_header)) / EXT_RECSIZE)
+#define EXT_NODE_MAX(sb) ((EXT2_BLOCK_SIZE(sb) - \
+			  sizeof (struct ext2_extent_header)) / EXT_RECSIZE)
+
+struct ext_path {
+	struct buffer_head * bh;	/* NULL for the root */
+	struct ext2_extent_header * hdr;
+	int pos;			/* entry taken at this level */
+};
+
+static void ext_init_root (struct ext2_extent_header * root)
+{
+	memset (root, 0, EXT2_N_BLOCKS * sizeof (__u32));
+	root->eh_magic = EXT2_EXT_MAGIC;
+	root->eh_max = EXT_ROOT_MAX;
+}
+
+void ext2_ext_init (struct inode * inode)
+{
+	ext_init_root (EXT_ROOT(inode));
+	inode->u.ext2_i.i_ext_len = 0;
+}
+
+/*
+ * Forget the cached extent.  The generation tells a lookup that slept
+ * that what it found may be stale by now.
+ */
+static inline void ext_invalidate (struct inode * inode)
+{
+	inode->u.ext2_i.i_ext_len = 0;
+	inode->u.ext2_i.i_ext_gen++;
+}
+
+static void ext_release (struct ext_path * path, int depth)
+{
+	int i;
+
+	for (i = 1; i <= depth; i++)
+		brelse (path[i].bh);
+}
+
+static int ext_bad_node (struct super_block * sb,
+			 struct ext2_extent_header * hdr, int depth)
+{
+	return hdr->eh_magic != EXT2_EXT_MAGIC || hdr->eh_depth != depth ||
+	       hdr->eh_max > EXT_NODE_MAX(sb) ||
+	       hdr->eh_entries > hdr->eh_max;
+}
+
+/*
+ * Walk down from 'root' to the leaf that would hold 'block'.  At each
+ * level path[].pos is the last entry starting at or before the block;
+ * index levels fall back to their first entry, a leaf leaves -1 there.
+ * Returns the depth of the tree, or -1 with nothing held if a node is
+ * unreadable or corrupt.
+ */
+static int ext_find (struct inode * inode, struct ext2_extent_header * root,
+		     unsigned long block, struct ext_path * path)
+{
+	struct ext2_extent_header * hdr = root;
+	struct buffer_head * bh;
+	int depth = root->eh_depth;
+	int level, lo, hi, mid;
+
+	path[0].bh = NULL;
+	level = 0;
+	if (root->eh_magic != EXT2_EXT_MAGIC || depth > EXT2_EXT_MAX_DEPTH ||
+	    root->eh_entries > root->eh_max)
+		goto bad;
+	for (;;) {
+		lo = 0;
+		hi = hdr->eh_entries - 1;
+		while (lo <= hi) {
+			mid = (lo + hi) / 2;
+			if (EXT_KEY(hdr, mid) <= block)
+				lo = mid + 1;
+			else
+				hi = mid - 1;
+		}
+		path[level].hdr = hdr;
+		path[level].pos = hi;
+		if (level == depth)
+			return depth;
+		if (hi < 0) {
+			if (!hdr->eh_entries)
+				goto bad;
+			path[level].pos = 0;
+		}
+		bh = bread (inode->i_dev,
+			    EXT_INDEX(hdr)[path[level].pos].ei_leaf,
+			    inode->i_sb->s_blocksize);
+		if (!bh)
+			goto bad;
+		path[++level].bh = bh;
+		hdr = (struct ext2_extent_header *) bh->b_data;
+		if (ext_bad_node (inode->i_sb, hdr, depth - level))
+			goto bad;
+	}
+bad:
+	ext2_error (inode->i_sb, "ext_find",
+		    "bad extent tree - inode=%lu, level=%d",
+		    inode->i_ino, level);
+	ext_release (path, level);
+	return -1;
+}
+
+/*
+ * Map a logical block.  Holes give 0; then, if 'goal' is given, it is set
+ * to where the block would continue the extent before it.
+ */
+int ext2_ext_bmap (struct inode * inode, unsigned long block,
+		   unsigned long * goal)
+{
+	struct ext_path path[EXT2_EXT_MAX_DEPTH + 1];
+	struct ext2_extent * ex;
+	unsigned long gen = inode->u.ext2_i.i_ext_gen;
+	int depth, result = 0;
+
+	if (block - inode->u.ext2_i.i_ext_block < inode->u.ext2_i.i_ext_len)
+		return inode->u.ext2_i.i_ext_start +
+		       block - inode->u.ext2_i.i_ext_block;
+	depth = ext_find (inode, EXT_ROOT(inode), block, path);
+	if (depth < 0)
+		return 0;
+	if (path[depth].pos >= 0) {
+		ex = EXT_EXTENT(path[depth].hdr) + path[depth].pos;
+		if (block - ex->ee_block < ex->ee_len) {
+			result = ex->ee_start + block - ex->ee_block;
+			if (gen == inode->u.ext2_i.i_ext_gen) {
+				inode->u.ext2_i.i_ext_block = ex->ee_block;
+				inode->u.ext2_i.i_ext_start = ex->ee_start;
+				inode->u.ext2_i.i_ext_len = ex->ee_len;
+			}
+		} else if (goal)
+			*goal = ex->ee_start + block - ex->ee_block;
+	}
+	ext_release (path, depth);
+	return result;
+}
+
+static void ext_put (struct ext2_extent_header * hdr, int pos, void * rec)
+{
+	char * p = (char *) (EXT_EXTENT(hdr) + pos);
+
+	memmove (p + EXT_RECSIZE, p, (hdr->eh_entries - pos) * EXT_RECSIZE);
+	memcpy (p, rec, EXT_RECSIZE);
+	hdr->eh_entries++;
+}
+
+static void ext_dirty (struct inode * inode, struct buffer_head * bh)
+{
+	if (bh)
+		mark_buffer_dirty (bh, 1);
+	else
+		inode->i_dirt = 1;
+}
+
+/*
+ * Synchronous files write their nodes out once the change is complete.
+ */
+static void ext_write (struct inode * inode, struct buffer_head * bh)
+{
+	if (bh && bh->b_dirt &&
+	    (IS_SYNC(inode) || inode->u.ext2_i.i_osync)) {
+		ll_rw_block (WRITE, 1, &bh);
+		wait_on_buffer (bh);
+	}
+}
+
+/*
+ * A record went in front of everything below the path: lower the keys
+ * that lead to it.
+ */
+static void ext_fix_keys (struct inode * inode, struct ext_path * path,
+			  int depth, unsigned long block)
+{
+	struct ext2_extent_idx * idx;
+	int level;
+
+	for (level = depth - 1; level >= 0; level--) {
+		idx = EXT_INDEX(path[level].hdr) + path[level].pos;
+		if (idx->ei_block <= block)
+			break;
+		idx->ei_block = block;
+		ext_dirty (inode, path[level].bh);
+	}
+}
+
+static struct buffer_head * ext_new_node (struct inode * inode,
+					  unsigned long goal, int depth,
+					  int * err)
+{
+	struct buffer_head * bh;
+	struct ext2_extent_header * hdr;
+	int tmp;
+
+	tmp = ext2_new_block (inode->i_sb, goal, 0, 0);
+	if (!tmp) {
+		*err = -ENOSPC;
+		return NULL;
+	}
+	bh = getblk (inode->i_dev, tmp, inode->i_sb->s_blocksize);
+	if (!bh) {
+		ext2_free_blocks (inode->i_sb, tmp, 1);
+		*err = -EIO;
+		return NULL;
+	}
+	memset (bh->b_data, 0, inode->i_sb->s_blocksize);
+	bh->b_uptodate = 1;
+	hdr = (struct ext2_extent_header *) bh->b_data;
+	hdr->eh_magic = EXT2_EXT_MAGIC;
+	hdr->eh_max = EXT_NODE_MAX(inode->i_sb);
+	hdr->eh_depth = depth;
+	inode->i_blocks += inode->i_sb->s_blocksize / 512;
+	return bh;
+}
+
+static void ext_free_node (struct inode * inode, unsigned long block)
+{
+	ext2_free_blocks (inode->i_sb, block, 1);
+	inode->i_blocks -= inode->i_sb->s_blocksize / 512;
+}
+
+/*
+ * The root is full all the way down: move its records into a new block
+ * and leave a single index entry pointing to it, one level higher.
+ */
+static int ext_grow (struct inode * inode, struct ext2_extent_header * root,
+		     unsigned long goal)
+{
+	struct buffer_head * bh;
+	struct ext2_extent_header * hdr;
+	struct ext2_extent_idx * idx;
+	int err;
+
+	bh = ext_new_node (inode, goal, root->eh_depth, &err);
+	if (!bh)
+		return err;
+	hdr = (struct ext2_extent_header *) bh->b_data;
+	memcpy (EXT_EXTENT(hdr), EXT_EXTENT(root),
+		root->eh_entries * EXT_RECSIZE);
+	hdr->eh_entries = root->eh_entries;
+	ext_dirty (inode, bh);
+	/* ei_block overlays the first key, which stays as it is */
+	idx = EXT_INDEX(root);
+	idx->ei_leaf = bh->b_blocknr;
+	idx->ei_leaf_hi = 0;
+	idx->ei_unused = 0;
+	root->eh_entries = 1;
+	root->eh_depth++;
+	inode->i_dirt = 1;
+	ext_write (inode, bh);
+	brelse (bh);
+	return 0;
+}
+
+/*
+ * Map 'len' blocks from 'block' on, which must be a hole, to 'phys'.  The
+ * run is glued onto a neighbouring extent when it continues it on disk,
+ * which is what sequential writes do, so the tree only grows when the
+ * file is fragmented.
+ *
+ * When the leaf is full it is split at the insertion point, and so on up
+ * while the parents are full.  A file appending at its end therefore
+ * leaves full nodes behind and starts new, almost empty ones.
+ */
+static int ext_insert (struct inode * inode, struct ext2_extent_header * root,
+		       unsigned long block, unsigned long phys, int len)
+{
+	struct ext_path path[EXT2_EXT_MAX_DEPTH + 1];
+	struct buffer_head * new[EXT2_EXT_MAX_DEPTH + 1];
+	struct ext2_extent_header * hdr, * nhdr;
+	struct ext2_extent * ex, rec;
+	struct ext2_extent_idx * idx;
+	int depth, level, i, pos, n, err = 0;
+
+repeat:
+	depth = ext_find (inode, root, block, path);
+	if (depth < 0)
+		return -EIO;
+	hdr = path[depth].hdr;
+	i = path[depth].pos;
+	ex = EXT_EXTENT(hdr);
+	if (i >= 0 && ex[i].ee_block + ex[i].ee_len == block &&
+	    ex[i].ee_start + ex[i].ee_len == phys &&
+	    ex[i].ee_len + len <= EXT2_EXT_MAX_LEN) {
+		ex[i].ee_len += len;
+		/* did that close the gap to the next one? */
+		if (i + 1 < hdr->eh_entries &&
+		    block + len == ex[i + 1].ee_block &&
+		    phys + len == ex[i + 1].ee_start &&
+		    ex[i].ee_len + ex[i + 1].ee_len <= EXT2_EXT_MAX_LEN) {
+			ex[i].ee_len += ex[i + 1].ee_len;
+			hdr->eh_entries--;
+			memmove (ex + i + 1, ex + i + 2,
+				 (hdr->eh_entries - i - 1) * EXT_RECSIZE);
+		}
+		ext_dirty (inode, path[depth].bh);
+		goto out;
+	}
+	if (i + 1 < hdr->eh_entries && block + len == ex[i + 1].ee_block &&
+	    phys + len == ex[i + 1].ee_start &&
+	    ex[i + 1].ee_len + len <= EXT2_EXT_MAX_LEN) {
+		ex[i + 1].ee_block = block;
+		ex[i + 1].ee_start = phys;
+		ex[i + 1].ee_len += len;
+		ext_dirty (inode, path[depth].bh);
+		if (i < 0)
+			ext_fix_keys (inode, path, depth, block);
+		goto out;
+	}
+
+	/* a new record: find the lowest node with room for one */
+	for (level = depth; level >= 0; level--)
+		if (path[level].hdr->eh_entries < path[level].hdr->eh_max)
+			break;
+	if (level < 0) {
+		if (depth >= EXT2_EXT_MAX_DEPTH) {
+			err = -EFBIG;
+			goto out;
+		}
+		err = ext_grow (inode, root, phys);
+		if (err)
+			goto out;
+		ext_release (path, depth);
+		goto repeat;
+	}
+	for (i = level + 1; i <= depth; i++) {
+		new[i] = ext_new_node (inode, phys, depth - i, &err);
+		if (!new[i]) {
+			while (--i > level) {
+				ext_free_node (inode, new[i]->b_blocknr);
+				brelse (new[i]);
+			}
+			goto out;
+		}
+	}
+
+	/* nothing below sleeps: split the full nodes bottom up */
+	rec.ee_block = block;
+	rec.ee_len = len;
+	rec.ee_start_hi = 0;
+	rec.ee_start = phys;
+	for (i = depth; i > level; i--) {
+		hdr = path[i].hdr;
+		nhdr = (struct ext2_extent_header *) new[i]->b_data;
+		pos = path[i].pos + 1;
+		n = hdr->eh_entries - pos;
+		memcpy (EXT_EXTENT(nhdr), EXT_EXTENT(hdr) + pos,
+			n * EXT_RECSIZE);
+		nhdr->eh_entries = n;
+		hdr->eh_entries = pos;
+		if (pos < hdr->eh_max)
+			ext_put (hdr, pos, &rec);
+		else
+			ext_put (nhdr, 0, &rec);
+		ext_dirty (inode, path[i].bh);
+		ext_dirty (inode, new[i]);
+		/* the parent gets an entry for the new node, just after ours */
+		idx = (struct ext2_extent_idx *) &rec;
+		idx->ei_block = EXT_KEY(nhdr, 0);
+		idx->ei_leaf = new[i]->b_blocknr;
+		idx->ei_leaf_hi = 0;
+		idx->ei_unused = 0;
+	}
+	ext_put (path[level].hdr, path[level].pos + 1, &rec);
+	ext_dirty (inode, path[level].bh);
+	if (path[depth].pos < 0)
+		ext_fix_keys (inode, path, depth, block);
+	for (i = level + 1; i <= depth; i++) {
+		ext_write (inode, new[i]);
+		brelse (new[i]);
+	}
+out:
+	for (i = 1; i <= depth; i++)
+		ext_write (inode, path[i].bh);
+	ext_release (path, depth);
+	return err;
+}
+
+int ext2_ext_insert (struct inode * inode, unsigned long block,
+		     unsigned long phys)
+{
+	return ext_insert (inode, EXT_ROOT(inode), block, phys, 1);
+}
+
+static void ext_free_data (struct inode * inode, unsigned long start,
+			   unsigned long count)
+{
+	struct buffer_head * bh;
+	unsigned long i;
+
+	if (inode->u.ext2_i.i_flags & EXT2_SECRM_FL)
+		for (i = 0; i < count; i++) {
+			bh = getblk (inode->i_dev, start + i,
+				     inode->i_sb->s_blocksize);
+			if (!bh)
+				continue;
+			memset (bh->b_data, 0, inode->i_sb->s_blocksize);
+			bh->b_uptodate = 1;
+			mark_buffer_dirty (bh, 1);
+			brelse (bh);
+		}
+	ext2_free_blocks (inode->i_sb, start, count);
+	inode->i_blocks -= count * (inode->i_sb->s_blocksize / 512);
+}
+
+/*
+ * Free everything from logical block 'first' on below 'hdr', working back
+ * from the end.  Returns nonzero if the node changed.
+ */
+static int ext_trunc_node (struct inode * inode,
+			   struct ext2_extent_header * hdr,
+			   unsigned long first)
+{
+	struct ext2_extent * ex;
+	struct ext2_extent_idx * idx;
+	struct ext2_extent_header * child;
+	struct buffer_head * bh;
+	unsigned long block, n;
+	int changed = 0, last;
+
+	while (hdr->eh_entries) {
+		if (!hdr->eh_depth) {
+			ex = EXT_EXTENT(hdr) + hdr->eh_entries - 1;
+			if (ex->ee_block + ex->ee_len <= first)
+				break;
+			changed = 1;
+			/*
+			 * Drop the blocks from the map before freeing them:
+			 * ext2_free_blocks() sleeps, and bmap() must not hand
+			 * out a block that already belongs to another file,
+			 * from the tree or from the cached extent.
+			 */
+			if (ex->ee_block >= first) {
+				block = ex->ee_start;
+				n = ex->ee_len;
+				hdr->eh_entries--;
+				ext_invalidate (inode);
+				ext_free_data (inode, block, n);
+				continue;
+			}
+			n = ex->ee_block + ex->ee_len - first;
+			ex->ee_len -= n;
+			ext_invalidate (inode);
+			ext_free_data (inode, ex->ee_start + ex->ee_len, n);
+			break;
+		}
+		idx = EXT_INDEX(hdr) + hdr->eh_entries - 1;
+		/* the nodes before this one end before its first block */
+		last = idx->ei_block <= first;
+		bh = bread (inode->i_dev, idx->ei_leaf,
+			    inode->i_sb->s_blocksize);
+		if (!bh)
+			break;
+		child = (struct ext2_extent_header *) bh->b_data;
+		if (ext_bad_node (inode->i_sb, child, hdr->eh_depth - 1)) {
+			ext2_error (inode->i_sb, "ext_trunc_node",
+				    "bad extent node %lu - inode=%lu",
+				    bh->b_blocknr, inode->i_ino);
+			brelse (bh);
+			break;
+		}
+		if (ext_trunc_node (inode, child, first)) {
+			if (!child->eh_entries) {
+				block = idx->ei_leaf;
+				hdr->eh_entries--;
+				ext_invalidate (inode);
+				ext_free_node (inode, block);
+				changed = 1;
+			} else {
+				ext_dirty (inode, bh);
+				ext_write (inode, bh);
+			}
+		}
+		brelse (bh);
+		if (last)
+			break;
+	}
+	return changed;
+}
+
+void ext2_ext_truncate (struct inode * inode)
+{
+	struct ext2_extent_header * root = EXT_ROOT(inode);
+	unsigned long first = (inode->i_size + inode->i_sb->s_blocksize - 1) /
+			      inode->i_sb->s_blocksize;
+
+	if (root->eh_magic != EXT2_EXT_MAGIC) {
+		ext2_error (inode->i_sb, "ext2_ext_truncate",
+			    "bad extent root - inode=%lu", inode->i_ino);
+		return;
+	}
+	ext_invalidate (inode);
+	ext_trunc_node (inode, root, first);
+	if (!root->eh_entries) {
+		root->eh_depth = 0;
+		root->eh_max = EXT_ROOT_MAX;
+	}
+	ext_invalidate (inode);
+	inode->i_dirt = 1;
+}
+
+static int ext_sync_block (struct inode * inode, unsigned long block, int wait)
+{
+	struct buffer_head * bh;
+
+	bh = get_hash_table (inode->i_dev, block, inode->i_sb->s_blocksize);
+	if (!bh)
+		return 0;
+	if (wait && bh->b_req && !bh->b_uptodate) {
+		brelse (bh);
+		return -1;
+	}
+	if (wait || !bh->b_uptodate || !bh->b_dirt) {
+		brelse (bh);
+		return 0;
+	}
+	ll_rw_block (WRITE, 1, &bh);
+	bh->b_count--;
+	return 0;
+}
+
+static int ext_sync_node (struct inode * inode,
+			  struct ext2_extent_header * hdr, int wait)
+{
+	struct ext2_extent * ex;
+	struct ext2_extent_idx * idx;
+	struct buffer_head * bh;
+	unsigned long n;
+	int i, err = 0;
+
+	for (i = 0; i < hdr->eh_entries; i++) {
+		if (!hdr->eh_depth) {
+			ex = EXT_EXTENT(hdr) + i;
+			for (n = 0; n < ex->ee_len; n++)
+				err |= ext_sync_block (inode, ex->ee_start + n,
+						       wait);
+			continue;
+		}
+		idx = EXT_INDEX(hdr) + i;
+		err |= ext_sync_block (inode, idx->ei_leaf, wait);
+		bh = bread (inode->i_dev, idx->ei_leaf,
+			    inode->i_sb->s_blocksize);
+		if (!bh)
+			return -1;
+		if (!ext_bad_node (inode->i_sb,
+				   (struct ext2_extent_header *) bh->b_data,
+				   hdr->eh_depth - 1))
+			err |= ext_sync_node (inode,
+				(struct ext2_extent_header *) bh->b_data, wait);
+		brelse (bh);
+	}
+	return err;
+}
+
+int ext2_ext_sync (struct inode * inode, int wait)
+{
+	return ext_sync_node (inode, EXT_ROOT(inode), wait);
+}
+
+/*
+ * Give back the blocks of a tree that was never made live, but not the
+ * data blocks it maps.
+ */
+static void ext_drop_nodes (struct inode * inode,
+			    struct ext2_extent_header * hdr)
+{
+	struct ext2_extent_idx * idx;
+	struct buffer_head * bh;
+	int i;
+
+	if (!hdr->eh_depth)
+		return;
+	for (i = 0; i < hdr->eh_entries; i++) {
+		idx = EXT_INDEX(hdr) + i;
+		bh = bread (inode->i_dev, idx->ei_leaf,
+			    inode->i_sb->s_blocksize);
+		if (bh) {
+			ext_drop_nodes (inode,
+				(struct ext2_extent_header *) bh->b_data);
+			brelse (bh);
+		}
+		ext_free_node (inode, idx->ei_leaf);
+	}
+}
+
+/*
+ * Free an indirect block of the old map and, 'level' levels down, the
+ * indirect blocks below it.  The data blocks stay: the extents own them.
+ */
+static void ext_free_ind (struct inode * inode, unsigned long block, int level)
+{
+	struct buffer_head * bh;
+	int i;
+
+	if (!block)
+		return;
+	if (level) {
+		bh = bread (inode->i_dev, block, inode->i_sb->s_blocksize);
+		if (bh) {
+			for (i = 0; i < EXT2_ADDR_PER_BLOCK(inode->i_sb); i++)
+				ext_free_ind (inode,
+					      ((u32 *) bh->b_data)[i],
+					      level - 1);
+			brelse (bh);
+		}
+	}
+	ext_free_node (inode, block);
+}
+
+/*
+ * Turn a file mapped by indirect blocks into an extent mapped one.  The
+ * new tree is built off a root on the stack while the old map stays live,
+ * then swapped in without sleeping.  Called with the inode semaphore held.
+ */
+int ext2_ext_convert (struct inode * inode)
+{
+	__u32 root_data[EXT2_N_BLOCKS];
+	__u32 old[EXT2_N_BLOCKS];
+	struct ext2_extent_header * root =
+		(struct ext2_extent_header *) root_data;
+	unsigned long block, nblocks, phys;
+	unsigned long first = 0, start = 0, run = 0;
+	int err;
+
+	if (inode->u.ext2_i.i_flags & EXT2_EXTENTS_FL)
+		return 0;
+	if (!S_ISREG(inode->i_mode) ||
+	    !EXT2_HAS_INCOMPAT_FEATURE(inode->i_sb,
+				       EXT2_FEATURE_INCOMPAT_EXTENTS))
+		return -EINVAL;
+	ext2_discard_prealloc (inode);
+	ext_init_root (root);
+	nblocks = (inode->i_size + inode->i_sb->s_blocksize - 1) /
+		  inode->i_sb->s_blocksize;
+	for (block = 0; block < nblocks; block++) {
+		phys = ext2_ind_bmap (inode, inode->u.ext2_i.i_data, block);
+		if (run && phys == start + run && run < EXT2_EXT_MAX_LEN) {
+			run++;
+			continue;
+		}
+		if (run && (err = ext_insert (inode, root, first, start, run)))
+			goto fail;
+		first = block;
+		start = phys;
+		run = phys ? 1 : 0;
+		if (need_resched)
+			schedule ();
+	}
+	if (run && (err = ext_insert (inode, root, first, start, run)))
+		goto fail;
+
+	memcpy (old, inode->u.ext2_i.i_data, sizeof (old));
+	memcpy (inode->u.ext2_i.i_data, root_data, sizeof (root_data));
+	inode->u.ext2_i.i_flags |= EXT2_EXTENTS_FL;
+	ext_invalidate (inode);
+	ext_free_ind (inode, old[EXT2_IND_BLOCK], 0);
+	ext_free_ind (inode, old[EXT2_DIND_BLOCK], 1);
+	ext_free_ind (inode, old[EXT2_TIND_BLOCK], 2);
+	inode->i_ctime = CURRENT_TIME;
+	inode->i_dirt = 1;
+	return 0;
+
+fail:
+	ext_drop_nodes (inode, root);
+	return err;
+}
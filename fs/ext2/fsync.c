@@ -178,6 +178,10 @@ int ext2_sync_file (struct inode * inode, struct file * file)
 
 	for (wait=0; wait<=1; wait++)
 	{
+		if (inode->u.ext2_i.i_flags & EXT2_EXTENTS_FL) {
+			err |= ext2_ext_sync (inode, wait);
+			continue;
+		}
 		err |= sync_direct (inode, wait);
 		err |= sync_indirect (inode,
 				      inode->u.ext2_i.i_data+EXT2_IND_BLOCK,
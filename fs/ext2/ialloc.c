@@ -87,7 +87,7 @@ static void read_inode_bitmap (struct super_block * sb,
  *
  * Notes:
  * 1/ There is one cache per mounted file system.
- * 2/ If the file system contains less than EXT2_MAX_GROUP_LOADED groups,
+ * 2/ If the file system contains no more groups than the cache holds,
  *    this function reads the bitmap without maintaining a LRU cache.
  */
 static int load_inode_bitmap (struct super_block * sb,
@@ -105,7 +105,7 @@ static int load_inode_bitmap (struct super_block * sb,
 	if (sb->u.ext2_sb.s_loaded_inode_bitmaps > 0 &&
 	    sb->u.ext2_sb.s_inode_bitmap_number[0] == block_group)
 		return 0;
-	if (sb->u.ext2_sb.s_groups_count <= EXT2_MAX_GROUP_LOADED) {
+	if (sb->u.ext2_sb.s_groups_count <= sb->u.ext2_sb.s_max_group_loaded) {
 		if (sb->u.ext2_sb.s_inode_bitmap[block_group]) {
 			if (sb->u.ext2_sb.s_inode_bitmap_number[block_group] != block_group)
 				ext2_panic (sb, "load_inode_bitmap",
@@ -135,10 +135,10 @@ static int load_inode_bitmap (struct super_block * sb,
 		sb->u.ext2_sb.s_inode_bitmap_number[0] = inode_bitmap_number;
 		sb->u.ext2_sb.s_inode_bitmap[0] = inode_bitmap;
 	} else {
-		if (sb->u.ext2_sb.s_loaded_inode_bitmaps < EXT2_MAX_GROUP_LOADED)
+		if (sb->u.ext2_sb.s_loaded_inode_bitmaps < sb->u.ext2_sb.s_max_group_loaded)
 			sb->u.ext2_sb.s_loaded_inode_bitmaps++;
 		else
-			brelse (sb->u.ext2_sb.s_inode_bitmap[EXT2_MAX_GROUP_LOADED - 1]);
+			brelse (sb->u.ext2_sb.s_inode_bitmap[sb->u.ext2_sb.s_max_group_loaded - 1]);
 		for (j = sb->u.ext2_sb.s_loaded_inode_bitmaps - 1; j > 0; j--) {
 			sb->u.ext2_sb.s_inode_bitmap_number[j] =
 				sb->u.ext2_sb.s_inode_bitmap_number[j - 1];
@@ -464,7 +464,7 @@ repeat:
 	inode->i_blksize = sb->s_blocksize;
 	inode->i_blocks = 0;
 	inode->i_mtime = inode->i_atime = inode->i_ctime = CURRENT_TIME;
-	inode->u.ext2_i.i_flags = dir->u.ext2_i.i_flags;
+	inode->u.ext2_i.i_flags = dir->u.ext2_i.i_flags & ~EXT2_EXTENTS_FL;
 	if (S_ISLNK(mode))
 		inode->u.ext2_i.i_flags &= ~(EXT2_IMMUTABLE_FL | EXT2_APPEND_FL);
 	inode->u.ext2_i.i_faddr = 0;
@@ -474,6 +474,11 @@ repeat:
 	inode->u.ext2_i.i_dir_acl = 0;
 	inode->u.ext2_i.i_dtime = 0;
 	inode->u.ext2_i.i_block_group = i;
+	if (S_ISREG(mode) && test_opt (sb, EXTENTS) &&
+	    EXT2_HAS_INCOMPAT_FEATURE(sb, EXT2_FEATURE_INCOMPAT_EXTENTS)) {
+		inode->u.ext2_i.i_flags |= EXT2_EXTENTS_FL;
+		ext2_ext_init (inode);
+	}
 	inode->i_op = NULL;
 	if (inode->u.ext2_i.i_flags & EXT2_SYNC_FL)
 		inode->i_flags |= MS_SYNCHRONOUS;
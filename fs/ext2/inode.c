@@ -38,8 +38,6 @@ void ext2_put_inode (struct inode * inode)
 	ext2_free_inode (inode);
 }
 
-#define inode_bmap(inode, nr) ((inode)->u.ext2_i.i_data[(nr)])
-
 static int block_bmap (struct buffer_head * bh, int nr)
 {
 	int tmp;
@@ -105,15 +103,33 @@ static int ext2_alloc_block (struct inode * inode, unsigned long goal)
 		mark_buffer_dirty(bh, 1);
 		brelse (bh);
 	} else {
+		int count;
+		/* did a file appending in order use up the whole window? */
+		int grow = !inode->u.ext2_i.i_prealloc_count &&
+			   inode->u.ext2_i.i_prealloc_block &&
+			   (goal == inode->u.ext2_i.i_prealloc_block ||
+			    goal + 1 == inode->u.ext2_i.i_prealloc_block);
+
 		ext2_discard_prealloc (inode);
 		ext2_debug ("preallocation miss (%lu/%lu).\n",
 			    alloc_hits, ++alloc_attempts);
-		if (S_ISREG(inode->i_mode))
-			result = ext2_new_block
-				(inode->i_sb, goal,
-				 &inode->u.ext2_i.i_prealloc_count,
-				 &inode->u.ext2_i.i_prealloc_block);
-		else
+		if (S_ISREG(inode->i_mode)) {
+			count = inode->u.ext2_i.i_prealloc_size << 1;
+			if (!grow || count < EXT2_PREALLOC_MIN)
+				count = EXT2_PREALLOC_MIN;
+			if (count > EXT2_PREALLOC_MAX)
+				count = EXT2_PREALLOC_MAX;
+			inode->u.ext2_i.i_prealloc_size = count;
+			if (count < inode->u.ext2_i.i_prealloc_want)
+				count = inode->u.ext2_i.i_prealloc_want;
+			if (count > EXT2_PREALLOC_MAX)
+				count = EXT2_PREALLOC_MAX;
+			result = ext2_new_blocks (inode->i_sb, goal, &count);
+			if (result) {
+				inode->u.ext2_i.i_prealloc_block = result + 1;
+				inode->u.ext2_i.i_prealloc_count = count - 1;
+			}
+		} else
 			result = ext2_new_block (inode->i_sb, goal, 0, 0);
 	}
 #else
@@ -124,7 +140,11 @@ static int ext2_alloc_block (struct inode * inode, unsigned long goal)
 }
 
 
-int ext2_bmap (struct inode * inode, int block)
+/*
+ * Map a block through the direct and indirect block numbers in 'data',
+ * the i_data of the inode unless an extent conversion is reading it.
+ */
+int ext2_ind_bmap (struct inode * inode, u32 * data, int block)
 {
 	int i;
 	int addr_per_block = EXT2_ADDR_PER_BLOCK(inode->i_sb);
@@ -140,10 +160,10 @@ int ext2_bmap (struct inode * inode, int block)
 		return 0;
 	}
 	if (block < EXT2_NDIR_BLOCKS)
-		return inode_bmap (inode, block);
+		return data[block];
 	block -= EXT2_NDIR_BLOCKS;
 	if (block < addr_per_block) {
-		i = inode_bmap (inode, EXT2_IND_BLOCK);
+		i = data[EXT2_IND_BLOCK];
 		if (!i)
 			return 0;
 		return block_bmap (bread (inode->i_dev, i,
@@ -151,7 +171,7 @@ int ext2_bmap (struct inode * inode, int block)
 	}
 	block -= addr_per_block;
 	if (block < addr_per_block * addr_per_block) {
-		i = inode_bmap (inode, EXT2_DIND_BLOCK);
+		i = data[EXT2_DIND_BLOCK];
 		if (!i)
 			return 0;
 		i = block_bmap (bread (inode->i_dev, i,
@@ -164,7 +184,7 @@ int ext2_bmap (struct inode * inode, int block)
 				   block & (addr_per_block - 1));
 	}
 	block -= addr_per_block * addr_per_block;
-	i = inode_bmap (inode, EXT2_TIND_BLOCK);
+	i = data[EXT2_TIND_BLOCK];
 	if (!i)
 		return 0;
 	i = block_bmap (bread (inode->i_dev, i, inode->i_sb->s_blocksize),
@@ -179,6 +199,69 @@ int ext2_bmap (struct inode * inode, int block)
 			   block & (addr_per_block - 1));
 }
 
+int ext2_bmap (struct inode * inode, int block)
+{
+	if (!(inode->u.ext2_i.i_flags & EXT2_EXTENTS_FL))
+		return ext2_ind_bmap (inode, inode->u.ext2_i.i_data, block);
+	if (block < 0) {
+		ext2_warning (inode->i_sb, "ext2_bmap", "block < 0");
+		return 0;
+	}
+	return ext2_ext_bmap (inode, block, NULL);
+}
+
+/*
+ * ext2_getblk for extent mapped files.  The file is locked by the caller,
+ * so unlike inode_getblk there is nobody to race with for the hole.
+ */
+static struct buffer_head * ext_getblk (struct inode * inode, long block,
+					int create, int * err)
+{
+	unsigned long goal = 0;
+	int tmp;
+	struct buffer_head * result;
+	int blocks = inode->i_sb->s_blocksize / 512;
+
+	tmp = ext2_ext_bmap (inode, block, &goal);
+	if (tmp)
+		return getblk (inode->i_dev, tmp, inode->i_sb->s_blocksize);
+	if (!create || block >= 
+	    (current->rlim[RLIMIT_FSIZE].rlim_cur >>
+	     EXT2_BLOCK_SIZE_BITS(inode->i_sb))) {
+		*err = -EFBIG;
+		return NULL;
+	}
+	if (inode->u.ext2_i.i_next_alloc_block == block &&
+	    inode->u.ext2_i.i_next_alloc_goal)
+		goal = inode->u.ext2_i.i_next_alloc_goal;
+	if (!goal)
+		goal = (inode->u.ext2_i.i_block_group * 
+			EXT2_BLOCKS_PER_GROUP(inode->i_sb)) +
+		       inode->i_sb->u.ext2_sb.s_es->s_first_data_block;
+
+	ext2_debug ("goal = %lu.\n", goal);
+
+	tmp = ext2_alloc_block (inode, goal);
+	if (!tmp)
+		return NULL;
+	result = getblk (inode->i_dev, tmp, inode->i_sb->s_blocksize);
+	*err = ext2_ext_insert (inode, block, tmp);
+	if (*err) {
+		brelse (result);
+		ext2_free_blocks (inode->i_sb, tmp, 1);
+		return NULL;
+	}
+	inode->u.ext2_i.i_next_alloc_block = block;
+	inode->u.ext2_i.i_next_alloc_goal = tmp;
+	inode->i_ctime = CURRENT_TIME;
+	inode->i_blocks += blocks;
+	if (IS_SYNC(inode) || inode->u.ext2_i.i_osync)
+		ext2_sync_inode (inode);
+	else
+		inode->i_dirt = 1;
+	return result;
+}
+
 static struct buffer_head * inode_getblk (struct inode * inode, int nr,
 					  int create, int new_block, int * err)
 {
@@ -390,6 +473,8 @@ struct buffer_head * ext2_getblk (struct inode * inode, long block,
 	}
 
 	*err = -ENOSPC;
+	if (inode->u.ext2_i.i_flags & EXT2_EXTENTS_FL)
+		return ext_getblk (inode, block, create, err);
 	b = block;
 	if (block < EXT2_NDIR_BLOCKS)
 		return inode_getblk (inode, block, create, b, err);
@@ -424,6 +509,8 @@ int ext2_getcluster (struct inode * inode, long block)
 	unsigned long b;
 	unsigned long addr_per_block = EXT2_ADDR_PER_BLOCK(inode->i_sb);
 
+	if (inode->u.ext2_i.i_flags & EXT2_EXTENTS_FL)
+		return 0;
 	create = 0;
 	err = -EIO;
 	if (block < 0) {
@@ -543,6 +630,9 @@ void ext2_read_inode (struct inode * inode)
 	inode->u.ext2_i.i_block_group = block_group;
 	inode->u.ext2_i.i_next_alloc_block = 0;
 	inode->u.ext2_i.i_next_alloc_goal = 0;
+	inode->u.ext2_i.i_prealloc_size = 0;
+	inode->u.ext2_i.i_prealloc_want = 0;
+	inode->u.ext2_i.i_ext_len = 0;
 	if (inode->u.ext2_i.i_prealloc_count)
 		ext2_error (inode->i_sb, "ext2_read_inode",
 			    "New inode has non-zero prealloc count!");
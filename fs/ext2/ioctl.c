@@ -44,6 +44,18 @@ int ext2_ioctl (struct inode * inode, struct file * filp, unsigned int cmd,
 				return -EPERM;
 		if (IS_RDONLY(inode))
 			return -EROFS;
+		/*
+		 * Setting EXTENTS converts the file; there is no way back
+		 */
+		if ((flags ^ inode->u.ext2_i.i_flags) & EXT2_EXTENTS_FL) {
+			if (!(flags & EXT2_EXTENTS_FL))
+				return -EINVAL;
+			down (&inode->i_sem);
+			err = ext2_ext_convert (inode);
+			up (&inode->i_sem);
+			if (err)
+				return err;
+		}
 		inode->u.ext2_i.i_flags = flags;
 		if (flags & EXT2_APPEND_FL)
 			inode->i_flags |= S_APPEND;
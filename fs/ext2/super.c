@@ -21,6 +21,7 @@
 #include <linux/fs.h>
 #include <linux/ext2_fs.h>
 #include <linux/malloc.h>
+#include <linux/mm.h>
 #include <linux/sched.h>
 #include <linux/stat.h>
 #include <linux/string.h>
@@ -88,6 +89,63 @@ void ext2_warning (struct super_block * sb, const char * function,
 		MAJOR(sb->s_dev), MINOR(sb->s_dev), function, buf);
 }
 
+/*
+ * Size the bitmap caches from memory.  When they can hold every group,
+ * load_block_bitmap and load_inode_bitmap index them by group and no LRU
+ * is kept at all.
+ */
+static int ext2_alloc_bitmap_caches (struct super_block * sb)
+{
+	unsigned long n;
+	char * p;
+
+	n = high_memory / EXT2_BITMAP_MEM_RATIO / sb->s_blocksize;
+	if (n < EXT2_MAX_GROUP_LOADED)
+		n = EXT2_MAX_GROUP_LOADED;
+	if (n > EXT2_MAX_GROUP_CACHE)
+		n = EXT2_MAX_GROUP_CACHE;
+	if (n > sb->u.ext2_sb.s_groups_count)
+		n = sb->u.ext2_sb.s_groups_count;
+	p = kmalloc (n * 2 * (sizeof (unsigned long) +
+			      sizeof (struct buffer_head *)), GFP_KERNEL);
+	if (!p)
+		return 0;
+	sb->u.ext2_sb.s_group_run = kmalloc (sb->u.ext2_sb.s_groups_count *
+					     sizeof (unsigned short),
+					     GFP_KERNEL);
+	if (!sb->u.ext2_sb.s_group_run) {
+		kfree (p);
+		return 0;
+	}
+	memset (p, 0, n * 2 * (sizeof (unsigned long) +
+			       sizeof (struct buffer_head *)));
+	sb->u.ext2_sb.s_inode_bitmap = (struct buffer_head **) p;
+	sb->u.ext2_sb.s_block_bitmap = sb->u.ext2_sb.s_inode_bitmap + n;
+	sb->u.ext2_sb.s_inode_bitmap_number =
+		(unsigned long *) (sb->u.ext2_sb.s_block_bitmap + n);
+	sb->u.ext2_sb.s_block_bitmap_number =
+		sb->u.ext2_sb.s_inode_bitmap_number + n;
+	sb->u.ext2_sb.s_max_group_loaded = n;
+	sb->u.ext2_sb.s_loaded_inode_bitmaps = 0;
+	sb->u.ext2_sb.s_loaded_block_bitmaps = 0;
+	ext2_init_group_runs (sb);
+	return 1;
+}
+
+static void ext2_free_bitmap_caches (struct super_block * sb)
+{
+	int i;
+
+	for (i = 0; i < sb->u.ext2_sb.s_max_group_loaded; i++) {
+		if (sb->u.ext2_sb.s_inode_bitmap[i])
+			brelse (sb->u.ext2_sb.s_inode_bitmap[i]);
+		if (sb->u.ext2_sb.s_block_bitmap[i])
+			brelse (sb->u.ext2_sb.s_block_bitmap[i]);
+	}
+	kfree (sb->u.ext2_sb.s_inode_bitmap);
+	kfree (sb->u.ext2_sb.s_group_run);
+}
+
 void ext2_put_super (struct super_block * sb)
 {
 	int db_count;
@@ -105,12 +163,7 @@ void ext2_put_super (struct super_block * sb)
 			brelse (sb->u.ext2_sb.s_group_desc[i]);
 	kfree_s (sb->u.ext2_sb.s_group_desc,
 		 db_count * sizeof (struct buffer_head *));
-	for (i = 0; i < EXT2_MAX_GROUP_LOADED; i++)
-		if (sb->u.ext2_sb.s_inode_bitmap[i])
-			brelse (sb->u.ext2_sb.s_inode_bitmap[i]);
-	for (i = 0; i < EXT2_MAX_GROUP_LOADED; i++)
-		if (sb->u.ext2_sb.s_block_bitmap[i])
-			brelse (sb->u.ext2_sb.s_block_bitmap[i]);
+	ext2_free_bitmap_caches (sb);
 	brelse (sb->u.ext2_sb.s_sbh);
 	unlock_super (sb);
 	return;
@@ -236,6 +289,10 @@ static int parse_options (char * options, unsigned long * sb_block,
 				return 0;
 			}
 		}
+		else if (!strcmp (this_char, "extents"))
+			set_opt (*mount_options, EXTENTS);
+		else if (!strcmp (this_char, "noextents"))
+			clear_opt (*mount_options, EXTENTS);
 		else if (!strcmp (this_char, "grpid") ||
 			 !strcmp (this_char, "bsdgroups"))
 			set_opt (*mount_options, GRPID);
@@ -295,6 +352,31 @@ static int parse_options (char * options, unsigned long * sb_block,
 	return 1;
 }
 
+/*
+ * New files on a fs mounted with "extents" are extent mapped, which older
+ * kernels must not try to read: mark the fs as needing the feature.
+ */
+static void ext2_setup_features (struct super_block * sb,
+				 struct ext2_super_block * es)
+{
+	if (!test_opt (sb, EXTENTS) ||
+	    EXT2_HAS_INCOMPAT_FEATURE(sb, EXT2_FEATURE_INCOMPAT_EXTENTS))
+		return;
+	if (es->s_rev_level == EXT2_GOOD_OLD_REV) {
+		es->s_first_ino = EXT2_GOOD_OLD_FIRST_INO;
+		es->s_inode_size = EXT2_GOOD_OLD_INODE_SIZE;
+		es->s_feature_compat = 0;
+		es->s_feature_incompat = 0;
+		es->s_feature_ro_compat = 0;
+		es->s_rev_level = EXT2_DYNAMIC_REV;
+	}
+	es->s_feature_incompat |= EXT2_FEATURE_INCOMPAT_EXTENTS;
+	printk ("EXT2-fs: enabling extents on dev %d/%d\n",
+		MAJOR(sb->s_dev), MINOR(sb->s_dev));
+	mark_buffer_dirty(sb->u.ext2_sb.s_sbh, 1);
+	sb->s_dirt = 1;
+}
+
 static void ext2_setup_super (struct super_block * sb,
 			      struct ext2_super_block * es)
 {
@@ -325,6 +407,7 @@ static void ext2_setup_super (struct super_block * sb,
 		es->s_mtime = CURRENT_TIME;
 		mark_buffer_dirty(sb->u.ext2_sb.s_sbh, 1);
 		sb->s_dirt = 1;
+		ext2_setup_features (sb, es);
 		if (test_opt (sb, DEBUG))
 			printk ("[EXT II FS %s, %s, bs=%lu, fs=%lu, gc=%lu, "
 				"bpg=%lu, ipg=%lu, mo=%04lx]\n",
@@ -544,6 +627,40 @@ struct super_block * ext2_read_super (struct super_block * sb, void * data,
 		return NULL;
 	}
 
+	if (es->s_rev_level > EXT2_GOOD_OLD_REV) {
+		if (es->s_feature_incompat & ~EXT2_FEATURE_INCOMPAT_SUPP) {
+			sb->s_dev = 0;
+			unlock_super (sb);
+			brelse (bh);
+			printk ("EXT2-fs: dev %d/%d: unsupported optional "
+				"features (%lx)\n", MAJOR(dev), MINOR(dev),
+				(unsigned long) es->s_feature_incompat &
+				~EXT2_FEATURE_INCOMPAT_SUPP);
+			return NULL;
+		}
+		if (!(sb->s_flags & MS_RDONLY) &&
+		    (es->s_feature_ro_compat & ~EXT2_FEATURE_RO_COMPAT_SUPP)) {
+			sb->s_dev = 0;
+			unlock_super (sb);
+			brelse (bh);
+			printk ("EXT2-fs: dev %d/%d: unsupported optional "
+				"features, mount read-only\n",
+				MAJOR(dev), MINOR(dev));
+			return NULL;
+		}
+		if (es->s_inode_size != EXT2_GOOD_OLD_INODE_SIZE ||
+		    es->s_first_ino != EXT2_GOOD_OLD_FIRST_INO) {
+			sb->s_dev = 0;
+			unlock_super (sb);
+			brelse (bh);
+			printk ("EXT2-fs: dev %d/%d: unsupported inode size "
+				"%d or first inode %lu\n", MAJOR(dev),
+				MINOR(dev), es->s_inode_size,
+				(unsigned long) es->s_first_ino);
+			return NULL;
+		}
+	}
+
 	if (sb->s_blocksize != sb->u.ext2_sb.s_frag_size) {
 		sb->s_dev = 0;
 		unlock_super (sb);
@@ -593,14 +710,17 @@ struct super_block * ext2_read_super (struct super_block * sb, void * data,
 		printk ("EXT2-fs: group descriptors corrupted !\n");
 		return NULL;
 	}
-	for (i = 0; i < EXT2_MAX_GROUP_LOADED; i++) {
-		sb->u.ext2_sb.s_inode_bitmap_number[i] = 0;
-		sb->u.ext2_sb.s_inode_bitmap[i] = NULL;
-		sb->u.ext2_sb.s_block_bitmap_number[i] = 0;
-		sb->u.ext2_sb.s_block_bitmap[i] = NULL;
+	if (!ext2_alloc_bitmap_caches (sb)) {
+		sb->s_dev = 0;
+		unlock_super (sb);
+		for (j = 0; j < db_count; j++)
+			brelse (sb->u.ext2_sb.s_group_desc[j]);
+		kfree_s (sb->u.ext2_sb.s_group_desc,
+			 db_count * sizeof (struct buffer_head *));
+		brelse (bh);
+		printk ("EXT2-fs: not enough memory\n");
+		return NULL;
 	}
-	sb->u.ext2_sb.s_loaded_inode_bitmaps = 0;
-	sb->u.ext2_sb.s_loaded_block_bitmaps = 0;
 	sb->u.ext2_sb.s_db_per_group = db_count;
 	unlock_super (sb);
 	/*
@@ -615,6 +735,7 @@ struct super_block * ext2_read_super (struct super_block * sb, void * data,
 				brelse (sb->u.ext2_sb.s_group_desc[i]);
 		kfree_s (sb->u.ext2_sb.s_group_desc,
 			 db_count * sizeof (struct buffer_head *));
+		ext2_free_bitmap_caches (sb);
 		brelse (bh);
 		printk ("EXT2-fs: get root inode failed\n");
 		return NULL;
@@ -687,8 +808,11 @@ int ext2_remount (struct super_block * sb, int * flags, char * data)
 	sb->u.ext2_sb.s_resuid = resuid;
 	sb->u.ext2_sb.s_resgid = resgid;
 	es = sb->u.ext2_sb.s_es;
-	if ((*flags & MS_RDONLY) == (sb->s_flags & MS_RDONLY))
+	if ((*flags & MS_RDONLY) == (sb->s_flags & MS_RDONLY)) {
+		if (!(sb->s_flags & MS_RDONLY))
+			ext2_setup_features (sb, es);
 		return 0;
+	}
 	if (*flags & MS_RDONLY) {
 		if (es->s_state & EXT2_VALID_FS ||
 		    !(sb->u.ext2_sb.s_mount_state & EXT2_VALID_FS))
@@ -709,6 +833,9 @@ int ext2_remount (struct super_block * sb, int * flags, char * data)
 		 * store the current valid flag.  (It may have been changed 
 		 * by e2fsck since we originally mounted the partition.)
 		 */
+		if (EXT2_HAS_RO_COMPAT_FEATURE(sb,
+					       ~EXT2_FEATURE_RO_COMPAT_SUPP))
+			return -EROFS;
 		sb->u.ext2_sb.s_mount_state = es->s_state;
 		sb->s_flags &= ~MS_RDONLY;
 		ext2_setup_super (sb, es);
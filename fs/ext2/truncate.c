@@ -327,6 +327,16 @@ void ext2_truncate (struct inode * inode)
 	if (IS_APPEND(inode) || IS_IMMUTABLE(inode))
 		return;
 	ext2_discard_prealloc(inode);
+	if (inode->u.ext2_i.i_flags & EXT2_EXTENTS_FL) {
+		down(&inode->i_sem);
+		ext2_ext_truncate (inode);
+		up(&inode->i_sem);
+		if (IS_SYNC(inode) && inode->i_dirt)
+			ext2_sync_inode (inode);
+		inode->i_mtime = inode->i_ctime = CURRENT_TIME;
+		inode->i_dirt = 1;
+		return;
+	}
 	while (1) {
 		down(&inode->i_sem);
 		retry = trunc_direct(inode);
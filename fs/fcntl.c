@@ -20,6 +20,7 @@
 	sys_dup()的主要工作就是用来“复制”一个打开的文件号，并使两个文件号都指向同一个文件
 */
 #include <asm/segment.h>
+#include <asm/bitops.h>
 
 #include <linux/sched.h>
 #include <linux/kernel.h>
@@ -54,25 +55,23 @@ extern int sock_fcntl (struct file *, unsigned int cmd, unsigned long arg);
 */
 static int dupfd(unsigned int fd, unsigned int arg)
 {
-	if (fd >= NR_OPEN || !current->files->fd[fd])
+	int newfd;
+
+	if (fd >= current->files->max_fds || !current->files->fd[fd])
 		return -EBADF;
-	if (arg >= NR_OPEN)
+	if (arg >= NR_OPEN_MAX)
 		return -EINVAL;
-	while (arg < NR_OPEN)
-		if (current->files->fd[arg])
-			arg++;
-		else
-			break;
-	if (arg >= NR_OPEN)
-		return -EMFILE;
-	FD_CLR(arg, &current->files->close_on_exec);	// 从关闭队列中清除该记录
-	(current->files->fd[arg] = current->files->fd[fd])->f_count++;
-	return arg;
+	newfd = get_unused_fd(arg);
+	if (newfd < 0)
+		return newfd;
+	fd_install(newfd, current->files->fd[fd]);
+	current->files->fd[fd]->f_count++;
+	return newfd;
 }
 
 asmlinkage int sys_dup2(unsigned int oldfd, unsigned int newfd)
 {
-	if (oldfd >= NR_OPEN || !current->files->fd[oldfd])
+	if (oldfd >= current->files->max_fds || !current->files->fd[oldfd])
 		return -EBADF;
 	if (newfd == oldfd)
 		return newfd;
@@ -80,15 +79,8 @@ asmlinkage int sys_dup2(unsigned int oldfd, unsigned int newfd)
 	 * errno's for dup2() are slightly different than for fcntl(F_DUPFD)
 	 * for historical reasons.
 	 */
-	if (newfd > NR_OPEN)	/* historical botch - should have been >= */
-		return -EBADF;	/* dupfd() would return -EINVAL */
-#if 1
-	if (newfd == NR_OPEN)
-		return -EBADF;	/* dupfd() does return -EINVAL and that may
-				 * even be the standard!  But that is too
-				 * weird for now.
-				 */
-#endif
+	if (newfd >= current->rlim[RLIMIT_NOFILE].rlim_cur)
+		return -EBADF;	/* dupfd() would return -EMFILE */
 	sys_close(newfd);
 	return dupfd(oldfd,newfd);
 }
@@ -130,7 +122,7 @@ asmlinkage int sys_fcntl(unsigned int fd, unsigned int cmd, unsigned long arg)
 	struct task_struct *p;
 	int task_found = 0;
 
-	if (fd >= NR_OPEN || !(filp = current->files->fd[fd]))
+	if (fd >= current->files->max_fds || !(filp = current->files->fd[fd]))
 		return -EBADF;
 	switch (cmd) {
 		//复制一个现有的描述符
@@ -140,7 +132,7 @@ asmlinkage int sys_fcntl(unsigned int fd, unsigned int cmd, unsigned long arg)
 		//如果返回值和FD_CLOEXEC进行与运算结果是0的话，文件保持交叉式访问exec()，
 		//否则如果通过exec运行的话，文件将被关闭(arg 被忽略)  
 		case F_GETFD:
-			return FD_ISSET(fd, &current->files->close_on_exec);
+			return test_bit(fd, current->files->close_on_exec);
 		//设置close-on-exec标志，该标志以参数arg的FD_CLOEXEC位决定，
 		//应当了解很多现存的涉及文件描述符标志的程序并不使用常数 FD_CLOEXEC，
 		//而是将此标志设置为0(系统默认，在exec时不关闭)或1(在exec时关闭)
@@ -148,9 +140,9 @@ asmlinkage int sys_fcntl(unsigned int fd, unsigned int cmd, unsigned long arg)
 		//然后按照希望修改它，最后设置新标志值。不能只是执行F_SETFD或F_SETFL命令，这样会关闭以前设置的标志位。 
 		case F_SETFD:
 			if (arg&1)
-				FD_SET(fd, &current->files->close_on_exec);
+				set_bit(fd, current->files->close_on_exec);
 			else
-				FD_CLR(fd, &current->files->close_on_exec);
+				clear_bit(fd, current->files->close_on_exec);
 			return 0;
 		//取得fd的文件状态标志，如同下面的描述一样(arg被忽略)，在说明open函数时，已说明
 		//了文件状态标志。不幸的是，三个存取方式标志 (O_RDONLY , O_WRONLY , 以及O_RDWR)并不各占1位。
@@ -260,6 +252,9 @@ asmlinkage int sys_fcntl(unsigned int fd, unsigned int cmd, unsigned long arg)
 			if (S_ISSOCK (filp->f_inode->i_mode))
 				sock_fcntl (filp, F_SETOWN, arg);
 			return 0;
+		case F_SETPIPE_SZ:
+		case F_GETPIPE_SZ:
+			return pipe_fcntl(filp, cmd, arg);
 		default:
 			/* sockets need a few special fcntls. */
 			if (S_ISSOCK (filp->f_inode->i_mode))
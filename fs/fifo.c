@@ -221,6 +221,7 @@ static int fifo_open(struct inode * inode,struct file * filp)
 	PIPE_LOCK(*inode) = 0;
 	PIPE_START(*inode) = PIPE_LEN(*inode) = 0;
 	PIPE_BASE(*inode) = (char *) page;
+	PIPE_PAGES(*inode) = 1;
 	return 0;
 }
 
@@ -67,8 +67,14 @@ static void put_last_free(struct file *file)
 	file->f_next->f_prev = file;
 }
 
+/*
+ * Files not in use (f_count == 0) are kept together at the head of the
+ * ring: put_filp() moves a file there when its last reference goes, and
+ * grow_files() adds new ones there.  get_empty_filp() then only has to
+ * look at first_file.
+ */
 //增加内核中struct_file数据结构个数
-void grow_files(void)
+static int grow_files(void)
 {
 	struct file * file;
 	int i;
@@ -76,7 +82,7 @@ void grow_files(void)
 	file = (struct file *) get_free_page(GFP_KERNEL);
 
 	if (!file)
-		return;
+		return 0;
 
 	nr_files+=i= PAGE_SIZE/sizeof(struct file);
 
@@ -85,6 +91,7 @@ void grow_files(void)
 
 	for (; i ; i--)
 		insert_file_free(file++);
+	return 1;
 }
 
 unsigned long file_table_init(unsigned long start, unsigned long end)
@@ -96,24 +103,31 @@ unsigned long file_table_init(unsigned long start, unsigned long end)
 //获取一个空的file结构
 struct file * get_empty_filp(void)
 {
-	int i;
 	struct file * f;
 
-	if (!first_file)
-		grow_files();
-repeat:
-	for (f = first_file, i=0; i < nr_files; i++, f = f->f_next)
-		if (!f->f_count) {
-			remove_file_free(f);
-			memset(f,0,sizeof(*f));
-			put_last_free(f);
-			f->f_count = 1;
-			f->f_version = ++event;
-			return f;
-		}
-	if (nr_files < NR_FILE) {
-		grow_files();
-		goto repeat;
+	while (!first_file || first_file->f_count) {
+		if (!grow_files())
+			return NULL;
 	}
-	return NULL;
+	f = first_file;
+	remove_file_free(f);
+	memset(f,0,sizeof(*f));
+	put_last_free(f);
+	f->f_count = 1;
+	f->f_version = ++event;
+	return f;
+}
+
+/*
+ * Drop a reference to a file.  The caller has already done whatever
+ * release and iput() the last reference needs.
+ */
+void put_filp(struct file * file)
+{
+	if (--file->f_count)
+		return;
+	if (file == first_file)
+		return;
+	remove_file_free(file);
+	insert_file_free(file);
 }
@@ -39,6 +39,27 @@ static struct inode * first_inode;
 static struct wait_queue * inode_wait = NULL;
 static int nr_inodes = 0, nr_free_inodes = 0;
 
+/*
+ * Unused inodes (i_count == 0) are also on one of two LRU rings, linked
+ * through i_lru_next/i_lru_prev, oldest first: clean ones, which
+ * get_empty_inode() can take straight away, and dirty ones, which have
+ * to be written first.  The first_inode ring still holds every inode,
+ * for the per-device walks.
+ *
+ * Inodes come a page at a time, and there is no fixed limit on their
+ * number: the cache grows while more than 3/4 of it is in use, and
+ * shrink_inodes() gives back pages whose inodes are all unused and
+ * clean when memory is short.
+ */
+static struct inode * clean_inodes = NULL;
+static struct inode * dirty_inodes = NULL;
+static int nr_clean_inodes = 0, nr_dirty_inodes = 0;
+static int nr_inode_pages = 0;
+static int inode_walkers = 0;	/* walks of first_inode that may sleep */
+static unsigned long inodes_grown = 0, inodes_shrunk = 0, inodes_recycled = 0;
+
+#define INODES_PER_PAGE	(PAGE_SIZE / sizeof(struct inode))
+
 static inline int const hashfn(dev_t dev, unsigned int i)
 {
 	return (dev ^ i) % NR_IHASH;
@@ -52,6 +73,10 @@ static inline struct inode_hash_entry * const hash(dev_t dev, int i)
 //将一个inode插入到first_inode所指向的链表头部
 static void insert_inode_free(struct inode *inode)
 {
+	if (!first_inode) {
+		inode->i_next = inode->i_prev = first_inode = inode;
+		return;
+	}
 	inode->i_next = first_inode;
 	inode->i_prev = first_inode->i_prev;
 	inode->i_next->i_prev = inode;
@@ -62,6 +87,8 @@ static void insert_inode_free(struct inode *inode)
 //将指定的inode节点从first_inode所指向的链表中删除
 static void remove_inode_free(struct inode *inode)
 {
+	if (inode->i_next == inode)
+		first_inode = NULL;
 	if (first_inode == inode)
 		first_inode = first_inode->i_next;
 	if (inode->i_next)
@@ -102,18 +129,61 @@ static void remove_inode_hash(struct inode *inode)
 	inode->i_hash_prev = inode->i_hash_next = NULL;
 }
 
-//将指定的inode移到first_inode所指向的链表尾部，即first_inode之前
-static void put_last_free(struct inode *inode)
+static void insert_inode_lru(struct inode *inode)
 {
-	remove_inode_free(inode);	//现将此inode从链表中移除
-	inode->i_prev = first_inode->i_prev;
-	inode->i_prev->i_next = inode;
-	inode->i_next = first_inode;
-	inode->i_next->i_prev = inode;
+	struct inode ** head = inode->i_dirt ? &dirty_inodes : &clean_inodes;
+
+	inode->i_lru_dirty = inode->i_dirt;
+	if (inode->i_dirt)
+		nr_dirty_inodes++;
+	else
+		nr_clean_inodes++;
+	if (!*head) {
+		inode->i_lru_next = inode->i_lru_prev = *head = inode;
+		return;
+	}
+	inode->i_lru_next = *head;
+	inode->i_lru_prev = (*head)->i_lru_prev;
+	inode->i_lru_next->i_lru_prev = inode;
+	inode->i_lru_prev->i_lru_next = inode;
+}
+
+static void remove_inode_lru(struct inode *inode)
+{
+	struct inode ** head;
+
+	if (!inode->i_lru_next)
+		return;
+	if (inode->i_lru_dirty) {
+		head = &dirty_inodes;
+		nr_dirty_inodes--;
+	} else {
+		head = &clean_inodes;
+		nr_clean_inodes--;
+	}
+	if (inode->i_lru_next == inode)
+		*head = NULL;
+	else {
+		if (*head == inode)
+			*head = inode->i_lru_next;
+		inode->i_lru_next->i_lru_prev = inode->i_lru_prev;
+		inode->i_lru_prev->i_lru_next = inode->i_lru_next;
+	}
+	inode->i_lru_next = inode->i_lru_prev = NULL;
+}
+
+/*
+ * Put an unused inode (back) on the ring that matches its i_dirt.
+ */
+static void refile_inode(struct inode *inode)
+{
+	remove_inode_lru(inode);
+	if (!inode->i_count)
+		insert_inode_lru(inode);
 }
 
 //增加内核中的inode结构数
-void grow_inodes(void)
+static void grow_inodes(void)
 {
 	struct inode * inode;
 	int i;
@@ -123,17 +193,74 @@ void grow_inodes(void)
 		return;
 
 	//一页内存所能容纳的inode数
-	i=PAGE_SIZE / sizeof(struct inode);
+	i = INODES_PER_PAGE;
 	nr_inodes += i;	//增加当前内核中的inode总数
 	nr_free_inodes += i;	//增加当前内核中的空闲inode总数
+	nr_inode_pages++;
+	inodes_grown++;
 
-	//如果first_inode链表为空，则将此也内存中的第一个inode链入first_inode链表（只用于首次初始化）
-	if (!first_inode)
-		inode->i_next = inode->i_prev = first_inode = inode++, i--;
-	
-	//将其余的inode插入链表
-	for ( ; i ; i-- )
-		insert_inode_free(inode++);
+	for ( ; i ; i-- ) {
+		insert_inode_free(inode);
+		insert_inode_lru(inode++);
+	}
+}
+
+static inline int inode_freeable(struct inode * inode)
+{
+	return !inode->i_count && !inode->i_dirt && !inode->i_lock &&
+		!inode->i_wait && !inode->i_sem.wait && !inode->i_mount &&
+		!inode->i_mmap;
+}
+
+/*
+ * Called by try_to_free_page(): look at up to nr_clean_inodes >> priority
+ * of the least recently used clean inodes, and free the first page
+ * whose inodes are all unused.  Doesn't sleep.  Nothing is freed while
+ * someone walking the first_inode ring is asleep, as the page could hold
+ * the inode the walk resumes from.
+ */
+int shrink_inodes(int priority)
+{
+	struct inode * inode, * first;
+	int i, count;
+
+	if (inode_walkers)
+		return 0;
+	count = (nr_clean_inodes >> priority) + 1;
+	for (inode = clean_inodes ; inode && count-- ; inode = inode->i_lru_next) {
+		first = (struct inode *) ((unsigned long) inode & PAGE_MASK);
+		for (i = 0 ; i < INODES_PER_PAGE ; i++)
+			if (!inode_freeable(first + i))
+				break;
+		if (i < INODES_PER_PAGE)
+			continue;
+		for (i = 0 ; i < INODES_PER_PAGE ; i++) {
+			remove_inode_hash(first + i);
+			remove_inode_lru(first + i);
+			remove_inode_free(first + i);
+		}
+		nr_inodes -= INODES_PER_PAGE;
+		nr_free_inodes -= INODES_PER_PAGE;
+		nr_inode_pages--;
+		inodes_shrunk++;
+		free_page((unsigned long) first);
+		return 1;
+	}
+	return 0;
+}
+
+int get_inode_info(char * buffer)
+{
+	return sprintf(buffer, "inodes:    %8d\n"
+		"unused:    %8d\n"
+		"clean:     %8d\n"
+		"dirty:     %8d\n"
+		"pages:     %8d\n"
+		"grown:     %8lu\n"
+		"shrunk:    %8lu\n"
+		"recycled:  %8lu\n",
+		nr_inodes, nr_free_inodes, nr_clean_inodes, nr_dirty_inodes,
+		nr_inode_pages, inodes_grown, inodes_shrunk, inodes_recycled);
 }
 
 unsigned long inode_init(unsigned long start, unsigned long end)
@@ -204,6 +331,7 @@ void clear_inode(struct inode * inode)
 	wait_on_inode(inode);
 	remove_inode_hash(inode);
 	remove_inode_free(inode);
+	remove_inode_lru(inode);
 	wait = ((volatile struct inode *) inode)->i_wait;
 	//如果i_count非零，则说明释放节点之前，此节点被占用，则释放后，空闲节点加一
 	if (inode->i_count)
@@ -212,6 +340,7 @@ void clear_inode(struct inode * inode)
 	memset(inode,0,sizeof(*inode));
 	((volatile struct inode *) inode)->i_wait = wait;
 	insert_inode_free(inode);
+	insert_inode_lru(inode);
 }
 
 int fs_may_mount(dev_t dev)
@@ -219,16 +348,20 @@ int fs_may_mount(dev_t dev)
 	struct inode * inode, * next;
 	int i;
 
+	inode_walkers++;
 	next = first_inode;
 	for (i = nr_inodes ; i > 0 ; i--) {
 		inode = next;
 		next = inode->i_next;	/* clear_inode() changes the queues.. */
 		if (inode->i_dev != dev)
 			continue;
-		if (inode->i_count || inode->i_dirt || inode->i_lock)
+		if (inode->i_count || inode->i_dirt || inode->i_lock) {
+			inode_walkers--;
 			return 0;
+		}
 		clear_inode(inode);
 	}
+	inode_walkers--;
 	return 1;
 }
 
@@ -277,11 +410,13 @@ static void write_inode(struct inode * inode)
 		return;
 	if (!inode->i_sb || !inode->i_sb->s_op || !inode->i_sb->s_op->write_inode) {
 		inode->i_dirt = 0;
+		refile_inode(inode);
 		return;
 	}
 	inode->i_lock = 1;		//加锁
 	inode->i_sb->s_op->write_inode(inode);	//VFS调用具体的文件系统例程
 	unlock_inode(inode);	//解锁
+	refile_inode(inode);
 }
 
 //从磁盘读入指定的inode结构信息至内存
@@ -411,6 +546,7 @@ void invalidate_inodes(dev_t dev)
 	struct inode * inode, * next;
 	int i;
 
+	inode_walkers++;
 	next = first_inode;
 	for(i = nr_inodes ; i > 0 ; i--) {
 		inode = next;
@@ -423,6 +559,7 @@ void invalidate_inodes(dev_t dev)
 		}
 		clear_inode(inode);
 	}
+	inode_walkers--;
 }
 
 //同步指定设备的inode
@@ -431,6 +568,7 @@ void sync_inodes(dev_t dev)
 	int i;
 	struct inode * inode;
 
+	inode_walkers++;
 	inode = first_inode;
 	//遍历两次 why？
 	for(i = 0; i < nr_inodes*2; i++, inode = inode->i_next) {
@@ -441,6 +579,7 @@ void sync_inodes(dev_t dev)
 		if (inode->i_dirt)
 			write_inode(inode);
 	}
+	inode_walkers--;
 }
 
 //释放inode结构
@@ -465,11 +604,8 @@ repeat:
 		return;
 	}
 	wake_up(&inode_wait);
-	if (inode->i_pipe) {
-		unsigned long page = (unsigned long) PIPE_BASE(*inode);
-		PIPE_BASE(*inode) = NULL;
-		free_page(page);
-	}
+	if (inode->i_pipe)
+		pipe_free_buffers(inode);
 	if (inode->i_sb && inode->i_sb->s_op && inode->i_sb->s_op->put_inode) {
 		inode->i_sb->s_op->put_inode(inode);
 		if (!inode->i_nlink)
@@ -487,36 +623,29 @@ repeat:
 		inode->i_mmap = NULL;
 	}
 	nr_free_inodes++;
+	refile_inode(inode);
 	return;
 }
 
 struct inode * get_empty_inode(void)
 {
-	struct inode * inode, * best;
-	int i;
+	struct inode * inode;
+
 	//如果到了这个界限，需要增加inode节点
-	if (nr_inodes < NR_INODE && nr_free_inodes < (nr_inodes >> 2))
+	if (nr_free_inodes < (nr_inodes >> 2))
 		grow_inodes();
 repeat:
-	inode = first_inode;
-	best = NULL;
-	for (i = 0; i<nr_inodes; inode = inode->i_next, i++) {
-		if (!inode->i_count) {
-			if (!best)
-				best = inode;
-			if (!inode->i_dirt && !inode->i_lock) {
-				best = inode;
-				break;
-			}
-		}
-	}
-	if (!best || best->i_dirt || best->i_lock)
-		if (nr_inodes < NR_INODE) {
-			grow_inodes();
+	inode = clean_inodes;
+	if (!inode) {
+		inode = dirty_inodes;
+		if (inode) {
+			write_inode(inode);
+			refile_inode(inode);
 			goto repeat;
 		}
-	inode = best;
-	if (!inode) {
+		grow_inodes();
+		if (clean_inodes)
+			goto repeat;
 		printk("VFS: No free inodes - contact Linus\n");
 		sleep_on(&inode_wait);
 		goto repeat;
@@ -525,13 +654,14 @@ repeat:
 		wait_on_inode(inode);
 		goto repeat;
 	}
-	if (inode->i_dirt) {
-		write_inode(inode);
+	if (inode->i_dirt || inode->i_count) {
+		refile_inode(inode);
 		goto repeat;
 	}
-	if (inode->i_count)
-		goto repeat;
+	if (inode->i_dev)
+		inodes_recycled++;
 	clear_inode(inode);
+	remove_inode_lru(inode);
 	inode->i_count = 1;
 	inode->i_nlink = 1;
 	inode->i_version = ++event;
@@ -555,6 +685,7 @@ struct inode * get_pipe_inode(void)
 		iput(inode);
 		return NULL;
 	}
+	PIPE_PAGES(*inode) = 1;
 	inode->i_op = &pipe_inode_operations;
 	inode->i_count = 2;	/* sum of readers/writers */
 	PIPE_WAIT(*inode) = NULL;
@@ -602,14 +733,15 @@ repeat:
 	inode->i_dev = sb->s_dev;
 	inode->i_ino = nr;
 	inode->i_flags = sb->s_flags;
-	put_last_free(inode);		//将inode节点移到first_inode尾部
 	insert_inode_hash(inode);	//将新的inode插入相应的hash表项
 	read_inode(inode);	//从磁盘读取相关信息，由此可见，hash表中的inode有高速缓冲之意
 	goto return_it;
 
 found_it:
-	if (!inode->i_count)
+	if (!inode->i_count) {
 		nr_free_inodes--;
+		remove_inode_lru(inode);
+	}
 	inode->i_count++;
 	wait_on_inode(inode);
 	if (inode->i_dev != sb->s_dev || inode->i_ino != nr) {
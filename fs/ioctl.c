@@ -22,6 +22,7 @@
 	（在同一个源文件中），而其它任何请求都分派给特定设备的ioctl()函数
 */
 #include <asm/segment.h>
+#include <asm/bitops.h>
 
 #include <linux/sched.h>
 #include <linux/mm.h>
@@ -77,18 +78,18 @@ asmlinkage int sys_ioctl(unsigned int fd, unsigned int cmd, unsigned long arg)
 	struct file * filp;
 	int on;
 
-	if (fd >= NR_OPEN || !(filp = current->files->fd[fd]))
+	if (fd >= current->files->max_fds || !(filp = current->files->fd[fd]))
 		return -EBADF;
 	switch (cmd) {
 		//设置 close-on-exec 标志(File IOctl Close on EXec) 
 		//设置这个标志使文件描述符被关闭
 		case FIOCLEX:
-			FD_SET(fd, &current->files->close_on_exec);
+			set_bit(fd, current->files->close_on_exec);
 			return 0;
 
 		//清除 close-no-exec 标志(File IOctl Not CLose on EXec)
 		case FIONCLEX:
-			FD_CLR(fd, &current->files->close_on_exec);
+			clear_bit(fd, current->files->close_on_exec);
 			return 0;
 
 		case FIONBIO:
@@ -51,6 +51,7 @@
 #include <linux/errno.h>
 #include <linux/stat.h>
 #include <linux/fcntl.h>
+#include <linux/mm.h>
 
 #define OFFSET_MAX	((off_t)0x7fffffff)	/* FIXME: move elsewhere? */
 
@@ -58,16 +59,24 @@ static int copy_flock(struct file *filp, struct file_lock *fl, struct flock *l);
 static int conflict(struct file_lock *caller_fl, struct file_lock *sys_fl);
 static int overlap(struct file_lock *fl1, struct file_lock *fl2);
 static int lock_it(struct file *filp, struct file_lock *caller);
-static struct file_lock *alloc_lock(struct file_lock **pos, struct file_lock *fl);
-static void free_lock(struct file_lock **fl);
+static struct file_lock *find_conflict(struct file_lock *n, struct file_lock *caller);
+static void find_owned(struct file_lock *n, off_t start, off_t end,
+		       struct task_struct *owner, struct file_lock **list);
+static struct file_lock *alloc_lock(void);
+static void free_lock(struct inode *inode, struct file_lock *fl);
+static void lock_insert(struct inode *inode, struct file_lock *fl);
+static void lock_remove(struct inode *inode, struct file_lock *fl);
 #ifdef DEADLOCK_DETECTION
-int locks_deadlocked(int my_pid,int blocked_pid);
+struct lock_wait {
+	struct task_struct *lw_task;	/* sleeping in F_SETLKW */
+	struct task_struct *lw_blocker;	/* owner of the lock it waits on */
+	struct lock_wait *lw_next;
+};
+static int locks_deadlocked(struct task_struct *me, struct task_struct *blocker);
+static void lock_wait_add(struct lock_wait *lw, struct task_struct *blocker);
+static void lock_wait_del(struct lock_wait *lw);
 #endif
 
-//内核将所有的内核文件锁链接成一个双向链表，file_lock_table就指向该链表的头节点
-//检查是否发生死锁会用到这个链表
-static struct file_lock *file_lock_table = NULL;
-
 /*
 	这个接口是获取锁的相关信息： 这个接口会修改我们传入的struct flock。
 	如果探测了一番，发现根本就没有进程对该文件指定数据段加锁，那么了l_type会被修改成F_UNLCK
@@ -80,7 +89,7 @@ int fcntl_getlk(unsigned int fd, struct flock *l)
 	struct file *filp;
 	struct file_lock *fl,file_lock;
 
-	if (fd >= NR_OPEN || !(filp = current->files->fd[fd]))
+	if (fd >= current->files->max_fds || !(filp = current->files->fd[fd]))
 		return -EBADF;
 	error = verify_area(VERIFY_WRITE,l, sizeof(*l));
 	if (error)
@@ -95,20 +104,17 @@ int fcntl_getlk(unsigned int fd, struct flock *l)
 	if (!copy_flock(filp, &file_lock, &flock))
 		return -EINVAL;
 
-	//遍历该文件当前所有的文件锁
-	for (fl = filp->f_inode->i_flock; fl != NULL; fl = fl->fl_next) {
-		//若链表中的锁有与由请求锁变量构造的文件锁冲突的，则表明查找到了我们想要
-		//获取的锁 然后把此锁的相关信息复制到请求锁变量中，返回给用户
-		if (conflict(&file_lock, fl)) {
-			flock.l_pid = fl->fl_owner->pid;	//此锁所属的进程id
-			flock.l_start = fl->fl_start;
-			flock.l_len = fl->fl_end == OFFSET_MAX ? 0 :
-				fl->fl_end - fl->fl_start + 1;
-			flock.l_whence = fl->fl_whence;
-			flock.l_type = fl->fl_type;
-			memcpy_tofs(l, &flock, sizeof(flock));	//复制到用户空间
-			return 0;
-		}
+	/* The first conflicting lock, if any, goes back to the user ... */
+	fl = find_conflict(filp->f_inode->i_flock, &file_lock);
+	if (fl) {
+		flock.l_pid = fl->fl_owner->pid;	//此锁所属的进程id
+		flock.l_start = fl->fl_start;
+		flock.l_len = fl->fl_end == OFFSET_MAX ? 0 :
+			fl->fl_end - fl->fl_start + 1;
+		flock.l_whence = fl->fl_whence;
+		flock.l_type = fl->fl_type;
+		memcpy_tofs(l, &flock, sizeof(flock));	//复制到用户空间
+		return 0;
 	}
 
 	//执行到这里，说明没有与之冲突的文件锁，即没有我们想要获取的锁
@@ -131,12 +137,15 @@ int fcntl_setlk(unsigned int fd, unsigned int cmd, struct flock *l)
 	struct file *filp;
 	struct file_lock *fl,file_lock;
 	struct flock flock;
+#ifdef DEADLOCK_DETECTION
+	struct lock_wait wait;
+#endif
 
 	/*
 	 * Get arguments and validate them ...
 	 */
 
-	if (fd >= NR_OPEN || !(filp = current->files->fd[fd]))
+	if (fd >= current->files->max_fds || !(filp = current->files->fd[fd]))
 		return -EBADF;
 	error = verify_area(VERIFY_READ, l, sizeof(*l));
 	if (error)
@@ -183,13 +192,9 @@ int fcntl_setlk(unsigned int fd, unsigned int cmd, struct flock *l)
 	//如果不是要求内核解锁相应的锁，即是要求设置相应的锁
 	if (file_lock.fl_type != F_UNLCK) {
 repeat:
-		//遍历该文件的内核文件锁链表
-		for (fl = filp->f_inode->i_flock; fl != NULL; fl = fl->fl_next) {
-			//如果内核文件锁与请求锁不冲突（即无关），则继续遍历下一项文件锁
-			//否则进行下面的处理，若cmd == F_SETLKW，则内核会阻塞调用进程
-			//直到被唤醒(独占锁被解锁？)...
-			if (!conflict(&file_lock, fl))
-				continue;
+		/* Look for a conflicting lock in this file's tree ... */
+		fl = find_conflict(filp->f_inode->i_flock, &file_lock);
+		if (fl) {
 			/*
 			 * File is locked by another process. If this is
 			 * F_SETLKW wait for the lock to be released.
@@ -207,14 +212,18 @@ repeat:
 					return -ERESTARTSYS;
 #ifdef DEADLOCK_DETECTION
 				//检查是否产生死锁
-				if (locks_deadlocked(file_lock.fl_owner->pid,fl->fl_owner->pid))
+				if (locks_deadlocked(current, fl->fl_owner))
 					return -EDEADLOCK;
+				lock_wait_add(&wait, fl->fl_owner);
 #endif
 				interruptible_sleep_on(&fl->fl_wait);
+#ifdef DEADLOCK_DETECTION
+				lock_wait_del(&wait);
+#endif
 				//睡眠期间，进程可能收到信号
 				if (current->signal & ~current->blocked)
 					return -ERESTARTSYS;
-				goto repeat;	//退出大循环的条件是，当文件锁链表中没有与请求锁冲突的锁时
+				goto repeat;	//退出循环的条件是，当文件锁树中没有与请求锁冲突的锁时
 			}
 			//执行到这里说明cmd==F_SETLK
 			//F_SETLK被用来实现共享(或读)锁(F_RDLCK)或独占(写)锁(F_WRLCK)，同样可以去掉这两种锁(F_UNLCK)。
@@ -233,35 +242,63 @@ repeat:
 
 #ifdef DEADLOCK_DETECTION
 /*
- * This function tests for deadlock(死锁) condition before putting a process to sleep
- * this detection scheme is recursive... we may need some test as to make it
- * exit if the function gets stuck due to bad lock data.
+ * Every task sleeping in F_SETLKW records, in a hash on its task
+ * pointer, the owner of the lock it is waiting for.  A task waits on
+ * one lock at a time, so these edges form chains, and a caller about
+ * to sleep on {blocker} would deadlock exactly when the chain starting
+ * at {blocker} leads back to it.  The entries live on the sleepers'
+ * stacks.
  */
 
- //检查在等待锁之间的进程有没有产生死锁条件 然后把当前进程插入到阻塞进程的循环链表中 并挂起当前进程
-int locks_deadlocked(int my_pid,int blocked_pid)
+#define LOCK_WAIT_HASH	64	/* must be a power of two */
+#define lock_wait_head(p) \
+	(&lock_wait_hash[((unsigned long) (p) >> PAGE_SHIFT) & (LOCK_WAIT_HASH - 1)])
+
+static struct lock_wait *lock_wait_hash[LOCK_WAIT_HASH];
+
+static struct task_struct *lock_blocker(struct task_struct *task)
 {
-	int ret_val;
-	struct wait_queue *dlock_wait;
-	struct file_lock *fl;
-	for (fl = file_lock_table; fl != NULL; fl = fl->fl_nextlink) {
-		if (fl->fl_owner == NULL) continue;	/* not a used lock */
-		if (fl->fl_owner->pid != my_pid) continue;
-		if (fl->fl_wait == NULL) continue;	/* no queues */
-		dlock_wait = fl->fl_wait;
-		do {
-			if (dlock_wait->task != NULL) {
-				if (dlock_wait->task->pid == blocked_pid)
-					return -EDEADLOCK;
-				ret_val = locks_deadlocked(dlock_wait->task->pid,blocked_pid);
-				if (ret_val)
-					return -EDEADLOCK;
-			}
-			dlock_wait = dlock_wait->next;
-		} while (dlock_wait != fl->fl_wait);
+	struct lock_wait *lw;
+
+	for (lw = *lock_wait_head(task); lw != NULL; lw = lw->lw_next)
+		if (lw->lw_task == task)
+			return lw->lw_blocker;
+	return NULL;
+}
+
+static int locks_deadlocked(struct task_struct *me, struct task_struct *blocker)
+{
+	int depth = 0;
+
+	/* the depth limit only guards against a corrupted map */
+	while (blocker != NULL && depth++ < NR_TASKS) {
+		if (blocker == me)
+			return 1;
+		blocker = lock_blocker(blocker);
 	}
 	return 0;
 }
+
+static void lock_wait_add(struct lock_wait *lw, struct task_struct *blocker)
+{
+	struct lock_wait **head = lock_wait_head(current);
+
+	lw->lw_task = current;
+	lw->lw_blocker = blocker;
+	lw->lw_next = *head;
+	*head = lw;
+}
+
+static void lock_wait_del(struct lock_wait *lw)
+{
+	struct lock_wait **p = lock_wait_head(lw->lw_task);
+
+	for ( ; *p != NULL; p = &(*p)->lw_next)
+		if (*p == lw) {
+			*p = lw->lw_next;
+			return;
+		}
+}
 #endif
 
 /*
@@ -271,24 +308,15 @@ int locks_deadlocked(int my_pid,int blocked_pid)
  //释放指定文件的锁锁主为指定进程的锁
 void fcntl_remove_locks(struct task_struct *task, struct file *filp)
 {
-	struct file_lock *fl;
-	struct file_lock **before;
-
-	/* Find first lock owned by caller ... */
- 
-	//before指向该文件的文件锁链表头
-	before = &filp->f_inode->i_flock;
-	//遍历该文件锁链表，找到锁主进程是task的锁
-	while ((fl = *before) && task != fl->fl_owner)
-		before = &fl->fl_next;
-
-	/* The list is sorted by owner and fd ... */
-
-	//上面的注释指出：文件锁链表已经按照锁主和fd排序
-	//所以以下的while循环可以遍历到该文件锁锁主是task的锁
-	//然后释放锁
-	while ((fl = *before) && task == fl->fl_owner)
-		free_lock(before);
+	struct inode *inode = filp->f_inode;
+	struct file_lock *fl, *list = NULL;
+
+	/* Gather every lock the task holds on the file, then drop them ... */
+	find_owned(inode->i_flock, 0, OFFSET_MAX, task, &list);
+	while ((fl = list) != NULL) {
+		list = fl->fl_next;
+		free_lock(inode, fl);
+	}
 }
 
 /*
@@ -368,175 +396,108 @@ static int overlap(struct file_lock *fl1, struct file_lock *fl2)
  * Add a lock to a file ...
  * Result is 0 for success or -ENOLCK.
  *
- * We merge(合并) adjacent locks whenever possible.
+ * We merge adjacent locks whenever possible.
  *
  * WARNING: We assume the lock doesn't conflict with any other lock.
  */
-  
+
 /*
- * Rewritten by Kai Petzke:
- * We sort the lock list first by owner, then by the starting address.
- *
- * To make freeing a lock much faster, we keep a pointer to the lock before the
- * actual one. But the real gain of the new coding was, that lock_it() and
- * unlock_it() became one function.
- *
- * To all purists: Yes, I use a few goto's. Just pass on to the next function.
+ * The caller's own locks never overlap each other.  Those that touch the
+ * new range, or border it, are gathered from the tree first: the ones of
+ * the same type are merged into the new lock, and the rest are cut back
+ * to make room for it, or dropped if it covers them.  Any lock we need
+ * is allocated before the tree is changed, so -ENOLCK leaves the old
+ * locks as they were.  Only the caller can change its own locks, so the
+ * gathered list stays good if kmalloc() sleeps.
  */
 
- //锁链表首先以锁主进程排序，再以开始地址排序
- //新旧锁若类型不一致，新锁会覆盖与旧锁重叠的范围
- //理解了这一点，代码中的left\right就很容易理解了
- //注：新旧锁锁主一致
- //函数内的+1和-1操作是为了保证两个锁之间没有重叠的边界范围，即对于文件内的任一字节，只属于一个锁
 static int lock_it(struct file *filp, struct file_lock *caller)
 {
-	struct file_lock *fl;
-	struct file_lock *left = 0;
-	struct file_lock *right = 0;
-	struct file_lock **before;
+	struct inode *inode = filp->f_inode;
+	struct file_lock *fl, *next, *list = NULL;
+	struct file_lock *new = NULL, *split = NULL, *right = NULL;
+	off_t start = caller->fl_start;
+	off_t end = caller->fl_end;
 	int added = 0;
 
+	find_owned(inode->i_flock, start - 1,
+		   end == OFFSET_MAX ? end : end + 1, caller->fl_owner, &list);
+
 	/*
-	 * Find the first old lock with the same owner as the new lock.
+	 * The new lock grows over every lock of its own type that it
+	 * touches, and takes over the first of them.
 	 */
-
-	//在文件锁链表中找到首个和指定锁锁主进程一样的锁
-	before = &filp->f_inode->i_flock;
-	while ((fl = *before) && caller->fl_owner != fl->fl_owner)
-		before = &fl->fl_next;
+	if (caller->fl_type != F_UNLCK) {
+		for (fl = list; fl != NULL; fl = fl->fl_next) {
+			if (fl->fl_type != caller->fl_type)
+				continue;
+			if (fl->fl_start < start)
+				start = fl->fl_start;
+			if (fl->fl_end > end)
+				end = fl->fl_end;
+			if (!new)
+				new = fl;
+		}
+		added = (new != NULL);
+	}
 
 	/*
-	 * Look up all locks of this owner.
+	 * A lock of another type that sticks out on both sides of the new
+	 * one is broken in two, so we have to allocate one more lock (in
+	 * this case, even F_UNLCK may fail!).
 	 */
+	for (fl = list; fl != NULL; fl = fl->fl_next)
+		if (fl->fl_type != caller->fl_type &&
+		    fl->fl_start < start && fl->fl_end > end)
+			split = fl;
+	if (caller->fl_type != F_UNLCK && !new) {
+		if (!(new = alloc_lock()))
+			return -ENOLCK;
+	}
+	if (split && !(right = alloc_lock())) {
+		if (new && !added)
+			kfree(new);
+		return -ENOLCK;
+	}
 
-	 //遍历所有和指定锁锁主进程一样的锁
-	while ((fl = *before) && caller->fl_owner == fl->fl_owner) {
-		/*
-		 * Detect(检查) adjacent(相邻) or overlapping regions (if same lock type)
-		 */
-		if (caller->fl_type == fl->fl_type) {
-			//由于相同锁主的锁文件是相邻的，并且按照锁住的文件开始的地址大小排序的
-			//所以我们需要将新的文件锁插入合适的位置上：
-			if (fl->fl_end < caller->fl_start - 1)
-				goto next_lock;
-			/*
-			 * If the next lock in the list has entirely bigger
-			 * addresses than the new one, insert the lock here.
-			 */
-			if (fl->fl_start > caller->fl_end + 1)
-				break;	//找到一个完全可以容纳新锁的锁区域，则break
-						//直接跳到后面caller = alloc_lock(before, caller)函数处
-						//将新锁插入链表即可,如下图所示：
-						//fl:				------
-						//caller:	------
-
-			//执行到这里，有四种情况：（注意重叠的部分）
-			//直线左边是锁范围start，右边是end
-	//		A.
-		//		fl:		------
-		//		caller:		------
-	//		B.
-		//		fl:			--------
-		//		caller:	--------
-	//		C.
-		//		fl:			--------
-		//		caller:		   ----
-	//		D.
-		//		fl:			  ----
-		//		caller:		--------
-		//则根据情况将caller锁定的范围合并到fl锁中去，因为两者是类型一致的锁，所以可以合并
-		
-			/*
-			 * If we come here, the new and old lock are of the
-			 * same type and adjacent or overlapping. Make one
-			 * lock yielding from the lower start address of both
-			 * locks to the higher end address.
-			 */
-			if (fl->fl_start > caller->fl_start)
-				fl->fl_start = caller->fl_start;
-			else
-				caller->fl_start = fl->fl_start;
-			if (fl->fl_end < caller->fl_end)
-				fl->fl_end = caller->fl_end;
-			else
-				caller->fl_end = fl->fl_end;
-			//added应该是一个“合并”标志，记录函数之前的循环是否做过锁的合并操作
-			if (added) {	//若之前做过合并，则由于上面又进行了一次合并，所以可以释放一个锁结构
-				free_lock(before);
-				continue;
-			}
-			caller = fl;
-			added = 1;	//设置合并标志
-			goto next_lock;	//检查下一个锁 如果两个锁类型一致，不会进入到下面不同类型锁的处理
-			//由合并操作可以想到，文件的锁单链表中相同类型的锁必定是互不重叠的，但相邻锁之间可能存在空洞
+	for (fl = list; fl != NULL; fl = next) {
+		next = fl->fl_next;
+		if (fl == new)
+			continue;
+		if (fl->fl_type == caller->fl_type) {
+			/* merged into the new lock */
+			free_lock(inode, fl);
+			continue;
 		}
-		/*
-		 * Processing for different lock types is a bit more complex.
-		 */
-		 //一下四行和上面分析一致
-		if (fl->fl_end < caller->fl_start)
-			goto next_lock;
-		if (fl->fl_start > caller->fl_end)
-			break;
-		//执行到这里，有四种情况：（注意重叠的部分）
-			//直线左边是锁范围start，右边是end
-	//		A.
-		//		fl:		------
-		//		caller:		------
-	//		B.
-		//		fl:			--------
-		//		caller:	--------
-	//		C.
-		//		fl:			--------
-		//		caller:		   ----
-	//		D.
-		//		fl:			  ----
-		//		caller:		--------
-		if (caller->fl_type == F_UNLCK)
-			added = 1;
-		if (fl->fl_start < caller->fl_start)
-			left = fl;
-		/*
-		 * If the next lock in the list has a higher end address than
-		 * the new one, insert the new one here.
-		 */
-		if (fl->fl_end > caller->fl_end) {
-			right = fl;
-			break;
-		}
-		if (fl->fl_start >= caller->fl_start) {
-			/*
-			 * The new lock completely replaces an old one (This may
-			 * happen several times).
-			 */
-			if (added) {
-				free_lock(before);
-				continue;
-			}
-			/*
-			 * Replace the old lock with the new one. Wake up
-			 * anybody waiting for the old one, as the change in
-			 * lock type might satisfy his needs.
-			 */
-			wake_up(&fl->fl_wait);
-			fl->fl_start = caller->fl_start;
-			fl->fl_end   = caller->fl_end;
-			fl->fl_type  = caller->fl_type;
-			caller = fl;
-			added = 1;
+		if (fl->fl_end < start || fl->fl_start > end)
+			continue;
+		if (fl->fl_start >= start && fl->fl_end <= end) {
+			/* The new lock completely replaces an old one. */
+			free_lock(inode, fl);
+			continue;
 		}
 		/*
-		 * Go on to next lock.
+		 * Cut the old lock back. Wake up anybody waiting for it,
+		 * as the freed range might satisfy his needs.
 		 */
-next_lock:
-		before = &(*before)->fl_next;
+		lock_remove(inode, fl);
+		if (fl == split) {
+			right->fl_owner = fl->fl_owner;
+			right->fl_whence = fl->fl_whence;
+			right->fl_type = fl->fl_type;
+			right->fl_start = end + 1;
+			right->fl_end = fl->fl_end;
+			lock_insert(inode, right);
+			fl->fl_end = start - 1;
+		} else if (fl->fl_start < start)
+			fl->fl_end = start - 1;
+		else
+			fl->fl_start = end + 1;
+		lock_insert(inode, fl);
+		wake_up(&fl->fl_wait);
 	}
 
-	//如果没有进行过合并操作，则进入下面的语句段
-	//会为新锁申请一个内核锁，并插入链表
-	if (! added) {
-		if (caller->fl_type == F_UNLCK) {
+	if (!new) {
 /*
  * XXX - under iBCS-2, attempting to unlock a not-locked region is 
  * 	not considered an error condition, although I'm not sure if this 
@@ -546,66 +507,185 @@ next_lock:
  *	Does Xopen/1170 say anything about this?
  *	- drew@Colorado.EDU
  */
-#if 0
-			return -EINVAL;
-#else
+		return 0;
+	}
+	if (added) {
+		if (new->fl_start == start && new->fl_end == end)
 			return 0;
-#endif
-		}
-		if (! (caller = alloc_lock(before, caller)))
-			return -ENOLCK;
+		lock_remove(inode, new);
+	} else {
+		new->fl_owner = caller->fl_owner;
+		new->fl_whence = caller->fl_whence;
+		new->fl_type = caller->fl_type;
 	}
-	if (right) {
-		if (left == right) {
-			/*
-			 * The new lock breaks the old one in two pieces, so we
-			 * have to allocate one more lock (in this case, even
-			 * F_UNLCK may fail!).
-			 */
-			if (! (left = alloc_lock(before, right))) {
-				if (! added)
-					free_lock(before);
-				return -ENOLCK;
-			}
+	new->fl_start = start;
+	new->fl_end = end;
+	lock_insert(inode, new);
+	return 0;
+}
+
+/*
+ * Each inode's locks are kept in an interval tree: a treap ordered by
+ * fl_start, where every node also records the highest fl_end below it.
+ * A search for locks overlapping [start, end] can then skip any subtree
+ * whose fl_max is below start, and everything right of a node that
+ * starts beyond end, so it costs O(log n) plus the locks it finds.
+ * Priorities come from a simple generator; they only need to be
+ * unrelated to the lock ranges to keep the tree balanced.
+ */
+
+static unsigned long lock_seed = 1;
+
+/*
+ * The first lock, in order of fl_start, that blocks {caller} ...
+ */
+static struct file_lock *find_conflict(struct file_lock *n, struct file_lock *caller)
+{
+	struct file_lock *fl;
+
+	while (n != NULL && n->fl_max >= caller->fl_start) {
+		if ((fl = find_conflict(n->fl_left, caller)) != NULL)
+			return fl;
+		if (n->fl_start > caller->fl_end)
+			break;
+		if (conflict(caller, n))
+			return n;
+		n = n->fl_right;
+	}
+	return NULL;
+}
+
+/*
+ * Chain every lock of {owner} that overlaps [start, end] onto *list,
+ * through fl_next.
+ */
+static void find_owned(struct file_lock *n, off_t start, off_t end,
+		       struct task_struct *owner, struct file_lock **list)
+{
+	while (n != NULL && n->fl_max >= start) {
+		find_owned(n->fl_left, start, end, owner, list);
+		if (n->fl_start > end)
+			break;
+		if (n->fl_owner == owner && n->fl_end >= start) {
+			n->fl_next = *list;
+			*list = n;
 		}
-		right->fl_start = caller->fl_end + 1;
+		n = n->fl_right;
 	}
-	if (left)
-		left->fl_end = caller->fl_start - 1;
-	return 0;
+}
+
+static inline void lock_fixup(struct file_lock *n)
+{
+	n->fl_max = n->fl_end;
+	if (n->fl_left != NULL && n->fl_left->fl_max > n->fl_max)
+		n->fl_max = n->fl_left->fl_max;
+	if (n->fl_right != NULL && n->fl_right->fl_max > n->fl_max)
+		n->fl_max = n->fl_right->fl_max;
+}
+
+static inline int lock_before(struct file_lock *a, struct file_lock *b)
+{
+	return a->fl_start < b->fl_start ||
+		(a->fl_start == b->fl_start && a < b);
+}
+
+static struct file_lock *rotate_right(struct file_lock *n)
+{
+	struct file_lock *l = n->fl_left;
+
+	n->fl_left = l->fl_right;
+	l->fl_right = n;
+	lock_fixup(n);
+	lock_fixup(l);
+	return l;
+}
+
+static struct file_lock *rotate_left(struct file_lock *n)
+{
+	struct file_lock *r = n->fl_right;
+
+	n->fl_right = r->fl_left;
+	r->fl_left = n;
+	lock_fixup(n);
+	lock_fixup(r);
+	return r;
+}
+
+static struct file_lock *tree_insert(struct file_lock *n, struct file_lock *fl)
+{
+	if (n == NULL) {
+		fl->fl_left = fl->fl_right = NULL;
+		fl->fl_max = fl->fl_end;
+		return fl;
+	}
+	if (lock_before(fl, n)) {
+		n->fl_left = tree_insert(n->fl_left, fl);
+		if (n->fl_left->fl_prio > n->fl_prio)
+			return rotate_right(n);
+	} else {
+		n->fl_right = tree_insert(n->fl_right, fl);
+		if (n->fl_right->fl_prio > n->fl_prio)
+			return rotate_left(n);
+	}
+	lock_fixup(n);
+	return n;
+}
+
+static struct file_lock *tree_join(struct file_lock *l, struct file_lock *r)
+{
+	if (l == NULL)
+		return r;
+	if (r == NULL)
+		return l;
+	if (l->fl_prio > r->fl_prio) {
+		l->fl_right = tree_join(l->fl_right, r);
+		lock_fixup(l);
+		return l;
+	}
+	r->fl_left = tree_join(l, r->fl_left);
+	lock_fixup(r);
+	return r;
+}
+
+static struct file_lock *tree_remove(struct file_lock *n, struct file_lock *fl)
+{
+	if (n == NULL) {
+		printk("locks: lock %p not in its tree\n", fl);
+		return NULL;
+	}
+	if (n == fl)
+		return tree_join(fl->fl_left, fl->fl_right);
+	if (lock_before(fl, n))
+		n->fl_left = tree_remove(n->fl_left, fl);
+	else
+		n->fl_right = tree_remove(n->fl_right, fl);
+	lock_fixup(n);
+	return n;
+}
+
+static void lock_insert(struct inode *inode, struct file_lock *fl)
+{
+	inode->i_flock = tree_insert(inode->i_flock, fl);
+}
+
+static void lock_remove(struct inode *inode, struct file_lock *fl)
+{
+	inode->i_flock = tree_remove(inode->i_flock, fl);
 }
 
 /*
- * File_lock() inserts a lock at the position pos of the linked list.
+ * Make a new, unlinked file_lock structure ...
  */
-static struct file_lock *alloc_lock(struct file_lock **pos,
-				    struct file_lock *fl)
+static struct file_lock *alloc_lock(void)
 {
 	struct file_lock *tmp;
 
-	/* Okay, let's make a new file_lock structure... */
 	tmp = (struct file_lock *)kmalloc(sizeof(struct file_lock), GFP_KERNEL);
 	if (!tmp)
 		return tmp;
-	//将新的锁插入内核文件锁链表中
-	tmp->fl_nextlink = file_lock_table;
-	tmp->fl_prevlink = NULL;
-	if (file_lock_table != NULL)
-		file_lock_table->fl_prevlink = tmp;
-	file_lock_table = tmp;
-
-	//将文件锁插入文件单链表中
-	tmp->fl_next = *pos;	/* insert into file's list */
-	*pos = tmp;
-
-	tmp->fl_owner = current;
 	tmp->fl_wait = NULL;
-
-	tmp->fl_type = fl->fl_type;
-	tmp->fl_whence = fl->fl_whence;
-	tmp->fl_start = fl->fl_start;
-	tmp->fl_end = fl->fl_end;
-
+	lock_seed = lock_seed * 1103515245 + 12345;
+	tmp->fl_prio = lock_seed;
 	return tmp;
 }
 
@@ -613,30 +693,14 @@ static struct file_lock *alloc_lock(struct file_lock **pos,
  * Free up a lock...
  */
 
- //释放指定的文件锁，就是将其从文件锁链表中移除
+ //释放指定的文件锁，就是将其从文件的锁树中移除
  //并释放锁结构
- //现将锁从文件的锁单链表中移除
- //再将其从内核文件锁双向链表中移除
-static void free_lock(struct file_lock **fl_p)
+static void free_lock(struct inode *inode, struct file_lock *fl)
 {
-	struct file_lock *fl;
-
-	fl = *fl_p;
-	*fl_p = (*fl_p)->fl_next;	//将锁从文件的锁单链表中移除
-
-	//将锁从内核文件锁双向链表中移除
-	if (fl->fl_nextlink != NULL)
-		fl->fl_nextlink->fl_prevlink = fl->fl_prevlink;
-
-	if (fl->fl_prevlink != NULL)
-		fl->fl_prevlink->fl_nextlink = fl->fl_nextlink;
-	else
-		file_lock_table = fl->fl_nextlink;
+	lock_remove(inode, fl);
 
 	//唤醒等待该锁解锁的进程
 	wake_up(&fl->fl_wait);
 
 	kfree(fl);
-
-	return;
 }
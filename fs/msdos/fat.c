@@ -13,19 +13,36 @@
 #include <linux/errno.h>
 #include <linux/string.h>
 #include <linux/stat.h>
+#include <linux/malloc.h>
 
 #include "msbuffer.h"
 
-static struct fat_cache *fat_cache,cache[FAT_CACHE];
+/* Only the first FAT is written by fat_access. The sectors it changes are
+   noted here and copied to the other FATs by fat_sync, from write_super or
+   when the list fills up, so freeing or growing a long chain copies each
+   FAT sector once instead of once per entry. */
+
+static void fat_dirty(struct super_block *sb,int sector)
+{
+	struct msdos_sb_info *info = MSDOS_SB(sb);
+	int i;
+
+	for (i = 0; i < info->fat_dirty; i++)
+		if (info->fat_dirty_sec[i] == sector) return;
+	while (info->fat_dirty == FAT_DIRTY) fat_sync(sb);
+	info->fat_dirty_sec[info->fat_dirty++] = sector;
+	sb->s_dirt = 1;
+}
+
 
 /* Returns the this'th FAT entry, -1 if it is an end-of-file entry. If
    new_value is != -1, that FAT entry is replaced by it. */
 
 int fat_access(struct super_block *sb,int nr,int new_value)
 {
-	struct buffer_head *bh,*bh2,*c_bh,*c_bh2;
+	struct buffer_head *bh,*bh2;
 	unsigned char *p_first,*p_last;
-	int first,last,next,copy;
+	int first,last,next;
 
 	if ((unsigned) (nr-2) >= MSDOS_SB(sb)->clusters) return 0;
 	if (MSDOS_SB(sb)->fat_bits == 16) first = last = nr*2;
@@ -78,162 +95,200 @@ int fat_access(struct super_block *sb,int nr,int new_value)
 			mark_buffer_dirty(bh2, 1);
 		}
 		mark_buffer_dirty(bh, 1);
-		for (copy = 1; copy < MSDOS_SB(sb)->fats; copy++) {
-			if (!(c_bh = bread(sb->s_dev,MSDOS_SB(sb)->
-			    fat_start+(first >> SECTOR_BITS)+MSDOS_SB(sb)->
-			    fat_length*copy,SECTOR_SIZE))) break;
-			memcpy(c_bh->b_data,bh->b_data,SECTOR_SIZE);
-			mark_buffer_dirty(c_bh, 1);
-			if (bh != bh2) {
-				if (!(c_bh2 = bread(sb->s_dev,
-				    MSDOS_SB(sb)->fat_start+(first >>
-				    SECTOR_BITS)+MSDOS_SB(sb)->fat_length*copy
-				    +1,SECTOR_SIZE))) {
-					brelse(c_bh);
-					break;
-				}
-				memcpy(c_bh2->b_data,bh2->b_data,SECTOR_SIZE);
-				brelse(c_bh2);
-			}
-			brelse(c_bh);
-		}
 	}
 	brelse(bh);
 	if (bh != bh2) brelse(bh2);
+	if (new_value != -1 && MSDOS_SB(sb)->fats > 1) {
+		fat_dirty(sb,first >> SECTOR_BITS);
+		if ((first >> SECTOR_BITS) != (last >> SECTOR_BITS))
+			fat_dirty(sb,last >> SECTOR_BITS);
+	}
 	return next;
 }
 
 
-void cache_init(void)
+/* Copies the FAT sectors changed since the last call to the other FATs. */
+
+void fat_sync(struct super_block *sb)
 {
-	static int initialized = 0;
-	int count;
-
-	if (initialized) return;
-	fat_cache = &cache[0];
-	for (count = 0; count < FAT_CACHE; count++) {
-		cache[count].device = 0;
-		cache[count].next = count == FAT_CACHE-1 ? NULL :
-		    &cache[count+1];
+	unsigned short sector[FAT_DIRTY];
+	struct buffer_head *bh,*c_bh;
+	int count,i,copy;
+
+	count = MSDOS_SB(sb)->fat_dirty;
+	memcpy(sector,MSDOS_SB(sb)->fat_dirty_sec,count*sizeof(sector[0]));
+	MSDOS_SB(sb)->fat_dirty = 0;
+	sb->s_dirt = 0;
+	for (i = 0; i < count; i++) {
+		if (!(bh = bread(sb->s_dev,MSDOS_SB(sb)->fat_start+sector[i],
+		    SECTOR_SIZE))) {
+			printk("bread in fat_sync failed\n");
+			continue;
+		}
+		for (copy = 1; copy < MSDOS_SB(sb)->fats; copy++) {
+			if (!(c_bh = getblk(sb->s_dev,MSDOS_SB(sb)->fat_start+
+			    sector[i]+MSDOS_SB(sb)->fat_length*copy,
+			    SECTOR_SIZE))) break;
+			memcpy(c_bh->b_data,bh->b_data,SECTOR_SIZE);
+			msdos_set_uptodate(sb,c_bh,1);
+			mark_buffer_dirty(c_bh, 1);
+			brelse(c_bh);
+		}
+		brelse(bh);
 	}
-	initialized = 1;
 }
 
 
+/* Each inode keeps a map of the clusters of its chain that have been looked
+   up so far: a sorted array of runs of consecutive disk clusters, covering
+   the first i_ext_mapped clusters of the file. get_cluster extends it as it
+   walks the chain, so any cluster the map covers is found without reading
+   the FAT. Once the map has FAT_EXTENT_MAX runs it stops growing, and the
+   last cluster found beyond it is kept as a hint instead. */
+
 void cache_lookup(struct inode *inode,int cluster,int *f_clu,int *d_clu)
 {
-	struct fat_cache *walk;
+	struct msdos_inode_info *mi = MSDOS_I(inode);
+	struct fat_extent *ext;
+	int lo,hi,mid,f,d;
 
 #ifdef DEBUG
 printk("cache lookup: <%d,%d> %d (%d,%d) -> ",inode->i_dev,inode->i_ino,cluster,
     *f_clu,*d_clu);
 #endif
-	for (walk = fat_cache; walk; walk = walk->next)
-		if (inode->i_dev == walk->device && walk->ino == inode->i_ino &&
-		    walk->file_cluster <= cluster && walk->file_cluster >
-		    *f_clu) {
-			*d_clu = walk->disk_cluster;
-#ifdef DEBUG
-printk("cache hit: %d (%d)\n",walk->file_cluster,*d_clu);
-#endif
-			if ((*f_clu = walk->file_cluster) == cluster) return;
+	if (mi->i_ext_count) {
+		if (cluster < mi->i_ext_mapped) {
+			lo = 0;
+			hi = mi->i_ext_count-1;
+			while (lo < hi) {
+				mid = (lo+hi+1) >> 1;
+				if (mi->i_ext[mid].file_cluster <= cluster) lo = mid;
+				else hi = mid-1;
+			}
+			ext = &mi->i_ext[lo];
+			f = cluster;
+			d = ext->disk_cluster+cluster-ext->file_cluster;
+		}
+		else {
+			ext = &mi->i_ext[mi->i_ext_count-1];
+			f = mi->i_ext_mapped-1;
+			d = ext->disk_cluster+ext->len-1;
+		}
+		if (f > *f_clu) {
+			*f_clu = f;
+			*d_clu = d;
 		}
+	}
+	if (mi->i_hint_file <= cluster && mi->i_hint_file > *f_clu) {
+		*f_clu = mi->i_hint_file;
+		*d_clu = mi->i_hint_disk;
+	}
 #ifdef DEBUG
-printk("cache miss\n");
+printk("(%d,%d)\n",*f_clu,*d_clu);
 #endif
 }
 
 
-#ifdef DEBUG
-static void list_cache(void)
-{
-	struct fat_cache *walk;
-
-	for (walk = fat_cache; walk; walk = walk->next) {
-		if (walk->device)
-			printk("<%d,%d>(%d,%d) ",walk->device,walk->ino,
-			    walk->file_cluster,walk->disk_cluster);
-		else printk("-- ");
-	}
-	printk("\n");
-}
-#endif
-
+/* Records that cluster f_clu of the file is d_clu on disk. Only the cluster
+   right after the end of the map extends it; kmalloc may sleep, so the map
+   is checked again before the new array replaces the old one. */
 
 void cache_add(struct inode *inode,int f_clu,int d_clu)
 {
-	struct fat_cache *walk,*last;
+	struct msdos_inode_info *mi = MSDOS_I(inode);
+	struct fat_extent *ext,*new;
+	int f,d,size,gen;
 
 #ifdef DEBUG
 printk("cache add: <%d,%d> %d (%d)\n",inode->i_dev,inode->i_ino,f_clu,d_clu);
 #endif
-	last = NULL;
-	for (walk = fat_cache; walk->next; walk = (last = walk)->next)
-		if (inode->i_dev == walk->device && walk->ino == inode->i_ino &&
-		    walk->file_cluster == f_clu) {
-			if (walk->disk_cluster != d_clu) {
-				printk("FAT cache corruption");
-				cache_inval_inode(inode);
+	if (f_clu < mi->i_ext_mapped) {
+		f = 0;
+		cache_lookup(inode,f_clu,&f,&d);
+		if (f == f_clu && d != d_clu) {
+			printk("FAT cache corruption");
+			cache_inval_inode(inode);
+		}
+		return;
+	}
+	mi->i_ext_eof = 0;
+	if (f_clu == mi->i_ext_mapped) {
+		ext = mi->i_ext_count ? &mi->i_ext[mi->i_ext_count-1] : NULL;
+		if (ext && ext->disk_cluster+ext->len == d_clu) {
+			ext->len++;
+			mi->i_ext_mapped++;
+			return;
+		}
+		if (mi->i_ext_count == mi->i_ext_size &&
+		    mi->i_ext_size < FAT_EXTENT_MAX) {
+			gen = mi->i_ext_gen;
+			size = mi->i_ext_size ? mi->i_ext_size*2 : FAT_EXTENT_MIN;
+			new = (struct fat_extent *) kmalloc(size*
+			    sizeof(struct fat_extent),GFP_KERNEL);
+			if (!new) return;
+			if (mi->i_ext_gen != gen || mi->i_ext_mapped != f_clu) {
+				kfree(new);
 				return;
 			}
-			/* update LRU */
-			if (last == NULL) return;
-			last->next = walk->next;
-			walk->next = fat_cache;
-			fat_cache = walk;
-#ifdef DEBUG
-list_cache();
-#endif
+			if ((ext = mi->i_ext) != NULL) {
+				memcpy(new,ext,mi->i_ext_count*
+				    sizeof(struct fat_extent));
+				kfree(ext);
+			}
+			mi->i_ext = new;
+			mi->i_ext_size = size;
+		}
+		if (mi->i_ext_count < mi->i_ext_size) {
+			ext = &mi->i_ext[mi->i_ext_count++];
+			ext->file_cluster = f_clu;
+			ext->disk_cluster = d_clu;
+			ext->len = 1;
+			mi->i_ext_mapped++;
 			return;
 		}
-	walk->device = inode->i_dev;
-	walk->ino = inode->i_ino;
-	walk->file_cluster = f_clu;
-	walk->disk_cluster = d_clu;
-	last->next = NULL;
-	walk->next = fat_cache;
-	fat_cache = walk;
-#ifdef DEBUG
-list_cache();
-#endif
+	}
+	mi->i_hint_file = f_clu;
+	mi->i_hint_disk = d_clu;
 }
 
 
-/* Cache invalidation occurs rarely, thus the LRU chain is not updated. It
-   fixes itself after a while. */
+/* Drops the map. Anyone walking the chain at the time notices i_ext_gen
+   has changed and stops adding to it. */
 
 void cache_inval_inode(struct inode *inode)
 {
-	struct fat_cache *walk;
-
-	for (walk = fat_cache; walk; walk = walk->next)
-		if (walk->device == inode->i_dev && walk->ino == inode->i_ino)
-			walk->device = 0;
-}
-
-
-void cache_inval_dev(int device)
-{
-	struct fat_cache *walk;
-
-	for (walk = fat_cache; walk; walk = walk->next)
-		if (walk->device == device) walk->device = 0;
+	struct msdos_inode_info *mi = MSDOS_I(inode);
+
+	if (mi->i_ext) kfree(mi->i_ext);
+	mi->i_ext = NULL;
+	mi->i_ext_count = mi->i_ext_size = mi->i_ext_mapped = 0;
+	mi->i_ext_eof = 0;
+	mi->i_hint_file = mi->i_hint_disk = 0;
+	mi->i_ext_gen++;
 }
 
 
 int get_cluster(struct inode *inode,int cluster)
 {
-	int nr,count;
+	struct msdos_inode_info *mi = MSDOS_I(inode);
+	int nr,count,gen;
 
-	if (!(nr = MSDOS_I(inode)->i_start)) return 0;
+	if (!(nr = mi->i_start)) return 0;
 	if (!cluster) return nr;
+	if (mi->i_ext_eof && cluster >= mi->i_ext_mapped) return 0;
+	gen = mi->i_ext_gen;
+	if (!mi->i_ext_mapped) cache_add(inode,0,nr);
 	count = 0;
 	for (cache_lookup(inode,cluster,&count,&nr); count < cluster;
 	    count++) {
-		if ((nr = fat_access(inode->i_sb,nr,-1)) == -1) return 0;
+		if ((nr = fat_access(inode->i_sb,nr,-1)) == -1) {
+			if (mi->i_ext_gen == gen && mi->i_ext_mapped == count+1)
+				mi->i_ext_eof = 1;
+			return 0;
+		}
 		if (!nr) return 0;
+		if (mi->i_ext_gen == gen) cache_add(inode,count+1,nr);
 	}
-	cache_add(inode,cluster,nr);
 	return nr;
 }
 
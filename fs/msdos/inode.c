@@ -35,10 +35,10 @@ void msdos_put_inode(struct inode *inode)
 	struct inode *depend;
 	struct super_block *sb;
 
-	if (inode->i_nlink) {
-		if (MSDOS_I(inode)->i_busy) cache_inval_inode(inode);
-		return;
-	}
+	/* The cluster map is kmalloc'ed and an unused inode may be cleared
+	   at any time, so it goes with the last reference. */
+	cache_inval_inode(inode);
+	if (inode->i_nlink) return;
 	inode->i_size = 0;
 	msdos_truncate(inode);
 	depend = MSDOS_I(inode)->i_depend;
@@ -59,7 +59,7 @@ void msdos_put_inode(struct inode *inode)
 
 void msdos_put_super(struct super_block *sb)
 {
-	cache_inval_dev(sb->s_dev);
+	fat_sync(sb);
 	set_blocksize (sb->s_dev,BLOCK_SIZE);
 	lock_super(sb);
 	sb->s_dev = 0;
@@ -69,13 +69,19 @@ void msdos_put_super(struct super_block *sb)
 }
 
 
+void msdos_write_super(struct super_block *sb)
+{
+	fat_sync(sb);
+}
+
+
 static struct super_operations msdos_sops = { 
 	msdos_read_inode,
 	msdos_notify_change,
 	msdos_write_inode,
 	msdos_put_inode,
 	msdos_put_super,
-	NULL, /* added in 0.96c */
+	msdos_write_super,
 	msdos_statfs,
 	NULL
 };
@@ -192,7 +198,6 @@ struct super_block *msdos_read_super(struct super_block *sb,void *data,
 		MOD_DEC_USE_COUNT;
 		return NULL;
 	}
-	cache_init();
 	lock_super(sb);
 	/* The first read is always 1024 bytes */
 	sb->s_blocksize = 1024;
@@ -299,6 +304,7 @@ struct super_block *msdos_read_super(struct super_block *sb,void *data,
 	MSDOS_SB(sb)->fat_wait = NULL;
 	MSDOS_SB(sb)->fat_lock = 0;
 	MSDOS_SB(sb)->prev_free = 0;
+	MSDOS_SB(sb)->fat_dirty = 0;
 	if (!(sb->s_mounted = iget(sb,MSDOS_ROOT_INO))) {
 		sb->s_dev = 0;
 		printk("get root inode failed\n");
@@ -358,6 +364,7 @@ void msdos_read_inode(struct inode *inode)
 	int nr;
 
 /* printk("read inode %d\n",inode->i_ino); */
+	cache_inval_inode(inode);
 	MSDOS_I(inode)->i_busy = 0;
 	MSDOS_I(inode)->i_depend = MSDOS_I(inode)->i_old = NULL;
 	MSDOS_I(inode)->i_binary = 1;
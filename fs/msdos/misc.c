@@ -117,7 +117,7 @@ void unlock_fat(struct super_block *sb)
 int msdos_add_cluster(struct inode *inode)
 {
 	struct super_block *sb = inode->i_sb;
-	int count,nr,limit,last,current,sector,last_sector;
+	int count,nr,limit,last,current,sector,last_sector,file_cluster;
 	struct buffer_head *bh;
 	int cluster_size = MSDOS_SB(inode->i_sb)->cluster_size;
 
@@ -148,15 +148,17 @@ printk("free cluster: %d\n",nr);
 #ifdef DEBUG
 printk("set to %x\n",fat_access(inode->i_sb,nr,-1));
 #endif
-	last = 0;
+	last = file_cluster = 0;
 	if ((current = MSDOS_I(inode)->i_start) != 0) {
-		cache_lookup(inode,INT_MAX,&last,&current);
-		while (current && current != -1)
+		cache_lookup(inode,INT_MAX,&file_cluster,&current);
+		while (current && current != -1) {
 			if (!(current = fat_access(inode->i_sb,
 			    last = current,-1))) {
 				fs_panic(inode->i_sb,"File without EOF");
 				return -ENOSPC;
 			}
+			file_cluster++;
+		}
 	}
 #ifdef DEBUG
 printk("last = %d\n",last);
@@ -166,6 +168,7 @@ printk("last = %d\n",last);
 		MSDOS_I(inode)->i_start = nr;
 		inode->i_dirt = 1;
 	}
+	cache_add(inode,file_cluster,nr);
 #ifdef DEBUG
 if (last) printk("next set to %d\n",fat_access(inode->i_sb,last,-1));
 #endif
@@ -589,6 +589,7 @@ static int rename_diff_dir(struct inode *old_dir,char *old_name,
 		}
 		dotdot_de->start = MSDOS_I(dotdot_inode)->i_start =
 		    MSDOS_I(new_dir)->i_start;
+		cache_inval_inode(dotdot_inode);
 		dotdot_inode->i_dirt = 1;
 		mark_buffer_dirty(dotdot_bh, 1);
 		old_dir->i_nlink--;
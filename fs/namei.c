@@ -44,6 +44,7 @@
 #include <linux/fcntl.h>
 #include <linux/stat.h>
 #include <linux/mm.h>
+#include <linux/binfmts.h>
 
 #define ACC_MODE(x) ("\000\004\002\006"[(x)&O_ACCMODE])
 
@@ -182,6 +183,9 @@ int get_write_access(struct inode * inode)
 		}
 	//执行到这里，说明文件没有被共享或者被共享了但没有进程将其映射设为VM_DENYWRITE
 	//则增加文件的写进程数，然后返回0
+	/* the file may change from here on: forget what exec knew of it */
+	if (S_ISREG(inode->i_mode))
+		exec_cache_invalidate(inode);
 	inode->i_wcount++;
 	return 0;
 }
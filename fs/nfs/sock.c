@@ -110,6 +110,7 @@ static int do_nfs_rpc_call(struct nfs_server *server, int *start, int *end, int
 	re_select:
 		wait_table.nr = 0;
 		wait_table.entry = &entry;
+		wait_table.queue = NULL;
 		current->state = TASK_INTERRUPTIBLE;
 		if (!select(inode, file, SEL_IN, &wait_table)
 		    && !select(inode, file, SEL_IN, NULL)) {
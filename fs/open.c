@@ -17,8 +17,10 @@
 #include <linux/tty.h>
 #include <linux/time.h>
 #include <linux/mm.h>
+#include <linux/eventpoll.h>
 
 #include <asm/segment.h>
+#include <asm/bitops.h>
 
 extern void fcntl_remove_locks(struct task_struct *, struct file *);
 
@@ -56,7 +58,7 @@ asmlinkage int sys_fstatfs(unsigned int fd, struct statfs * buf)
 	error = verify_area(VERIFY_WRITE, buf, sizeof(struct statfs));
 	if (error)
 		return error;
-	if (fd >= NR_OPEN || !(file = current->files->fd[fd]))
+	if (fd >= current->files->max_fds || !(file = current->files->fd[fd]))
 		return -EBADF;
 	if (!(inode = file->f_inode))
 		return -ENOENT;
@@ -114,7 +116,7 @@ asmlinkage int sys_ftruncate(unsigned int fd, unsigned int length)
 	struct file * file;
 	struct iattr newattrs;
 
-	if (fd >= NR_OPEN || !(file = current->files->fd[fd]))
+	if (fd >= current->files->max_fds || !(file = current->files->fd[fd]))
 		return -EBADF;
 	if (!(inode = file->f_inode))
 		return -ENOENT;
@@ -230,7 +232,7 @@ asmlinkage int sys_fchdir(unsigned int fd)
 	struct file * file;
 	int error;
 
-	if (fd >= NR_OPEN || !(file = current->files->fd[fd]))
+	if (fd >= current->files->max_fds || !(file = current->files->fd[fd]))
 		return -EBADF;
 	if (!(inode = file->f_inode))
 		return -ENOENT;
@@ -271,7 +273,7 @@ asmlinkage int sys_fchmod(unsigned int fd, mode_t mode)
 	struct file * file;
 	struct iattr newattrs;
 
-	if (fd >= NR_OPEN || !(file = current->files->fd[fd]))
+	if (fd >= current->files->max_fds || !(file = current->files->fd[fd]))
 		return -EBADF;
 	if (!(inode = file->f_inode))
 		return -ENOENT;
@@ -316,7 +318,7 @@ asmlinkage int sys_fchown(unsigned int fd, uid_t user, gid_t group)
 	struct file * file;
 	struct iattr newattrs;
 
-	if (fd >= NR_OPEN || !(file = current->files->fd[fd]))
+	if (fd >= current->files->max_fds || !(file = current->files->fd[fd]))
 		return -EBADF;
 	if (!(inode = file->f_inode))
 		return -ENOENT;
@@ -391,6 +393,136 @@ asmlinkage int sys_chown(const char * filename, uid_t user, gid_t group)
 	return(error);
 }
 
+/*
+ * Descriptor tables.  A process starts with the NR_OPEN entries kept in
+ * its task_struct.  When it needs more, the table moves to a vmalloc()ed
+ * block that holds fd[] followed by the open_fds and close_on_exec
+ * bitmaps, and doubles in size from there.  The lowest free descriptor
+ * is found by scanning open_fds a word at a time.
+ */
+static struct file ** alloc_fd_table(int nr)
+{
+	return (struct file **) vmalloc(nr * sizeof(struct file *) + nr / 4);
+}
+
+static void set_fd_table(struct files_struct * files, struct file ** fd, int nr)
+{
+	files->fd = fd;
+	files->open_fds = (unsigned long *) (fd + nr);
+	files->close_on_exec = files->open_fds + nr / 32;
+	files->max_fds = nr;
+}
+
+static void use_fd_array(struct files_struct * files)
+{
+	files->fd = files->fd_array;
+	files->open_fds = files->open_fds_init.fds_bits;
+	files->close_on_exec = files->close_on_exec_init.fds_bits;
+	files->max_fds = NR_OPEN;
+}
+
+static int expand_files(struct files_struct * files, unsigned int fd)
+{
+	struct file ** new, ** old = files->fd;
+	unsigned long * old_open = files->open_fds;
+	unsigned long * old_cloexec = files->close_on_exec;
+	int nr, old_nr = files->max_fds;
+
+	if (fd >= NR_OPEN_MAX)
+		return -EMFILE;
+	for (nr = old_nr ; nr <= fd ; nr <<= 1)
+		/* nothing */;
+	new = alloc_fd_table(nr);
+	if (!new)
+		return -ENOMEM;
+	memcpy(new, old, old_nr * sizeof(struct file *));
+	memset(new + old_nr, 0, (nr - old_nr) * sizeof(struct file *));
+	set_fd_table(files, new, nr);
+	memcpy(files->open_fds, old_open, old_nr / 8);
+	memset((char *) files->open_fds + old_nr / 8, 0, (nr - old_nr) / 8);
+	memcpy(files->close_on_exec, old_cloexec, old_nr / 8);
+	memset((char *) files->close_on_exec + old_nr / 8, 0, (nr - old_nr) / 8);
+	if (old != files->fd_array)
+		vfree(old);
+	return 0;
+}
+
+/*
+ * Find the lowest free descriptor at or above 'start', growing the
+ * table if need be.  The caller makes it live with fd_install().
+ */
+int get_unused_fd(unsigned int start)
+{
+	struct files_struct * files = current->files;
+	int fd, error;
+
+	if (start >= current->rlim[RLIMIT_NOFILE].rlim_cur)
+		return -EMFILE;
+	fd = start;
+	if (fd < files->max_fds)
+		fd = find_next_zero_bit(files->open_fds, files->max_fds, fd);
+	if (fd >= current->rlim[RLIMIT_NOFILE].rlim_cur)
+		return -EMFILE;
+	if (fd >= files->max_fds) {
+		error = expand_files(files, fd);
+		if (error)
+			return error;
+	}
+	return fd;
+}
+
+void fd_install(unsigned int fd, struct file * file)
+{
+	struct files_struct * files = current->files;
+
+	files->fd[fd] = file;
+	set_bit(fd, files->open_fds);
+	clear_bit(fd, files->close_on_exec);
+}
+
+void put_unused_fd(unsigned int fd)
+{
+	struct files_struct * files = current->files;
+
+	files->fd[fd] = NULL;
+	clear_bit(fd, files->open_fds);
+}
+
+/*
+ * fork() copied the files_struct along with the task_struct, so the
+ * child's pointers still lead into the parent's table.
+ */
+int dup_fd_table(struct files_struct * files)
+{
+	struct file ** new;
+
+	if (files->max_fds == NR_OPEN) {
+		use_fd_array(files);
+		return 0;
+	}
+	new = alloc_fd_table(files->max_fds);
+	if (!new)
+		return -ENOMEM;
+	memcpy(new, files->fd, files->max_fds * sizeof(struct file *) + files->max_fds / 4);
+	set_fd_table(files, new, files->max_fds);
+	return 0;
+}
+
+/*
+ * Called once every descriptor is closed: go back to the table in the
+ * task_struct, cleared so that nothing stale shows through /proc.
+ */
+void free_fd_table(struct files_struct * files)
+{
+	if (files->fd == files->fd_array)
+		return;
+	vfree(files->fd);
+	memset(files->fd_array, 0, sizeof(files->fd_array));
+	memset(&files->open_fds_init, 0, sizeof(files->open_fds_init));
+	memset(&files->close_on_exec_init, 0, sizeof(files->close_on_exec_init));
+	use_fd_array(files);
+}
+
 /*
  * Note that while the flag value (low two bits) for sys_open means:
  *	00 - read-only
@@ -411,16 +543,13 @@ int do_open(const char * filename,int flags,int mode)
 	struct file * f;
 	int flag,error,fd;
 
-	for(fd=0; fd<NR_OPEN && fd<current->rlim[RLIMIT_NOFILE].rlim_cur; fd++)
-		if (!current->files->fd[fd])
-			break;
-	if (fd>=NR_OPEN || fd>=current->rlim[RLIMIT_NOFILE].rlim_cur)
-		return -EMFILE;
-	FD_CLR(fd,&current->files->close_on_exec);
+	fd = get_unused_fd(0);
+	if (fd < 0)
+		return fd;
 	f = get_empty_filp();
 	if (!f)
 		return -ENFILE;
-	current->files->fd[fd] = f;
+	fd_install(fd, f);
 	f->f_flags = flag = flags;
 	f->f_mode = (flag+1) & O_ACCMODE;
 	if (f->f_mode)
@@ -434,8 +563,8 @@ int do_open(const char * filename,int flags,int mode)
 			iput(inode);
 	}
 	if (error) {
-		current->files->fd[fd]=NULL;
-		f->f_count--;
+		put_unused_fd(fd);
+		put_filp(f);
 		return error;
 	}
 
@@ -450,8 +579,8 @@ int do_open(const char * filename,int flags,int mode)
 		if (error) {
 			if (f->f_mode & 2) put_write_access(inode);
 			iput(inode);
-			f->f_count--;
-			current->files->fd[fd]=NULL;
+			put_unused_fd(fd);
+			put_filp(f);
 			return error;
 		}
 	}
@@ -492,10 +621,12 @@ int close_fp(struct file *filp)
 		filp->f_count--;
 		return 0;
 	}
+	if (filp->f_epitems)
+		eventpoll_release(filp);
 	if (filp->f_op && filp->f_op->release)
 		filp->f_op->release(inode,filp);
-	filp->f_count--;
 	filp->f_inode = NULL;
+	put_filp(filp);
 	if (filp->f_mode & 2) put_write_access(inode);
 	iput(inode);
 	return 0;
@@ -505,12 +636,12 @@ asmlinkage int sys_close(unsigned int fd)
 {	
 	struct file * filp;
 
-	if (fd >= NR_OPEN)
+	if (fd >= current->files->max_fds)
 		return -EBADF;
-	FD_CLR(fd, &current->files->close_on_exec);
+	clear_bit(fd, current->files->close_on_exec);
 	if (!(filp = current->files->fd[fd]))
 		return -EBADF;
-	current->files->fd[fd] = NULL;
+	put_unused_fd(fd);
 	return (close_fp (filp));
 }
 
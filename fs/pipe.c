@@ -26,6 +26,7 @@
 #include <linux/fcntl.h>
 #include <linux/termios.h>
 #include <linux/mm.h>
+#include <linux/malloc.h>
 
 
 /* We don't use the head/tail construction any more. Now we use the start/len*/
@@ -90,16 +91,16 @@ static int pipe_read(struct inode * inode, struct file * filp, char * buf, int c
 							//又由于这是在内核中，内核是不可抢占的 所以应该可以保证锁的原子性
 	//开始读取数据
 	while (count>0 && (size = PIPE_SIZE(*inode))) {	//size = PIPE_LEN(inode) 管道中有效数据长度
-		chars = PIPE_MAX_RCHUNK(*inode);	//#define PIPE_MAX_RCHUNK(inode)	(PIPE_BUF - PIPE_START(inode))
+		chars = PIPE_MAX_RCHUNK(*inode);	//PIPE_START所在页面中剩余的字节数
 		//调整本次要读取的字节数
 		if (chars > count)
 			chars = count;
 		if (chars > size)
 			chars = size;
 		read += chars;	//增加已读字节数
-        pipebuf = PIPE_BASE(*inode)+PIPE_START(*inode);
+		pipebuf = PIPE_ADDR(*inode, PIPE_START(*inode));
 		PIPE_START(*inode) += chars;	//重新调整管道中有效数据开始的位置
-		PIPE_START(*inode) &= (PIPE_BUF-1);	//对管道缓冲长度取模，以形成环形管道
+		PIPE_START(*inode) &= (PIPE_BUFSIZE(*inode)-1);	//对管道缓冲长度取模，以形成环形管道
 		PIPE_LEN(*inode) -= chars;	//重新调整管道的有效数据长度
 		count -= chars;	//调整要读的字节数
 		memcpy_tofs(buf, pipebuf, chars );	//将当前读取的数据复制到buf中去
@@ -166,12 +167,12 @@ static int pipe_write(struct inode * inode, struct file * filp, char * buf, int
 		//直到要写的字节数全部写完或者管道没有空闲字节数为止
 		//注意，管道是一个环形缓冲区，写到管道末尾了，会循环到管道头开始写
 		while (count>0 && (free = PIPE_FREE(*inode))) {	
-			chars = PIPE_MAX_WCHUNK(*inode);	//(PIPE_BUF - PIPE_END(inode))
+			chars = PIPE_MAX_WCHUNK(*inode);	//PIPE_END所在页面中剩余的字节数
 			if (chars > count)
 				chars = count;
 			if (chars > free)
 				chars = free;
-            pipebuf = PIPE_BASE(*inode)+PIPE_END(*inode);
+			pipebuf = PIPE_ADDR(*inode, PIPE_END(*inode));
 			written += chars;	//增加写入的字节数
 			PIPE_LEN(*inode) += chars;	//增加管道中的有效数据
 			count -= chars;	//减少还要写入的字节数
@@ -220,6 +221,127 @@ static int pipe_ioctl(struct inode *pino, struct file * filp,
 //SEL_IN read
 //SEL_OUT write
 //SEL_EX exception
+/*
+ * Pipe buffers are a ring of pages.  pipe_free_buffers() is called from
+ * iput(); pipe_resize() builds a new ring of 'size' bytes (a power-of-two
+ * number of pages) and moves whatever is in the pipe to its start.
+ */
+void pipe_free_buffers(struct inode * inode)
+{
+	char ** bufs = (char **) PIPE_BASE(*inode);
+	int i;
+
+	if (!bufs)
+		return;
+	if (PIPE_PAGES(*inode) == 1)
+		free_page((unsigned long) bufs);
+	else {
+		for (i = 0; i < PIPE_PAGES(*inode); i++)
+			free_page((unsigned long) bufs[i]);
+		kfree(bufs);
+	}
+	PIPE_BASE(*inode) = NULL;
+}
+
+static int pipe_resize(struct inode * inode, unsigned int size)
+{
+	char * bufs[PIPE_MAX_PAGES];
+	char ** array = NULL;
+	unsigned int pos, done, len;
+	int nr = size >> PAGE_SHIFT;
+	int i, error;
+
+	if (nr > 1) {
+		array = (char **) kmalloc(nr * sizeof(char *), GFP_KERNEL);
+		if (!array)
+			return -ENOMEM;
+	}
+	for (i = 0; i < nr; i++) {
+		bufs[i] = (char *) __get_free_page(GFP_USER);
+		if (!bufs[i]) {
+			nr = i;
+			error = -ENOMEM;
+			goto out_free;
+		}
+	}
+	/* __get_free_page() may have slept: wait for the pipe to be idle */
+	while (PIPE_LOCK(*inode)) {
+		if (current->signal & ~current->blocked) {
+			error = -ERESTARTSYS;
+			goto out_free;
+		}
+		interruptible_sleep_on(&PIPE_WAIT(*inode));
+	}
+	len = PIPE_LEN(*inode);
+	if (len > size) {
+		error = -EBUSY;
+		goto out_free;
+	}
+	pos = PIPE_START(*inode);
+	for (done = 0; done < len; ) {
+		unsigned int chars = PIPE_MAX_RCHUNK(*inode);
+
+		if (chars > len - done)
+			chars = len - done;
+		if (chars > PAGE_SIZE - (done & (PAGE_SIZE-1)))
+			chars = PAGE_SIZE - (done & (PAGE_SIZE-1));
+		memcpy(bufs[done >> PAGE_SHIFT] + (done & (PAGE_SIZE-1)),
+			PIPE_ADDR(*inode, pos), chars);
+		done += chars;
+		pos = (pos + chars) & (PIPE_BUFSIZE(*inode)-1);
+		PIPE_START(*inode) = pos;
+	}
+	pipe_free_buffers(inode);
+	if (array) {
+		for (i = 0; i < nr; i++)
+			array[i] = bufs[i];
+		PIPE_BASE(*inode) = (char *) array;
+	} else
+		PIPE_BASE(*inode) = bufs[0];
+	PIPE_PAGES(*inode) = nr;
+	PIPE_START(*inode) = 0;
+	PIPE_LEN(*inode) = len;
+	wake_up_interruptible(&PIPE_WAIT(*inode));
+	return 0;
+
+out_free:
+	for (i = 0; i < nr; i++)
+		free_page((unsigned long) bufs[i]);
+	if (array)
+		kfree(array);
+	return error;
+}
+
+/*
+ * F_SETPIPE_SZ rounds the request up to a power-of-two number of pages,
+ * never less than PIPE_BUF so that small writes stay atomic.
+ */
+int pipe_fcntl(struct file * filp, unsigned int cmd, unsigned long arg)
+{
+	struct inode * inode = filp->f_inode;
+	unsigned int size;
+	int error;
+
+	if (!inode->i_pipe || !PIPE_BASE(*inode))
+		return -EINVAL;
+	switch (cmd) {
+		case F_GETPIPE_SZ:
+			return PIPE_BUFSIZE(*inode);
+		case F_SETPIPE_SZ:
+			if (arg > PIPE_MAX_PAGES * PAGE_SIZE)
+				return -EINVAL;
+			for (size = PAGE_SIZE; size < arg || size < PIPE_BUF; size <<= 1)
+				/* nothing */;
+			if (size == PIPE_BUFSIZE(*inode))
+				return size;
+			error = pipe_resize(inode, size);
+			if (error)
+				return error;
+			return size;
+	}
+	return -EINVAL;
+}
+
 static int pipe_select(struct inode * inode, struct file * filp, int sel_type, select_table * wait)
 {
 	switch (sel_type) {
@@ -471,7 +593,7 @@ asmlinkage int sys_pipe(unsigned long * fildes)
 	struct inode * inode;
 	struct file * f[2];
 	int fd[2];
-	int i,j;
+	int j;
 
 	j = verify_area(VERIFY_WRITE,fildes,8);
 	if (j)
@@ -480,27 +602,26 @@ asmlinkage int sys_pipe(unsigned long * fildes)
 		if (!(f[j] = get_empty_filp()))
 			break;
 	if (j==1)
-		f[0]->f_count--;
+		put_filp(f[0]);
 	if (j<2)
 		return -ENFILE;
-	j=0;
-	for(i=0;j<2 && i<NR_OPEN && i<current->rlim[RLIMIT_NOFILE].rlim_cur;i++)
-		if (!current->files->fd[i]) {
-			current->files->fd[ fd[j]=i ] = f[j];
-			j++;
-		}
-	if (j==1)
-		current->files->fd[fd[0]]=NULL;
+	for(j=0 ; j<2 ; j++) {
+		if ((fd[j] = get_unused_fd(0)) < 0)
+			break;
+		fd_install(fd[j], f[j]);
+	}
 	if (j<2) {
-		f[0]->f_count--;
-		f[1]->f_count--;
+		if (j==1)
+			put_unused_fd(fd[0]);
+		put_filp(f[0]);
+		put_filp(f[1]);
 		return -EMFILE;
 	}
 	if (!(inode=get_pipe_inode())) {
-		current->files->fd[fd[0]] = NULL;
-		current->files->fd[fd[1]] = NULL;
-		f[0]->f_count--;
-		f[1]->f_count--;
+		put_unused_fd(fd[0]);
+		put_unused_fd(fd[1]);
+		put_filp(f[0]);
+		put_filp(f[1]);
 		return -ENFILE;
 	}
 	f[0]->f_inode = f[1]->f_inode = inode;
@@ -515,3 +636,138 @@ asmlinkage int sys_pipe(unsigned long * fildes)
 	put_fs_long(fd[1],1+fildes);
 	return 0;
 }
+
+/*
+ * splice() moves data between a pipe and another file without going
+ * through a user buffer: the other file's read or write routine works
+ * directly on the pipe's pages under KERNEL_DS.  One side must be a
+ * pipe (or fifo).  The sleeping rules are those of pipe_read() and
+ * pipe_write(); SPLICE_F_NONBLOCK makes the pipe side non-blocking.
+ */
+static int splice_from_pipe(struct inode * pipe, struct file * out,
+	unsigned int len, int nonblock)
+{
+	int chars, written, done = 0;
+
+	while (len > 0) {
+		while (PIPE_EMPTY(*pipe) || PIPE_LOCK(*pipe)) {
+			if (PIPE_EMPTY(*pipe) && !PIPE_WRITERS(*pipe))
+				return done;
+			if (done)
+				return done;
+			if (nonblock)
+				return -EAGAIN;
+			if (current->signal & ~current->blocked)
+				return -ERESTARTSYS;
+			interruptible_sleep_on(&PIPE_WAIT(*pipe));
+		}
+		PIPE_LOCK(*pipe)++;
+		chars = PIPE_MAX_RCHUNK(*pipe);
+		if (chars > PIPE_LEN(*pipe))
+			chars = PIPE_LEN(*pipe);
+		if (chars > len)
+			chars = len;
+		written = out->f_op->write(out->f_inode, out,
+			PIPE_ADDR(*pipe, PIPE_START(*pipe)), chars);
+		if (written > 0) {
+			PIPE_START(*pipe) += written;
+			PIPE_START(*pipe) &= (PIPE_BUFSIZE(*pipe)-1);
+			PIPE_LEN(*pipe) -= written;
+			done += written;
+			len -= written;
+		}
+		PIPE_LOCK(*pipe)--;
+		wake_up_interruptible(&PIPE_WAIT(*pipe));
+		if (written <= 0)
+			return done ? done : written;
+		if (written < chars)
+			break;
+	}
+	return done;
+}
+
+static int splice_to_pipe(struct inode * pipe, struct file * in,
+	unsigned int len, int nonblock)
+{
+	int chars, got, done = 0;
+
+	while (len > 0) {
+		while (PIPE_FULL(*pipe) || PIPE_LOCK(*pipe)) {
+			if (!PIPE_READERS(*pipe)) {
+				send_sig(SIGPIPE,current,0);
+				return done? :-EPIPE;
+			}
+			if (done)
+				return done;
+			if (nonblock)
+				return -EAGAIN;
+			if (current->signal & ~current->blocked)
+				return -ERESTARTSYS;
+			interruptible_sleep_on(&PIPE_WAIT(*pipe));
+		}
+		PIPE_LOCK(*pipe)++;
+		chars = PIPE_MAX_WCHUNK(*pipe);
+		if (chars > PIPE_FREE(*pipe))
+			chars = PIPE_FREE(*pipe);
+		if (chars > len)
+			chars = len;
+		got = in->f_op->read(in->f_inode, in,
+			PIPE_ADDR(*pipe, PIPE_END(*pipe)), chars);
+		if (got > 0) {
+			PIPE_LEN(*pipe) += got;
+			done += got;
+			len -= got;
+		}
+		PIPE_LOCK(*pipe)--;
+		wake_up_interruptible(&PIPE_WAIT(*pipe));
+		if (got <= 0)
+			return done ? done : got;
+		if (got < chars)
+			break;
+	}
+	return done;
+}
+
+asmlinkage int sys_splice(unsigned int fd_in, unsigned int fd_out,
+	unsigned int len, unsigned int flags)
+{
+	struct file * in, * out;
+	struct inode * iin, * iout;
+	unsigned long fs;
+	int error, nonblock;
+
+	if (fd_in >= current->files->max_fds || !(in = current->files->fd[fd_in]) ||
+	    !(iin = in->f_inode) || !(in->f_mode & 1))
+		return -EBADF;
+	if (fd_out >= current->files->max_fds || !(out = current->files->fd[fd_out]) ||
+	    !(iout = out->f_inode) || !(out->f_mode & 2))
+		return -EBADF;
+	if (flags & ~SPLICE_F_NONBLOCK)
+		return -EINVAL;
+	if (!len)
+		return 0;
+	fs = get_fs();
+	if (iin->i_pipe && PIPE_BASE(*iin) && !iout->i_pipe) {
+		if (!out->f_op || !out->f_op->write)
+			return -EINVAL;
+		nonblock = (flags & SPLICE_F_NONBLOCK) || (in->f_flags & O_NONBLOCK);
+		set_fs(KERNEL_DS);
+		error = splice_from_pipe(iin, out, len, nonblock);
+		set_fs(fs);
+		return error;
+	}
+	if (iout->i_pipe && PIPE_BASE(*iout) && !iin->i_pipe) {
+		if (!in->f_op || !in->f_op->read)
+			return -EINVAL;
+		if (!PIPE_READERS(*iout)) {
+			send_sig(SIGPIPE,current,0);
+			return -EPIPE;
+		}
+		nonblock = (flags & SPLICE_F_NONBLOCK) || (out->f_flags & O_NONBLOCK);
+		set_fs(KERNEL_DS);
+		error = splice_to_pipe(iout, in, len, nonblock);
+		set_fs(fs);
+		return error;
+	}
+	return -EINVAL;
+}
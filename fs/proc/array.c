@@ -255,14 +255,16 @@ static int get_uptime(char * buffer)
 static int get_meminfo(char * buffer)
 {
 	struct sysinfo i;
+	int len;
 
 	si_meminfo(&i);
 	si_swapinfo(&i);
-	return sprintf(buffer, "        total:   used:    free:   shared:  buffers:\n"
+	len = sprintf(buffer, "        total:   used:    free:   shared:  buffers:\n"
 		"Mem:  %8lu %8lu %8lu %8lu %8lu\n"
 		"Swap: %8lu %8lu %8lu\n",
 		i.totalram, i.totalram-i.freeram, i.freeram, i.sharedram, i.bufferram,
 		i.totalswap, i.totalswap-i.freeswap, i.freeswap);
+	return len + zswap_get_info(buffer + len);
 }
 
 static int get_version(char * buffer)
@@ -750,6 +752,8 @@ extern int get_filesystem_list(char *);
 extern int get_ksyms_list(char *);
 extern int get_irq_list(char *);
 extern int get_dma_list(char *);
+extern int get_zoneinfo(char *);
+extern int get_inode_info(char *);
 extern int get_cpuinfo(char *);
 extern int get_pci_list(char*);
 
@@ -804,6 +808,11 @@ static int get_root_array(char * page, int type)
 
 		case PROC_IOPORTS:
 			return get_ioport_list(page);
+
+		case PROC_ZONEINFO:
+			return get_zoneinfo(page);
+		case PROC_INODES:
+			return get_inode_info(page);
 	}
 	return -EBADF;
 }
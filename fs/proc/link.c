@@ -70,10 +70,10 @@ static int proc_fd_dupf(struct inode * inode, struct file * f)
 	struct task_struct * p;
 	struct file *new_f;
 	
-	for(fd=0 ; fd<NR_OPEN ; fd++)
+	for(fd=0 ; fd<current->files->max_fds ; fd++)
 		if (current->files->fd[fd] == f)
 			break;
-	if (fd>=NR_OPEN)
+	if (fd>=current->files->max_fds)
 		return -ENOENT;	/* should never happen */
 
 	ino = inode->i_ino;
@@ -93,8 +93,9 @@ static int proc_fd_dupf(struct inode * inode, struct file * f)
 
 	new_f->f_count++;
 	current->files->fd[fd] = new_f;
-	if (!--f->f_count)
+	if (f->f_count == 1)
 		iput(f->f_inode);
+	put_filp(f);
 	return 0;
 }
 
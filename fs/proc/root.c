@@ -77,6 +77,8 @@ static struct proc_dir_entry root_dir[] = {
    	{ PROC_KSYMS,		5, "ksyms" },
    	{ PROC_DMA,		3, "dma" },
 	{ PROC_IOPORTS,		7, "ioports"},
+	{ PROC_ZONEINFO,	8, "zoneinfo"},
+	{ PROC_INODES,		6, "inodes" },
 #ifdef CONFIG_PROFILE
 	{ PROC_PROFILE,		7, "profile"},
 #endif
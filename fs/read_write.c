@@ -10,8 +10,10 @@
 #include <linux/kernel.h>
 #include <linux/sched.h>
 #include <linux/mm.h>
+#include <linux/uio.h>
 
 #include <asm/segment.h>
+#include <asm/pgtable.h>
 
 /*
  * Count is now a supported feature, but currently only the ext2fs
@@ -29,7 +31,7 @@ asmlinkage int sys_readdir(unsigned int fd, struct dirent * dirent, unsigned int
 	struct file * file;
 	struct inode * inode;
 
-	if (fd >= NR_OPEN || !(file = current->files->fd[fd]) ||
+	if (fd >= current->files->max_fds || !(file = current->files->fd[fd]) ||
 	    !(inode = file->f_inode))
 		return -EBADF;
 	error = -ENOTDIR;
@@ -49,7 +51,7 @@ asmlinkage int sys_lseek(unsigned int fd, off_t offset, unsigned int origin)
 	struct file * file;
 	int tmp = -1;
 
-	if (fd >= NR_OPEN || !(file=current->files->fd[fd]) || !(file->f_inode))
+	if (fd >= current->files->max_fds || !(file=current->files->fd[fd]) || !(file->f_inode))
 		return -EBADF;
 	if (origin > 2)
 		return -EINVAL;
@@ -89,7 +91,7 @@ asmlinkage int sys_llseek(unsigned int fd, unsigned long offset_high,
 	loff_t offset;
 	int err;
 
-	if (fd >= NR_OPEN || !(file=current->files->fd[fd]) || !(file->f_inode))
+	if (fd >= current->files->max_fds || !(file=current->files->fd[fd]) || !(file->f_inode))
 		return -EBADF;
 	if (origin > 2)
 		return -EINVAL;
@@ -119,13 +121,27 @@ asmlinkage int sys_llseek(unsigned int fd, unsigned long offset_high,
 	return 0;
 }
 
+/*
+ * If data has been written to the file, remove the setuid and
+ * the setgid bits
+ */
+static inline void remove_suid(struct inode * inode)
+{
+	if (!suser() && (inode->i_mode & (S_ISUID | S_ISGID))) {
+		struct iattr newattrs;
+		newattrs.ia_mode = inode->i_mode & ~(S_ISUID | S_ISGID);
+		newattrs.ia_valid = ATTR_MODE;
+		notify_change(inode, &newattrs);
+	}
+}
+
 asmlinkage int sys_read(unsigned int fd,char * buf,unsigned int count)
 {
 	int error;
 	struct file * file;
 	struct inode * inode;
 
-	if (fd>=NR_OPEN || !(file=current->files->fd[fd]) || !(inode=file->f_inode))
+	if (fd >= current->files->max_fds || !(file=current->files->fd[fd]) || !(inode=file->f_inode))
 		return -EBADF;
 	if (!(file->f_mode & 1))
 		return -EBADF;
@@ -146,7 +162,7 @@ asmlinkage int sys_write(unsigned int fd,char * buf,unsigned int count)
 	struct inode * inode;
 	int written;
 	
-	if (fd>=NR_OPEN || !(file=current->files->fd[fd]) || !(inode=file->f_inode))
+	if (fd >= current->files->max_fds || !(file=current->files->fd[fd]) || !(inode=file->f_inode))
 		return -EBADF;
 	if (!(file->f_mode & 2))
 		return -EBADF;
@@ -158,15 +174,269 @@ asmlinkage int sys_write(unsigned int fd,char * buf,unsigned int count)
 	if (error)
 		return error;
 	written = file->f_op->write(inode,file,buf,count);
-	/*
-	 * If data has been written to the file, remove the setuid and
-	 * the setgid bits
-	 */
-	if (written > 0 && !suser() && (inode->i_mode & (S_ISUID | S_ISGID))) {
-		struct iattr newattrs;
-		newattrs.ia_mode = inode->i_mode & ~(S_ISUID | S_ISGID);
-		newattrs.ia_valid = ATTR_MODE;
-		notify_change(inode, &newattrs);
+	if (written > 0)
+		remove_suid(inode);
+	return written;
+}
+
+/*
+ * readv() and writev() move a whole iovec in one call.  The vector is
+ * copied in and every piece checked up front.  A file with readv/writev
+ * operations is handed the kernel copy, which it may consume as it goes,
+ * so that it can treat the pieces as one stream: tcp builds full-sized
+ * segments across them, the block filesystems look up each block once.
+ * Anything else has read()/write() called once per piece, stopping at
+ * the first short transfer.
+ */
+static int do_readv_writev(int type, struct inode * inode, struct file * file,
+	struct iovec * vector, unsigned int count)
+{
+	struct iovec iov[UIO_MAXIOV];
+	int (*fn)(struct inode *, struct file *, char *, int);
+	int tot_len, done, error, i;
+
+	if (!count)
+		return 0;
+	if (count > UIO_MAXIOV)
+		return -EINVAL;
+	error = verify_area(VERIFY_READ, vector, count * sizeof(struct iovec));
+	if (error)
+		return error;
+	memcpy_fromfs(iov, vector, count * sizeof(struct iovec));
+	tot_len = 0;
+	for (i = 0 ; i < count ; i++) {
+		if (iov[i].iov_len < 0)
+			return -EINVAL;
+		tot_len += iov[i].iov_len;
+		if (tot_len < 0)
+			return -EINVAL;
+		if (!iov[i].iov_len)
+			continue;
+		error = verify_area(type, iov[i].iov_base, iov[i].iov_len);
+		if (error)
+			return error;
+	}
+	if (!tot_len)
+		return 0;
+
+	if (type == VERIFY_WRITE) {
+		if (file->f_op->readv)
+			return file->f_op->readv(inode, file, iov, count);
+		fn = file->f_op->read;
+	} else {
+		if (file->f_op->writev)
+			return file->f_op->writev(inode, file, iov, count);
+		fn = file->f_op->write;
+	}
+	done = 0;
+	for (i = 0 ; i < count ; i++) {
+		int nr;
+
+		if (!iov[i].iov_len)
+			continue;
+		nr = fn(inode, file, (char *) iov[i].iov_base, iov[i].iov_len);
+		if (nr < 0) {
+			if (!done)
+				done = nr;
+			break;
+		}
+		done += nr;
+		if (nr < iov[i].iov_len)
+			break;
 	}
+	return done;
+}
+
+asmlinkage int sys_readv(unsigned int fd, struct iovec * vector, unsigned int count)
+{
+	struct file * file;
+	struct inode * inode;
+
+	if (fd >= current->files->max_fds || !(file=current->files->fd[fd]) || !(inode=file->f_inode))
+		return -EBADF;
+	if (!(file->f_mode & 1))
+		return -EBADF;
+	if (!file->f_op || !file->f_op->read)
+		return -EINVAL;
+	return do_readv_writev(VERIFY_WRITE, inode, file, vector, count);
+}
+
+asmlinkage int sys_writev(unsigned int fd, struct iovec * vector, unsigned int count)
+{
+	struct file * file;
+	struct inode * inode;
+	int written;
+
+	if (fd >= current->files->max_fds || !(file=current->files->fd[fd]) || !(inode=file->f_inode))
+		return -EBADF;
+	if (!(file->f_mode & 2))
+		return -EBADF;
+	if (!file->f_op || !file->f_op->write)
+		return -EINVAL;
+	written = do_readv_writev(VERIFY_READ, inode, file, vector, count);
+	if (written > 0)
+		remove_suid(inode);
 	return written;
 }
+
+/*
+ * sendfile() pushes file data to another descriptor without the round
+ * trip through a user buffer.  For files that have a bmap() operation
+ * the data is taken straight out of the buffer cache, and the output
+ * file's write routine (tcp_write() for a socket) is called on the
+ * cached block under KERNEL_DS.  The socket layer builds its segments
+ * and checksums them from the buffer cache data, so every byte is
+ * copied once on its way out instead of twice.  Files without bmap()
+ * (nfs, proc, pipes...) go through a single bounce page instead.
+ */
+static int sendfile_bounce(struct file * in, struct inode * in_inode,
+	struct file * out, struct inode * out_inode, off_t pos, int count)
+{
+	unsigned long page;
+	off_t saved;
+	int sent = 0;
+
+	if (!in->f_op || !in->f_op->read)
+		return -EINVAL;
+	page = __get_free_page(GFP_KERNEL);
+	if (!page)
+		return -ENOMEM;
+	saved = in->f_pos;
+	while (count > 0) {
+		int chars = count, done, written;
+
+		if (chars > PAGE_SIZE)
+			chars = PAGE_SIZE;
+		in->f_pos = pos;
+		done = in->f_op->read(in_inode, in, (char *) page, chars);
+		if (done <= 0) {
+			if (!sent)
+				sent = done;
+			break;
+		}
+		written = out->f_op->write(out_inode, out, (char *) page, done);
+		if (written <= 0) {
+			if (!sent)
+				sent = written;
+			break;
+		}
+		sent += written;
+		pos += written;
+		count -= written;
+		if (written < done || (current->signal & ~current->blocked))
+			break;
+	}
+	in->f_pos = saved;
+	free_page(page);
+	return sent;
+}
+
+static int sendfile_cached(struct inode * in_inode, struct file * out,
+	struct inode * out_inode, off_t pos, int count)
+{
+	struct buffer_head * bh;
+	unsigned long blocksize = in_inode->i_sb->s_blocksize;
+	int bits = in_inode->i_sb->s_blocksize_bits;
+	int sent = 0;
+
+	if (pos >= in_inode->i_size)
+		return 0;
+	if (count > in_inode->i_size - pos)
+		count = in_inode->i_size - pos;
+	while (count > 0) {
+		int offset = pos & (blocksize - 1);
+		int chars = blocksize - offset;
+		int block, written;
+		char * data;
+
+		if (chars > count)
+			chars = count;
+		block = bmap(in_inode, pos >> bits);
+		bh = NULL;
+		if (block) {
+			bh = breada(in_inode->i_dev, block, blocksize,
+				pos, in_inode->i_size);
+			if (!bh) {
+				if (!sent)
+					sent = -EIO;
+				break;
+			}
+			data = bh->b_data + offset;
+		} else {
+			/* a hole: send zeroes from the empty zero page */
+			data = (char *) ZERO_PAGE + offset;
+		}
+		written = out->f_op->write(out_inode, out, data, chars);
+		if (bh)
+			brelse(bh);
+		if (written <= 0) {
+			if (!sent)
+				sent = written;
+			break;
+		}
+		sent += written;
+		pos += written;
+		count -= written;
+		if (written < chars || (current->signal & ~current->blocked))
+			break;
+	}
+	return sent;
+}
+
+asmlinkage int sys_sendfile(unsigned int out_fd, unsigned int in_fd,
+	off_t * offset, unsigned int count)
+{
+	struct file * in, * out;
+	struct inode * in_inode, * out_inode;
+	unsigned long fs;
+	off_t pos;
+	int error;
+
+	if (in_fd >= current->files->max_fds || !(in = current->files->fd[in_fd]) ||
+	    !(in_inode = in->f_inode))
+		return -EBADF;
+	if (out_fd >= current->files->max_fds || !(out = current->files->fd[out_fd]) ||
+	    !(out_inode = out->f_inode))
+		return -EBADF;
+	if (!(in->f_mode & 1) || !(out->f_mode & 2))
+		return -EBADF;
+	if (!out->f_op || !out->f_op->write)
+		return -EINVAL;
+	if ((int) count < 0)
+		return -EINVAL;
+	pos = in->f_pos;
+	if (offset) {
+		error = verify_area(VERIFY_WRITE, offset, sizeof(off_t));
+		if (error)
+			return error;
+		pos = get_fs_long((unsigned long *) offset);
+		if (pos < 0)
+			return -EINVAL;
+	}
+	if (!count)
+		return 0;
+
+	fs = get_fs();
+	set_fs(KERNEL_DS);
+	if (S_ISREG(in_inode->i_mode) && in_inode->i_sb &&
+	    in_inode->i_op && in_inode->i_op->bmap)
+		error = sendfile_cached(in_inode, out, out_inode, pos, count);
+	else
+		error = sendfile_bounce(in, in_inode, out, out_inode, pos, count);
+	set_fs(fs);
+
+	if (error > 0) {
+		pos += error;
+		if (offset)
+			put_fs_long(pos, (unsigned long *) offset);
+		else {
+			in->f_pos = pos;
+			in->f_reada = 1;
+		}
+		if (!IS_RDONLY(in_inode)) {
+			in_inode->i_atime = CURRENT_TIME;
+			in_inode->i_dirt = 1;
+		}
+	}
+	return error;
+}
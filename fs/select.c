@@ -171,6 +171,7 @@ end_check:
 	count = 0;
 	wait_table.nr = 0;
 	wait_table.entry = entry;
+	wait_table.queue = NULL;
 	wait = &wait_table;
 repeat:
 	//现将当前进程状态设置为TASK_INTERRUPTIBLE（可中断睡眠状态）
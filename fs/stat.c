@@ -180,7 +180,7 @@ asmlinkage int sys_fstat(unsigned int fd, struct old_stat * statbuf)
 	error = verify_area(VERIFY_WRITE,statbuf,sizeof (*statbuf));
 	if (error)
 		return error;
-	if (fd >= NR_OPEN || !(f=current->files->fd[fd]) || !(inode=f->f_inode))
+	if (fd >= current->files->max_fds || !(f=current->files->fd[fd]) || !(inode=f->f_inode))
 		return -EBADF;
 	cp_old_stat(inode,statbuf);
 	return 0;
@@ -195,7 +195,7 @@ asmlinkage int sys_newfstat(unsigned int fd, struct new_stat * statbuf)
 	error = verify_area(VERIFY_WRITE,statbuf,sizeof (*statbuf));
 	if (error)
 		return error;
-	if (fd >= NR_OPEN || !(f=current->files->fd[fd]) || !(inode=f->f_inode))
+	if (fd >= current->files->max_fds || !(f=current->files->fd[fd]) || !(inode=f->f_inode))
 		return -EBADF;
 	cp_new_stat(inode,statbuf);
 	return 0;
@@ -378,7 +378,7 @@ static struct super_operations umsdos_sops = {
 	UMSDOS_write_inode,
 	UMSDOS_put_inode,
 	UMSDOS_put_super,
-	NULL, /* added in 0.96c */
+	msdos_write_super,
 	UMSDOS_statfs,
 	NULL
 };
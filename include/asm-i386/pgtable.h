@@ -1,6 +1,9 @@
 #ifndef _I386_PGTABLE_H
 #define _I386_PGTABLE_H
 
+#include <asm/processor.h>
+#include <asm/segment.h>
+
 //Linux操作系统内核就是这样 曾经风云变幻 到最后却被千万行的代码淹没的无影无踪  
 //幸好 他有时又会留下一点蛛丝马迹 引领我们穿越操作系统内部所有的秘密
 /*
@@ -75,6 +78,7 @@
 #define VMALLOC_OFFSET	(8*1024*1024)
 #define VMALLOC_START ((high_memory + VMALLOC_OFFSET) & ~(VMALLOC_OFFSET-1))
 #define VMALLOC_VMADDR(x) (TASK_SIZE + (unsigned long)(x))
+#define VMALLOC_END	(0UL - TASK_SIZE)	/* top of the kernel segment */
 
 #define _PAGE_PRESENT	0x001
 #define _PAGE_RW	0x002
@@ -387,6 +391,86 @@ extern inline pgd_t * pgd_alloc(void)
 
 extern pgd_t swapper_pg_dir[1024];
 
+/*
+ * invalidate() reloads cr3 and throws away the whole TLB.  The 486 and
+ * up can drop a single entry with invlpg instead, so code that changes
+ * a few ptes notes the addresses in a tlb_batch as it goes, and
+ * tlb_flush() at the end invalidates just those pages.  More than
+ * TLB_BATCH_MAX pages, or a 386, still gets the full flush.
+ */
+#define TLB_BATCH_MAX	16
+
+struct tlb_batch {
+	int nr;
+	unsigned long addr[TLB_BATCH_MAX];
+};
+
+/*
+ * invlpg takes a logical address, and KERNEL_DS starts at 0xC0000000, so
+ * user pages are named through USER_DS (base 0) loaded into %fs for the
+ * one instruction.  Only user addresses may be passed; anything above
+ * TASK_SIZE gets the full flush instead.
+ */
+#define __invlpg(addr) \
+__asm__ __volatile__("pushl %%fs\n\t" \
+	"movw %w1,%%fs\n\t" \
+	"invlpg %%fs:(%0)\n\t" \
+	"popl %%fs" \
+	: /* no outputs */ :"r" (addr), "r" (USER_DS))
+
+extern inline void tlb_batch_init(struct tlb_batch * tb)
+{
+	tb->nr = 0;
+}
+
+extern inline void tlb_note(struct tlb_batch * tb, unsigned long address)
+{
+	if (tb->nr < TLB_BATCH_MAX)
+		tb->addr[tb->nr] = address & PAGE_MASK;
+	if (tb->nr <= TLB_BATCH_MAX)
+		tb->nr++;
+}
+
+extern inline void tlb_note_range(struct tlb_batch * tb, unsigned long start,
+	unsigned long end)
+{
+	if (end - start > TLB_BATCH_MAX * PAGE_SIZE) {
+		tb->nr = TLB_BATCH_MAX + 1;
+		return;
+	}
+	for (start &= PAGE_MASK ; start < end ; start += PAGE_SIZE)
+		tlb_note(tb, start);
+}
+
+extern inline void tlb_flush(struct tlb_batch * tb)
+{
+	int i;
+
+	if (!tb->nr)
+		return;
+	if (tb->nr > TLB_BATCH_MAX || x86 < 4) {
+		invalidate();
+	} else {
+		for (i = 0 ; i < tb->nr ; i++) {
+			if (tb->addr[i] >= TASK_SIZE) {
+				invalidate();
+				break;
+			}
+			__invlpg(tb->addr[i]);
+		}
+	}
+	tb->nr = 0;
+}
+
+/* the same for a single page */
+extern inline void invalidate_page(unsigned long address)
+{
+	if (x86 < 4 || address >= TASK_SIZE)
+		invalidate();
+	else
+		__invlpg(address & PAGE_MASK);
+}
+
 /*
  * The i386 doesn't have any external MMU info: the kernel page
  * tables contain all the necessary information.
@@ -1,11 +1,11 @@
 #ifndef _ASM_SEGMENT_H
 #define _ASM_SEGMENT_H
 
-#define KERNEL_CS	0x10	#00010000	RPL=0,GDT,INDEX=2
-#define KERNEL_DS	0x18	#00011000	RPL=0,GDT,INDEX=3
+#define KERNEL_CS	0x10	/* 00010000	RPL=0,GDT,INDEX=2 */
+#define KERNEL_DS	0x18	/* 00011000	RPL=0,GDT,INDEX=3 */
 
-#define USER_CS		0x23	#00100011	RPL=1,LDT,INDEX=4
-#define USER_DS		0x2B	#00101010	RPL=1,LDT,INDEX=5
+#define USER_CS		0x23	/* 00100011	RPL=1,LDT,INDEX=4 */
+#define USER_DS		0x2B	/* 00101010	RPL=1,LDT,INDEX=5 */
 
 #ifndef __ASSEMBLY__
 
@@ -1,8 +1,11 @@
 #ifndef _LINUX_BINFMTS_H
 #define _LINUX_BINFMTS_H
 
+#include <linux/types.h>
 #include <linux/ptrace.h>
 
+struct inode;
+
 /*
  * MAX_ARG_PAGES defines the number of pages allocated for arguments
  * and envelope for the new program. 32 should suffice, this gives
@@ -46,9 +49,36 @@ struct linux_binfmt {
 	int (*core_dump)(long signr, struct pt_regs * regs);
 };
 
+/*
+ * What a binary format has kept about one executable, so that the next
+ * exec of it need not read and check its headers again: see fs/exec.c.
+ * The format's own data follows the structure.
+ */
+struct exec_cache {
+	struct exec_cache * ec_next;
+	struct linux_binfmt * ec_fmt;
+	dev_t ec_dev;
+	unsigned long ec_ino;
+	off_t ec_size;		/* checked on lookup, */
+	time_t ec_mtime;	/* in case the inode number */
+	time_t ec_ctime;	/* has been reused */
+	int ec_count;
+	int ec_len;
+};
+
+#define EXEC_CACHE_DATA(ec)	((void *) ((ec) + 1))
+
 extern int register_binfmt(struct linux_binfmt *);
 extern int unregister_binfmt(struct linux_binfmt *);
 
+extern struct exec_cache * exec_cache_alloc(int len);
+extern struct exec_cache * exec_cache_find(struct inode *, struct linux_binfmt *);
+extern unsigned long exec_cache_gen;
+extern void exec_cache_add(struct exec_cache *, struct inode *, struct linux_binfmt *,
+	unsigned long);
+extern void exec_cache_put(struct exec_cache *);
+extern void exec_cache_invalidate(struct inode *);
+
 extern int read_exec(struct inode *inode, unsigned long offset,
 	char * addr, unsigned long count);
 
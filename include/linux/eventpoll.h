@@ -0,0 +1,68 @@
+#ifndef _LINUX_EVENTPOLL_H
+#define _LINUX_EVENTPOLL_H
+
+/*
+ * Persistent interest sets for the epoll_create/epoll_ctl/epoll_wait
+ * system calls.  Unlike select(), the set of watched descriptors lives
+ * in the kernel, and readiness is recorded by wait queue callbacks, so
+ * epoll_wait() only looks at descriptors that have actually been woken.
+ */
+
+#define EPOLL_CTL_ADD	1	/* add a descriptor to the interest set */
+#define EPOLL_CTL_DEL	2	/* remove a descriptor */
+#define EPOLL_CTL_MOD	3	/* change the events of a descriptor */
+
+#define EPOLLIN		0x001	/* SEL_IN */
+#define EPOLLPRI	0x002	/* SEL_EX */
+#define EPOLLOUT	0x004	/* SEL_OUT */
+#define EPOLLONESHOT	(1 << 30)	/* disable after one event, re-arm with MOD */
+
+struct epoll_event {
+	unsigned long events;
+	unsigned long data;
+};
+
+#ifdef __KERNEL__
+
+#define EP_HASH_SIZE	64	/* must be a power of two */
+
+struct eventpoll;
+
+/* one wait queue an epitem is hooked into */
+struct ep_wait {
+	struct wait_queue wait;		/* must be first: see ep_poll_callback */
+	struct wait_queue ** whead;
+	struct epitem * item;
+	struct ep_wait * next;
+};
+
+/* one watched descriptor */
+struct epitem {
+	struct epitem * next;		/* hash chain in the eventpoll */
+	struct epitem * rdnext;		/* ready list */
+	struct epitem * fnext;		/* other sets watching the same file */
+	struct eventpoll * ep;
+	struct file * file;
+	int fd;
+	int ready;			/* on the ready list */
+	unsigned long events;
+	unsigned long data;
+	struct ep_wait * waits;
+	select_table table;
+};
+
+struct eventpoll {
+	struct semaphore sem;		/* serializes ctl against collection */
+	struct wait_queue * wait;	/* sleepers in epoll_wait() */
+	struct epitem * rdlist;
+	struct epitem ** rdtail;
+	int nitems;
+	int count;			/* the file, and eventpoll_release()s */
+	struct epitem * hash[EP_HASH_SIZE];
+};
+
+extern void eventpoll_release(struct file * file);
+
+#endif /* __KERNEL__ */
+
+#endif
@@ -43,8 +43,14 @@
 
 /*
  * Define EXT2_PREALLOCATE to preallocate data blocks for expanding files
+ *
+ * The preallocation window starts at EXT2_PREALLOC_MIN blocks and doubles,
+ * up to EXT2_PREALLOC_MAX, each time a file appending in order uses all of
+ * it.  A write() asks for enough to cover itself.
  */
 #define EXT2_PREALLOCATE
+#define EXT2_PREALLOC_MIN	8
+#define EXT2_PREALLOC_MAX	64
 
 /*
  * The second extended file system version
@@ -199,6 +205,7 @@ struct ext2_group_desc
 #define EXT2_IMMUTABLE_FL		0x00000010 /* Immutable file */
 #define EXT2_APPEND_FL			0x00000020 /* writes to file may only append */
 #define EXT2_NODUMP_FL			0x00000040 /* do not dump file */
+#define EXT2_EXTENTS_FL			0x00080000 /* blocks mapped by extents */
 
 /*
  * ioctl commands
@@ -305,6 +312,7 @@ struct ext2_inode {
 #define EXT2_MOUNT_ERRORS_RO		0x0020	/* Remount fs ro on errors */
 #define EXT2_MOUNT_ERRORS_PANIC		0x0040	/* Panic on errors */
 #define EXT2_MOUNT_MINIX_DF		0x0080	/* Mimics the Minix statfs */
+#define EXT2_MOUNT_EXTENTS		0x0100	/* New files use extents */
 
 #define clear_opt(o, opt)		o &= ~EXT2_MOUNT_##opt
 #define set_opt(o, opt)			o |= EXT2_MOUNT_##opt
@@ -353,14 +361,53 @@ struct ext2_super_block {
 	__u32	s_rev_level;		/* Revision level */
 	__u16	s_def_resuid;		/* Default uid for reserved blocks */
 	__u16	s_def_resgid;		/* Default gid for reserved blocks */
-	__u32	s_reserved[235];	/* Padding to the end of the block */
+	/*
+	 * These fields are for EXT2_DYNAMIC_REV superblocks only.
+	 */
+	__u32	s_first_ino;		/* First non-reserved inode */
+	__u16	s_inode_size;		/* size of inode structure */
+	__u16	s_block_group_nr;	/* block group # of this superblock */
+	__u32	s_feature_compat;	/* compatible feature set */
+	__u32	s_feature_incompat;	/* incompatible feature set */
+	__u32	s_feature_ro_compat;	/* readonly-compatible feature set */
+	__u32	s_reserved[230];	/* Padding to the end of the block */
 };
 
 #define EXT2_OS_LINUX		0
 #define EXT2_OS_HURD		1
 #define EXT2_OS_MASIX		2
 
-#define EXT2_CURRENT_REV	0
+/*
+ * Revision levels
+ */
+#define EXT2_GOOD_OLD_REV	0	/* The good old (original) format */
+#define EXT2_DYNAMIC_REV	1	/* V2 format w/ feature sets */
+
+#define EXT2_CURRENT_REV	EXT2_DYNAMIC_REV
+
+#define EXT2_GOOD_OLD_FIRST_INO	11
+#define EXT2_GOOD_OLD_INODE_SIZE 128
+
+/*
+ * Feature sets.  A kernel that doesn't know an incompat feature must not
+ * mount the fs at all, one that doesn't know a ro_compat feature may only
+ * mount it read-only.
+ */
+#define EXT2_HAS_COMPAT_FEATURE(sb,mask)			\
+	((sb)->u.ext2_sb.s_es->s_rev_level >= EXT2_DYNAMIC_REV &&	\
+	 ((sb)->u.ext2_sb.s_es->s_feature_compat & (mask)))
+#define EXT2_HAS_INCOMPAT_FEATURE(sb,mask)			\
+	((sb)->u.ext2_sb.s_es->s_rev_level >= EXT2_DYNAMIC_REV &&	\
+	 ((sb)->u.ext2_sb.s_es->s_feature_incompat & (mask)))
+#define EXT2_HAS_RO_COMPAT_FEATURE(sb,mask)			\
+	((sb)->u.ext2_sb.s_es->s_rev_level >= EXT2_DYNAMIC_REV &&	\
+	 ((sb)->u.ext2_sb.s_es->s_feature_ro_compat & (mask)))
+
+#define EXT2_FEATURE_INCOMPAT_EXTENTS	0x0040	/* files may use extents */
+
+#define EXT2_FEATURE_COMPAT_SUPP	0
+#define EXT2_FEATURE_INCOMPAT_SUPP	EXT2_FEATURE_INCOMPAT_EXTENTS
+#define EXT2_FEATURE_RO_COMPAT_SUPP	0
 
 #define	EXT2_DEF_RESUID		0
 #define	EXT2_DEF_RESGID		0
@@ -387,6 +434,42 @@ struct ext2_dir_entry {
 #define EXT2_DIR_REC_LEN(name_len)	(((name_len) + 8 + EXT2_DIR_ROUND) & \
 					 ~EXT2_DIR_ROUND)
 
+/*
+ * Structure of an extent tree
+ *
+ * A file with EXT2_EXTENTS_FL set keeps a tree of extents in i_block
+ * instead of the direct and indirect block numbers.  Every node, the
+ * root in i_block included, starts with a header followed by eh_entries
+ * sorted records: extents in the leaves (eh_depth == 0), index entries
+ * pointing to the next level down everywhere else.  Both kinds of record
+ * start with the first logical block they cover.
+ */
+struct ext2_extent_header {
+	__u16	eh_magic;		/* EXT2_EXT_MAGIC */
+	__u16	eh_entries;		/* Number of valid entries */
+	__u16	eh_max;			/* Capacity of the node */
+	__u16	eh_depth;		/* Levels below this node */
+	__u32	eh_generation;
+};
+
+struct ext2_extent {
+	__u32	ee_block;		/* First logical block */
+	__u16	ee_len;			/* Number of blocks */
+	__u16	ee_start_hi;		/* Always 0 */
+	__u32	ee_start;		/* First physical block */
+};
+
+struct ext2_extent_idx {
+	__u32	ei_block;		/* First logical block below */
+	__u32	ei_leaf;		/* Block of the node below */
+	__u16	ei_leaf_hi;		/* Always 0 */
+	__u16	ei_unused;
+};
+
+#define EXT2_EXT_MAGIC		0xF30A
+#define EXT2_EXT_MAX_LEN	32768	/* Longest extent */
+#define EXT2_EXT_MAX_DEPTH	5
+
 #ifdef __KERNEL__
 /*
  * Function prototypes
@@ -410,12 +493,14 @@ struct ext2_dir_entry {
 extern int ext2_permission (struct inode *, int);
 
 /* balloc.c */
+extern int ext2_new_blocks (struct super_block *, unsigned long, int *);
 extern int ext2_new_block (struct super_block *, unsigned long,
 			   __u32 *, __u32 *);
 extern void ext2_free_blocks (struct super_block *, unsigned long,
 			      unsigned long);
 extern unsigned long ext2_count_free_blocks (struct super_block *);
 extern void ext2_check_blocks_bitmap (struct super_block *);
+extern void ext2_init_group_runs (struct super_block *);
 
 /* bitmap.c */
 extern unsigned long ext2_count_free (struct buffer_head *, unsigned);
@@ -425,6 +510,14 @@ extern int ext2_check_dir_entry (char *, struct inode *,
 				 struct ext2_dir_entry *, struct buffer_head *,
 				 unsigned long);
 
+/* extents.c */
+extern void ext2_ext_init (struct inode *);
+extern int ext2_ext_bmap (struct inode *, unsigned long, unsigned long *);
+extern int ext2_ext_insert (struct inode *, unsigned long, unsigned long);
+extern void ext2_ext_truncate (struct inode *);
+extern int ext2_ext_sync (struct inode *, int);
+extern int ext2_ext_convert (struct inode *);
+
 /* file.c */
 extern int ext2_read (struct inode *, struct file *, char *, int);
 extern int ext2_write (struct inode *, struct file *, char *, int);
@@ -440,6 +533,7 @@ extern void ext2_check_inodes_bitmap (struct super_block *);
 
 /* inode.c */
 extern int ext2_bmap (struct inode *, int);
+extern int ext2_ind_bmap (struct inode *, __u32 *, int);
 
 extern struct buffer_head * ext2_getblk (struct inode *, long, int, int *);
 extern struct buffer_head * ext2_bread (struct inode *, int, int, int *);
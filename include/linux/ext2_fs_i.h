@@ -34,6 +34,12 @@ struct ext2_inode_info {
 	__u32	i_next_alloc_goal;
 	__u32	i_prealloc_block;
 	__u32	i_prealloc_count;
+	__u32	i_prealloc_size;	/* size of the last window */
+	__u32	i_prealloc_want;	/* blocks the current write() covers */
+	__u32	i_ext_block;		/* last extent found, if i_ext_len */
+	__u32	i_ext_len;
+	__u32	i_ext_start;
+	__u32	i_ext_gen;		/* bumped when the tree changes */
 };
 
 #endif	/* _LINUX_EXT2_FS_I */
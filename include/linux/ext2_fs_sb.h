@@ -21,7 +21,20 @@
  */
 /* #define EXT2_MAX_GROUP_DESC	8 */
 
+/*
+ * Each bitmap cache may pin up to 1/EXT2_BITMAP_MEM_RATIO of memory in
+ * bitmap buffers, but always holds at least EXT2_MAX_GROUP_LOADED and at
+ * most EXT2_MAX_GROUP_CACHE of them.
+ */
 #define EXT2_MAX_GROUP_LOADED	8
+#define EXT2_MAX_GROUP_CACHE	4096
+#define EXT2_BITMAP_MEM_RATIO	256
+
+/*
+ * Groups are counted in s_run_hist by the number of significant bits in
+ * their s_group_run, which is at most 8 * EXT2_MAX_BLOCK_SIZE.
+ */
+#define EXT2_RUN_BUCKETS	17
 
 /*
  * second extended-fs super-block data in memory
@@ -42,10 +55,13 @@ struct ext2_sb_info {
 	struct buffer_head ** s_group_desc;
 	unsigned short s_loaded_inode_bitmaps;
 	unsigned short s_loaded_block_bitmaps;
-	unsigned long s_inode_bitmap_number[EXT2_MAX_GROUP_LOADED];
-	struct buffer_head * s_inode_bitmap[EXT2_MAX_GROUP_LOADED];
-	unsigned long s_block_bitmap_number[EXT2_MAX_GROUP_LOADED];
-	struct buffer_head * s_block_bitmap[EXT2_MAX_GROUP_LOADED];
+	unsigned short s_max_group_loaded;	/* Size of the bitmap caches */
+	unsigned long * s_inode_bitmap_number;
+	struct buffer_head ** s_inode_bitmap;
+	unsigned long * s_block_bitmap_number;
+	struct buffer_head ** s_block_bitmap;
+	unsigned short * s_group_run;	/* No free run in a group is longer */
+	unsigned long s_run_hist[EXT2_RUN_BUCKETS];
 	int s_rename_lock;
 	struct wait_queue * s_rename_wait;
 	unsigned long  s_mount_opt;
@@ -29,6 +29,11 @@
 #define F_SETOWN	8	/*  for sockets. */
 #define F_GETOWN	9	/*  for sockets. */
 
+#define F_SETPIPE_SZ	1031	/* set the size of a pipe's page ring */
+#define F_GETPIPE_SZ	1032
+
+#define SPLICE_F_NONBLOCK	2	/* splice(): don't block on the pipe */
+
 /* for F_[GET|SET]FL */
 #define FD_CLOEXEC	1	/* actually anything with low bit set goes */
 
@@ -28,18 +28,18 @@
 #include <linux/net.h>
 
 /*
- * It's silly to have NR_OPEN bigger than NR_FILE, but I'll fix
- * that later. Anyway, now the file code is no longer dependent
- * on bitmaps in unsigned longs, but uses the new fd_set structure..
+ * NR_OPEN is the size of the descriptor table a process starts with,
+ * and what select() can see.  The table grows on demand, doubling each
+ * time, up to NR_OPEN_MAX entries (and the RLIMIT_NOFILE of the
+ * process).  There is no fixed limit on the number of file structures.
  *
  * Some programs (notably those using select()) may have to be 
  * recompiled to take full advantage of the new limits..
  */
 #undef NR_OPEN
 #define NR_OPEN 256
+#define NR_OPEN_MAX 65536
 
-#define NR_INODE 2048	/* this should be bigger than NR_FILE */
-#define NR_FILE 1024	/* this can well be larger on a larger system */
 #define NR_SUPER 32
 #define NR_IHASH 131
 #define BLOCK_SIZE 1024
@@ -262,10 +262,11 @@ struct inode {
 	struct inode_operations * i_op;	/* 索引节点操作表 */
 	struct super_block * i_sb;	/* 相关的超级块 */
 	struct wait_queue * i_wait;
-	struct file_lock * i_flock;	 /* 文件锁链表 */
+	struct file_lock * i_flock;	 /* root of the byte-range lock tree */
 	struct vm_area_struct * i_mmap;	 /* 相关的地址映射 */
 	struct inode * i_next, * i_prev;	/* 索引节点链表 */
 	struct inode * i_hash_next, * i_hash_prev;	/* 哈希表 */
+	struct inode * i_lru_next, * i_lru_prev;	/* unused inodes, see fs/inode.c */
 	struct inode * i_bound_to, * i_bound_by;
 	struct inode * i_mount;
 	unsigned short i_count;
@@ -277,6 +278,7 @@ struct inode {
 	unsigned char i_sock;
 	unsigned char i_seek;
 	unsigned char i_update;
+	unsigned char i_lru_dirty;	/* which unused list we're on */
 	union {
 		struct pipe_inode_info pipe_i;	//将管道也视为了一种独立的文件系统
 		struct minix_inode_info minix_i;
@@ -306,12 +308,17 @@ struct file {
 	unsigned short f_flags;
 	unsigned short f_count;
 	off_t f_reada;	//预读标志
+/* read() readahead state, in blocks; only valid while f_reada is set */
+	unsigned long f_ranext;		/* block after the last one read */
+	unsigned long f_raend;		/* read ahead up to here */
+	unsigned long f_ralen;		/* current window */
 	struct file *f_next, *f_prev;
 	int f_owner;		/* pid or -pgrp where SIGIO should be sent */
 	struct inode * f_inode;	//file多对应的文件i节点
 	struct file_operations * f_op;	//file对象的操作函数集 通过具体的文件系统的i节点来初始化
 	unsigned long f_version;
 	void *private_data;	/* needed for tty driver, and maybe others */
+	struct epitem *f_epitems;	/* eventpoll sets watching this file */
 };
 
 //我觉得struct flock结构和struct file_lock结构不同之处在于
@@ -319,9 +326,11 @@ struct file {
 //用户不必关心的、内核自动维护的信息，比如文件锁链表等
 //也可以叫做“请求锁”结构
 struct file_lock {
-	struct file_lock *fl_next;	/* singly linked list for this inode  *///将属于该文件节点的锁链接成单链表的锁指针
-	struct file_lock *fl_nextlink;	/* doubly linked list of all locks *///将所有的内核文件锁链接成一双链表的指针
-	struct file_lock *fl_prevlink;	/* used to simplify lock removal */
+	struct file_lock *fl_left;	/* interval tree of this inode's locks, */
+	struct file_lock *fl_right;	/* ordered by fl_start */
+	struct file_lock *fl_next;	/* scratch list while locking */
+	off_t fl_max;			/* highest fl_end in this subtree */
+	unsigned long fl_prio;		/* treap priority */
 	struct task_struct *fl_owner;
 	struct wait_queue *fl_wait;
 	char fl_type;
@@ -406,6 +415,8 @@ struct file_operations {
 	int (*fasync) (struct inode *, struct file *, int);
 	int (*check_media_change) (dev_t dev);
 	int (*revalidate) (dev_t dev);
+	int (*readv) (struct inode *, struct file *, struct iovec *, int);
+	int (*writev) (struct inode *, struct file *, struct iovec *, int);
 };
 
 struct inode_operations {
@@ -477,6 +488,8 @@ extern struct file_operations def_chr_fops;
 extern struct inode_operations chrdev_inode_operations;
 
 extern void init_fifo(struct inode * inode);
+extern void pipe_free_buffers(struct inode * inode);
+extern int pipe_fcntl(struct file * filp, unsigned int cmd, unsigned long arg);
 
 extern struct file_operations connecting_fifo_fops;
 extern struct file_operations read_fifo_fops;
@@ -497,6 +510,7 @@ extern int nr_files;
 extern struct super_block super_blocks[NR_SUPER];
 
 extern int shrink_buffers(unsigned int priority);
+extern int shrink_inodes(int priority);
 extern void refile_buffer(struct buffer_head * buf);
 extern void set_writetime(struct buffer_head * buf, int flag);
 extern void refill_freelist(int size);
@@ -559,16 +573,25 @@ extern void insert_inode_hash(struct inode *);
 extern void clear_inode(struct inode *);
 extern struct inode * get_pipe_inode(void);
 extern struct file * get_empty_filp(void);
+extern void put_filp(struct file * file);
+extern int get_unused_fd(unsigned int start);
+extern void put_unused_fd(unsigned int fd);
+extern void fd_install(unsigned int fd, struct file * file);
+struct files_struct;
+extern int dup_fd_table(struct files_struct * files);
+extern void free_fd_table(struct files_struct * files);
 extern struct buffer_head * get_hash_table(dev_t dev, int block, int size);
 extern struct buffer_head * getblk(dev_t dev, int block, int size);
 extern void ll_rw_block(int rw, int nr, struct buffer_head * bh[]);
 extern void ll_rw_page(int rw, int dev, int nr, char * buffer);
+extern void ll_rw_pages(int rw, int dev, int nr, char ** buffers, int count);
 extern void ll_rw_swap_file(int rw, int dev, unsigned int *b, int nb, char *buffer);
 extern int is_read_only(int dev);
 extern void brelse(struct buffer_head * buf);
 extern void set_blocksize(dev_t dev, int size);
 extern struct buffer_head * bread(dev_t dev, int block, int size);
 extern unsigned long bread_page(unsigned long addr,dev_t dev,int b[],int size,int no_share);
+extern unsigned long get_cached_page(dev_t dev, int b[], int size);
 extern struct buffer_head * breada(dev_t dev,int block, int size, 
 				   unsigned int pos, unsigned int filesize);
 extern void put_super(dev_t dev);
@@ -586,6 +609,8 @@ extern int char_write(struct inode *, struct file *, char *, int);
 extern int block_write(struct inode *, struct file *, char *, int);
 
 extern int generic_mmap(struct inode *, struct file *, struct vm_area_struct *);
+extern int generic_file_read(struct inode *, struct file *, char *, int);
+extern int generic_file_readv(struct inode *, struct file *, struct iovec *, int);
 
 extern int block_fsync(struct inode *, struct file *);
 extern int file_fsync(struct inode *, struct file *);
@@ -72,6 +72,10 @@ struct vm_area_struct {
 	unsigned long vm_offset;	//vm_offset是该区域的内容相对于文件起始位置的偏移量，或相对于共享内存首址的偏移量
 	struct inode * vm_inode;	//若虚存区域映射的是磁盘文件或设备文件的的内容，则vm_inode指向这个文件的inode结构体，否则vm_inode为NULL
 	unsigned long vm_pte;			/* shared mem */
+/* fault readahead state for file mappings, see filemap.c */
+	unsigned long vm_ra_next;	/* file offset after the last fault */
+	unsigned long vm_ra_end;	/* read ahead up to here */
+	unsigned long vm_ra_size;	/* current window, in pages */
 };
 
 /*
@@ -153,6 +157,8 @@ struct page_info {
 extern int nr_swap_pages;
 extern int nr_free_pages;
 extern int min_free_pages;
+extern int free_pages_low;
+extern int free_pages_high;
 
 #define NR_MEM_LISTS 6
 
@@ -161,7 +167,26 @@ struct mem_list {
 	struct mem_list * prev;
 };
 
-extern struct mem_list free_area_list[NR_MEM_LISTS];
+/*
+ * Free memory is kept in zones: ZONE_DMA is what ISA DMA can reach,
+ * ZONE_NORMAL everything above it.  Each zone has its own buddy lists
+ * and watermarks.  The buddy bitmaps are shared, as no free block ever
+ * crosses a zone boundary.
+ */
+#define ZONE_DMA	0
+#define ZONE_NORMAL	1
+#define NR_ZONES	2
+
+struct mem_zone {
+	struct mem_list free_area_list[NR_MEM_LISTS];
+	unsigned long start, end;	/* addresses */
+	unsigned long size;		/* pages */
+	int nr_free_pages;
+	int pages_min, pages_low, pages_high;
+	char * name;
+};
+
+extern struct mem_zone mem_zones[NR_ZONES];
 extern unsigned char * free_area_map[NR_MEM_LISTS];
 
 /*
@@ -172,10 +197,16 @@ extern unsigned char * free_area_map[NR_MEM_LISTS];
 #define __get_free_page(priority) __get_free_pages((priority),0)
 extern unsigned long __get_free_pages(int priority, unsigned long gfporder);
 extern unsigned long __get_dma_pages(int priority, unsigned long gfporder);
+extern unsigned long zero_pool_get(void);
+extern int zero_pool_fill(void);
+
 extern inline unsigned long get_free_page(int priority)
 {
 	unsigned long page;
 
+	page = zero_pool_get();
+	if (page)
+		return page;
 	page = __get_free_page(priority);
 	if (page)
 		memset((void *) page, 0, PAGE_SIZE);
@@ -195,6 +226,7 @@ extern void free_page_tables(struct task_struct * tsk);
 extern void clear_page_tables(struct task_struct * tsk);
 extern int copy_page_tables(struct task_struct * to);
 extern int clone_page_tables(struct task_struct * to);
+extern pte_t * unshare_pte(pmd_t * pmd, unsigned long address);
 extern int unmap_page_range(unsigned long from, unsigned long size);
 extern int remap_page_range(unsigned long from, unsigned long to, unsigned long size, pgprot_t prot);
 extern int zeromap_page_range(unsigned long from, unsigned long size, pgprot_t prot);
@@ -202,6 +234,7 @@ extern int zeromap_page_range(unsigned long from, unsigned long size, pgprot_t p
 extern void handle_mm_fault(struct vm_area_struct *vma, unsigned long address, int write_access);
 extern void do_wp_page(struct vm_area_struct * vma, unsigned long address, int write_access);
 extern void do_no_page(struct vm_area_struct * vma, unsigned long address, int write_access);
+extern unsigned long get_user_page(struct task_struct * tsk, unsigned long address, int write_access);
 
 extern unsigned long paging_init(unsigned long start_mem, unsigned long end_mem);
 extern void mem_init(unsigned long start_mem, unsigned long end_mem);
@@ -224,6 +257,15 @@ extern void swap_in(struct vm_area_struct *, pte_t *, unsigned long id, int writ
 extern void si_swapinfo(struct sysinfo * val);
 extern void rw_swap_page(int rw, unsigned long nr, char * buf);
 
+/* zswap.c */
+struct zswap_area;
+extern struct zswap_area * zswap_create(unsigned long max, unsigned long cap);
+extern void zswap_destroy(struct zswap_area *);
+extern void zswap_io(struct zswap_area *, int rw, unsigned long offset, char * buf);
+extern void zswap_drop(struct zswap_area *, unsigned long offset);
+extern int zswap_full(struct zswap_area *);
+extern int zswap_get_info(char * buffer);
+
 /* mmap.c */
 extern unsigned long do_mmap(struct file * file, unsigned long addr, unsigned long len,
 unsigned long prot, unsigned long flags, unsigned long off);
@@ -316,6 +358,28 @@ extern inline int delete_from_swap_cache(unsigned long addr)
 	return 0;
 }
 
+/*
+ * Page aging.  Every frame has an age that goes up when swap_out() finds
+ * its pte young and is halved when it doesn't; only pages that have aged
+ * down to zero get evicted.  mem_rmap[] points from a private page back
+ * to its pte, as the virtual address or'ed with the owner's slot in
+ * task[].  It is only a hint and is checked against the page tables
+ * before use, so nobody has to clear it.
+ */
+#define PAGE_AGE_INIT	3
+#define PAGE_AGE_ADV	3
+#define PAGE_AGE_MAX	20
+
+extern unsigned char * mem_age;
+extern unsigned long * mem_rmap;
+
+extern inline void set_page_owner(unsigned long page, struct task_struct * tsk,
+	unsigned long address)
+{
+	if (page < high_memory)
+		mem_rmap[MAP_NR(page)] = (address & PAGE_MASK) | tsk->task_nr;
+}
+
 #endif /* __KERNEL__ */
 
 #endif
@@ -19,7 +19,8 @@
 
 #define MSDOS_SUPER_MAGIC 0x4d44 /* MD */
 
-#define FAT_CACHE    8 /* FAT cache size */
+#define FAT_EXTENT_MIN 8 /* cluster runs first allocated per inode */
+#define FAT_EXTENT_MAX 512 /* most cluster runs mapped per inode */
 
 #define ATTR_RO      1  /* read-only */
 #define ATTR_HIDDEN  2  /* hidden */
@@ -87,12 +88,10 @@ struct msdos_dir_entry {
 	__u32	size;		/* file size (in bytes) */
 };
 
-struct fat_cache {
-	int device; /* device number. 0 means unused. */
-	int ino; /* inode number. */
-	int file_cluster; /* cluster number in the file. */
-	int disk_cluster; /* cluster number on disk. */
-	struct fat_cache *next; /* next cache entry */
+struct fat_extent {
+	int file_cluster; /* first cluster number in the file. */
+	int disk_cluster; /* its cluster number on disk. */
+	int len; /* number of consecutive clusters in this run. */
 };
 
 /* Determine whether this FS has kB-aligned data. */
@@ -133,11 +132,10 @@ extern int msdos_subdirs(struct inode *dir);
 extern int fat_access(struct super_block *sb,int nr,int new_value);
 extern int msdos_smap(struct inode *inode,int sector);
 extern int fat_free(struct inode *inode,int skip);
-extern void cache_init(void);
+extern void fat_sync(struct super_block *sb);
 void cache_lookup(struct inode *inode,int cluster,int *f_clu,int *d_clu);
 void cache_add(struct inode *inode,int f_clu,int d_clu);
 void cache_inval_inode(struct inode *inode);
-void cache_inval_dev(int device);
 int get_cluster(struct inode *inode,int cluster);
 
 /* namei.c */
@@ -157,6 +155,7 @@ extern int msdos_rename(struct inode *old_dir,const char *old_name,int old_len,
 
 extern void msdos_put_inode(struct inode *inode);
 extern void msdos_put_super(struct super_block *sb);
+extern void msdos_write_super(struct super_block *sb);
 extern struct super_block *msdos_read_super(struct super_block *s,
 					    void *data,int);
 extern void msdos_statfs(struct super_block *sb,struct statfs *buf);
@@ -34,6 +34,13 @@ struct msdos_inode_info {
 	struct inode *i_old;	/* pointer to the old inode this inode
 				   depends on */
 	int i_binary;	/* file contains non-text data */
+	struct fat_extent *i_ext; /* cluster runs, in file order */
+	unsigned short i_ext_count; /* runs in use */
+	unsigned short i_ext_size; /* runs allocated */
+	int i_ext_mapped;	/* clusters covered by the runs */
+	int i_ext_eof;		/* the chain ends at i_ext_mapped */
+	int i_ext_gen;		/* bumped whenever the map is dropped */
+	int i_hint_file,i_hint_disk; /* last cluster found past the map */
 };
 
 #endif
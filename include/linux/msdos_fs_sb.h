@@ -5,6 +5,8 @@
  * MS-DOS file system in-core superblock data
  */
 
+#define FAT_DIRTY 16 /* FAT sectors whose copies may lag behind */
+
 struct msdos_sb_info {
 	unsigned short cluster_size; /* sectors/cluster */
 	unsigned char fats,fat_bits; /* number of FATs, FAT bits (12 or 16) */
@@ -22,6 +24,9 @@ struct msdos_sb_info {
 	int fat_lock;
 	int prev_free; /* previously returned free cluster number */
 	int free_clusters; /* -1 if undefined */
+	int fat_dirty; /* entries used in fat_dirty_sec */
+	unsigned short fat_dirty_sec[FAT_DIRTY]; /* FAT sectors not yet
+						    copied to the other FATs */
 };
 
 #endif
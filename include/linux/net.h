@@ -43,6 +43,10 @@
 #define SYS_SHUTDOWN	13		/* sys_shutdown(2)		*/
 #define SYS_SETSOCKOPT	14		/* sys_setsockopt(2)		*/
 #define SYS_GETSOCKOPT	15		/* sys_getsockopt(2)		*/
+#define SYS_SENDMSG	16		/* sys_sendmsg(2)		*/
+#define SYS_RECVMSG	17		/* sys_recvmsg(2)		*/
+#define SYS_RECVMMSG	18		/* sys_recvmmsg(2)		*/
+#define SYS_SENDMMSG	19		/* sys_sendmmsg(2)		*/
 
 
 typedef enum {
@@ -124,6 +128,10 @@ struct proto_ops {
 			 char *optval, int *optlen);
   int	(*fcntl)	(struct socket *sock, unsigned int cmd,
 			 unsigned long arg);	
+  int	(*sendmsg)	(struct socket *sock, struct msghdr *msg, int len,
+			 int nonblock, unsigned flags);
+  int	(*recvmsg)	(struct socket *sock, struct msghdr *msg, int len,
+			 int nonblock, unsigned flags, int *addr_len);
 };
 
 struct net_proto {
@@ -133,6 +141,8 @@ struct net_proto {
 
 extern int	sock_awaitconn(struct socket *mysock, struct socket *servsock, int flags);
 extern int	sock_wake_async(struct socket *sock, int how);
+extern void	memcpy_fromiovec(unsigned char *to, struct iovec *iov, int len);
+extern void	memcpy_toiovec(struct iovec *iov, unsigned char *from, int len);
 extern int	sock_register(int family, struct proto_ops *ops);
 extern int	sock_unregister(int family);
 extern struct socket *sock_alloc(void);
@@ -11,13 +11,27 @@
 	NOTE：如果在阅读过程中遇到什么问题，欢迎和我交流讨论
 	Email：liuyihaolovem@163.com
 */
+/*
+ * A pipe is a ring of up to PIPE_MAX_PAGES pages.  The ring size is a
+ * power-of-two number of pages, so offsets wrap with a mask; a single
+ * copy never crosses a page boundary.  The default is one page, and
+ * F_SETPIPE_SZ can grow (or shrink) it per pipe.
+ *
+ * The structure overlays the start of the on-disk inode data of a fifo
+ * (ext2's i_data[] and so on), so it must not grow: a one-page ring is
+ * pointed to by 'base' directly, a larger one by way of a kmalloc'ed
+ * array of its pages.
+ */
+#define PIPE_MAX_PAGES	16
+
 struct pipe_inode_info {
 	struct wait_queue * wait;	//不管是读进程还是写进程，都睡眠在同一个队列中，
 								//我想这是为了在每次睡眠唤醒操作中，都对每个睡眠的进程做信号检测
-	char * base;
+	char * base;		/* the page, or the array of pages */
 	unsigned int start;
 	unsigned int len;
-	unsigned int lock;
+	unsigned short lock;
+	unsigned short pages;	/* ring size in pages */
 	unsigned int rd_openers;	//以读方式打开此管道而被阻塞（因为没有写进程）的进程总数 也即睡眠在此管道节点上的读进程数
 	unsigned int wr_openers;	//以写方式打开此管道而被阻塞（因为没有读进程）的进程总数 也即睡眠在此管道节点上的写进程数
 	unsigned int readers;	//读进程总数
@@ -26,6 +40,8 @@ struct pipe_inode_info {
 
 #define PIPE_WAIT(inode)	((inode).u.pipe_i.wait)
 #define PIPE_BASE(inode)	((inode).u.pipe_i.base)
+#define PIPE_PAGES(inode)	((inode).u.pipe_i.pages)
+#define PIPE_BUFSIZE(inode)	((unsigned int) PIPE_PAGES(inode) << PAGE_SHIFT)
 #define PIPE_START(inode)	((inode).u.pipe_i.start)
 #define PIPE_LEN(inode)		((inode).u.pipe_i.len)
 #define PIPE_RD_OPENERS(inode)	((inode).u.pipe_i.rd_openers)
@@ -36,11 +52,13 @@ struct pipe_inode_info {
 #define PIPE_SIZE(inode)	PIPE_LEN(inode)
 
 #define PIPE_EMPTY(inode)	(PIPE_SIZE(inode)==0)
-#define PIPE_FULL(inode)	(PIPE_SIZE(inode)==PIPE_BUF)
-#define PIPE_FREE(inode)	(PIPE_BUF - PIPE_LEN(inode))
+#define PIPE_FULL(inode)	(PIPE_SIZE(inode)==PIPE_BUFSIZE(inode))
+#define PIPE_FREE(inode)	(PIPE_BUFSIZE(inode) - PIPE_LEN(inode))
 #define PIPE_END(inode)		((PIPE_START(inode)+PIPE_LEN(inode))&\
-							   (PIPE_BUF-1))
-#define PIPE_MAX_RCHUNK(inode)	(PIPE_BUF - PIPE_START(inode))
-#define PIPE_MAX_WCHUNK(inode)	(PIPE_BUF - PIPE_END(inode))
+							   (PIPE_BUFSIZE(inode)-1))
+#define PIPE_MAX_RCHUNK(inode)	(PAGE_SIZE - (PIPE_START(inode) & (PAGE_SIZE-1)))
+#define PIPE_MAX_WCHUNK(inode)	(PAGE_SIZE - (PIPE_END(inode) & (PAGE_SIZE-1)))
+#define PIPE_ADDR(inode,off)	(PIPE_PAGES(inode) == 1 ? PIPE_BASE(inode) + (off) : \
+	((char **) PIPE_BASE(inode))[(off) >> PAGE_SHIFT] + ((off) & (PAGE_SIZE-1)))
 
 #endif
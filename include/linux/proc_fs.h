@@ -30,6 +30,8 @@ enum root_directory_inos {
 	PROC_KSYMS,
 	PROC_DMA,	
 	PROC_IOPORTS,
+	PROC_ZONEINFO,
+	PROC_INODES,
 	PROC_PROFILE /* whether enabled or not */
 };
 
@@ -105,14 +105,28 @@ asmlinkage void schedule(void);
 
 #endif /* __KERNEL__ */
 
+/*
+ * The descriptor table starts out in fd_array[] and the two _init
+ * bitmaps.  Once a process needs more than NR_OPEN descriptors it is
+ * moved to a vmalloc()ed block, which expand_files() doubles as needed.
+ */
 struct files_struct {
 	int count;
-	fd_set close_on_exec;
-	struct file * fd[NR_OPEN];
+	int max_fds;			/* entries in fd[], bits in the maps */
+	unsigned long * close_on_exec;
+	unsigned long * open_fds;	/* set for every fd[] in use */
+	struct file ** fd;
+	fd_set close_on_exec_init;
+	fd_set open_fds_init;
+	struct file * fd_array[NR_OPEN];
 };
 
 #define INIT_FILES { \
-	0, \
+	0, NR_OPEN, \
+	init_task.files[0].close_on_exec_init.fds_bits, \
+	init_task.files[0].open_fds_init.fds_bits, \
+	init_task.files[0].fd_array, \
+	{ { 0, } }, \
 	{ { 0, } }, \
 	{ NULL, } \
 }
@@ -260,6 +274,11 @@ struct task_struct {
 	维护了一个AVL树。在树中，所有的 vm_area_struct虚存块均由左指针指向相邻的低虚存块，右指针指向相邻的高虚存块。
 */
 	struct mm_struct mm[1];
+/* slot in task[], for the page owner hints in mem_rmap[] */
+	int task_nr;
+/* vfork(): the parent whose memory we run on, and where it waits for it */
+	struct task_struct *p_vfork;
+	struct wait_queue *vfork_wait;
 };
 
 /*
@@ -272,6 +291,7 @@ struct task_struct {
 
 #define PF_STARTING	0x00000100	/* being created */
 #define PF_EXITING	0x00000200	/* getting shut down */
+#define PF_VFORK	0x00000400	/* waiting for a vfork() child to let go */
 
 /*
  * cloning flags:
@@ -279,6 +299,7 @@ struct task_struct {
 #define CSIGNAL		0x000000ff	/* signal mask to be sent at exit */
 #define COPYVM		0x00000100	/* set if VM copy desired (like normal fork()) */
 #define COPYFD		0x00000200	/* set if fd's should be copied, not shared (NI) */
+#define COPYVFORK	0x00000400	/* borrow the parent's VM until exec/exit (vfork()) */
 
 /*
  *  INIT_TASK is used to set up the first task table, touch at
@@ -301,7 +322,7 @@ struct task_struct {
 /* rlimits */   { {LONG_MAX, LONG_MAX}, {LONG_MAX, LONG_MAX},  \
 		  {LONG_MAX, LONG_MAX}, {LONG_MAX, LONG_MAX},  \
 		  {       0, LONG_MAX}, {LONG_MAX, LONG_MAX}, \
-		  {MAX_TASKS_PER_USER, MAX_TASKS_PER_USER}, {NR_OPEN, NR_OPEN}}, \
+		  {MAX_TASKS_PER_USER, MAX_TASKS_PER_USER}, {NR_OPEN, NR_OPEN_MAX}}, \
 /* math */	0, \
 /* comm */	"swapper", \
 /* fs info */	0,NULL, \
@@ -346,6 +367,7 @@ extern void exit_thread(void);
 
 extern int do_execve(char *, char **, char **, struct pt_regs *);
 extern int do_fork(unsigned long, unsigned long, struct pt_regs *);
+extern void vfork_release(struct task_struct *);
 asmlinkage int do_signal(unsigned long, struct pt_regs *);
 
 /*
@@ -444,6 +466,10 @@ extern inline void select_wait(struct wait_queue ** wait_address, select_table *
 	//如果p为空，或者wait_address为空（没有指出睡眠队列）
 	if (!p || !wait_address)
 		return;
+	if (p->queue) {
+		p->queue(wait_address, p);
+		return;
+	}
 	//p->nr代表了当前select_table页面中有效的select_table_entry数
 	if (p->nr >= __MAX_SELECT_TABLE_ENTRIES)
 		return;
@@ -451,6 +477,7 @@ extern inline void select_wait(struct wait_queue ** wait_address, select_table *
 	entry->wait_address = wait_address;	//entry中wait节点变量所属的等待队列
 	entry->wait.task = current;	//entry中wait节点变量所代表的睡眠进程
 	entry->wait.next = NULL;
+	entry->wait.func = NULL;
 	//将entry->wait睡眠节点加入到wait_address睡眠队列
 	add_wait_queue(wait_address,&entry->wait);
 	//增加p所指向的select_table中有效select_table_entry数
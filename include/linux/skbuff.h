@@ -16,6 +16,7 @@
 #include <linux/malloc.h>
 #include <linux/wait.h>
 #include <linux/time.h>
+#include <linux/uio.h>
 #include <linux/config.h>
 
 #undef CONFIG_SKB_CHECK
@@ -280,6 +281,7 @@ extern __inline__ void skb_unlink(struct sk_buff *skb)
 extern struct sk_buff *		skb_recv_datagram(struct sock *sk,unsigned flags,int noblock, int *err);
 extern int			datagram_select(struct sock *sk, int sel_type, select_table *wait);
 extern void			skb_copy_datagram(struct sk_buff *from, int offset, char *to,int size);
+extern void			skb_copy_datagram_iovec(struct sk_buff *from, int offset, struct iovec *to,int size);
 extern void			skb_free_datagram(struct sk_buff *skb);
 
 #endif	/* __KERNEL__ */
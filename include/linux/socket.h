@@ -2,6 +2,7 @@
 #define _LINUX_SOCKET_H
 
 #include <linux/sockios.h>		/* the SIOCxxx I/O controls	*/
+#include <linux/uio.h>			/* struct iovec			*/
 
 
 struct sockaddr {
@@ -14,6 +15,24 @@ struct linger {
   int			l_linger;	/* How long to linger for	*/
 };
 
+/* One message for sendmsg()/recvmsg(), BSD 4.3 layout. */
+struct msghdr {
+  void			*msg_name;	/* address, or NULL		*/
+  int			msg_namelen;	/* its size			*/
+  struct iovec		*msg_iov;	/* data pieces			*/
+  int			msg_iovlen;	/* how many of them		*/
+  void			*msg_accrights;	/* rights passing: unsupported	*/
+  int			msg_accrightslen;
+};
+
+/* One element of a sendmmsg()/recvmmsg() batch. */
+struct mmsghdr {
+  struct msghdr		msg_hdr;
+  unsigned int		msg_len;	/* bytes moved for this message	*/
+};
+
+#define UIO_MAXMMSG	1024		/* most messages in one batch	*/
+
 /* Socket types. */
 #define SOCK_STREAM	1		/* stream (connection) socket	*/
 #define SOCK_DGRAM	2		/* datagram (conn.less) socket	*/
@@ -0,0 +1,14 @@
+#ifndef _LINUX_SWAP_H
+#define _LINUX_SWAP_H
+
+/*
+ * Flags for the second argument of swapon().  With a NULL file name and
+ * SWAP_FLAG_COMPRESS, swapon() sets up a swap area that keeps pages
+ * compressed in memory instead of writing them out; the low bits give
+ * the most memory it may use, in pages (0 means a quarter of RAM).
+ * swapoff(NULL) removes it again.
+ */
+#define SWAP_FLAG_COMPRESS	0x10000
+#define SWAP_FLAG_SIZE_MASK	0x0ffff
+
+#endif
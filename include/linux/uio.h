@@ -0,0 +1,15 @@
+#ifndef _LINUX_UIO_H
+#define _LINUX_UIO_H
+
+/*
+ * Scatter/gather descriptors, as used by sendmsg()/recvmsg().
+ */
+
+struct iovec {
+	void	*iov_base;	/* start of this piece of the buffer */
+	int	iov_len;	/* and its size */
+};
+
+#define UIO_MAXIOV	16	/* most pieces we accept in one call */
+
+#endif
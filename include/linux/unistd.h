@@ -146,6 +146,15 @@
 #define __NR_setfsuid		138
 #define __NR_setfsgid		139
 #define __NR__llseek		140
+#define __NR_sendfile		141
+#define __NR_epoll_create	142
+#define __NR_epoll_ctl		143
+#define __NR_epoll_wait		144
+#define __NR_splice		145
+#define __NR_kswapd		146
+#define __NR_vfork		147
+#define __NR_readv		148
+#define __NR_writev		149
 
 extern int errno;
 
@@ -12,6 +12,7 @@
 struct wait_queue {
 	struct task_struct * task;	//睡眠的进程
 	struct wait_queue * next;	//指向下一个等待节点
+	void (*func)(struct wait_queue *);	/* called by wake_up() when task is NULL */
 };
 
 struct semaphore {
@@ -30,6 +31,8 @@ struct select_table_entry {
 typedef struct select_table_struct {
 	int nr;	//当前select_table页面中有效的select_table_entry数
 	struct select_table_entry * entry;	//指向select_table_entry链表头
+	/* if set, select_wait() hands the queue to this instead (eventpoll) */
+	void (*queue)(struct wait_queue **, struct select_table_struct *);
 } select_table;
 
 #define __MAX_SELECT_TABLE_ENTRIES (4096 / sizeof (struct select_table_entry))
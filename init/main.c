@@ -599,6 +599,14 @@ void init(void)
 	在系统关闭之前，init 进程一直存活，因为它创建和监控在操作系统外层执行的所有进程的活动。
 */
 	setup();
+
+	/*
+	 * Start the page reclaim daemon. It lives in sys_kswapd() and
+	 * never comes back, so it doesn't matter that it shares our stack.
+	 */
+	if (!fork())
+		kswapd();
+
 	sprintf(term, "TERM=con%dx%d", ORIG_VIDEO_COLS, ORIG_VIDEO_LINES);
 
 	#ifdef CONFIG_UMSDOS_FS
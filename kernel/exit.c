@@ -447,9 +447,10 @@ static void exit_files(void)
 {
 	int i;
 
-	for (i=0 ; i<NR_OPEN ; i++)
+	for (i=0 ; i<current->files->max_fds ; i++)
 		if (current->files->fd[i])
 			sys_close(i);
+	free_fd_table(current->files);
 }
 
 static void exit_fs(void)
@@ -500,6 +501,7 @@ fake_volatile:
 	current->flags |= PF_EXITING;
 	//对当前进程的信号量集合做退出处理
 	sem_exit();
+	vfork_release(current);
 	/* Release all mmaps. */
 	exit_mmap(current);
 	//frees up all page tables of a process 
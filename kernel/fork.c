@@ -91,7 +91,7 @@ static struct file * copy_fd(struct file * old_file)
 			error = new_file->f_op->open(new_file->f_inode,new_file);
 			if (error) {
 				iput(new_file->f_inode);
-				new_file->f_count = 0;
+				put_filp(new_file);
 				new_file = NULL;
 			}
 		}
@@ -148,11 +148,11 @@ static void copy_files(unsigned long clone_flags, struct task_struct * p)
 	struct file * f;
 	//COPYFD:set if fd's should be copied, not shared (NI)
 	if (clone_flags & COPYFD) {
-		for (i=0; i<NR_OPEN;i++)
+		for (i=0; i<p->files->max_fds;i++)
 			if ((f = p->files->fd[i]) != NULL)
 				p->files->fd[i] = copy_fd(f);
 	} else {
-		for (i=0; i<NR_OPEN;i++)
+		for (i=0; i<p->files->max_fds;i++)
 			if ((f = p->files->fd[i]) != NULL)
 				f->f_count++;
 	}
@@ -172,6 +172,22 @@ static void copy_files(unsigned long clone_flags, struct task_struct * p)
  */
 static int copy_mm(unsigned long clone_flags, struct task_struct * p)
 {
+	/*
+	 * vfork(): the child keeps the parent's vmas (they came along with
+	 * the task_struct) and runs on its page directory. vfork_release()
+	 * sorts things out again at exec or exit time. Until then the child
+	 * may change or free those vmas, so the sleeping parent lets go of
+	 * them and is kept away from swap_out().
+	 */
+	if (clone_flags & COPYVFORK) {
+		if (clone_page_tables(p))
+			return 1;
+		p->p_vfork = current;
+		current->mm->mmap = NULL;
+		current->mm->mmap_avl = NULL;
+		current->mm->swappable = 0;
+		return 0;
+	}
 	if (clone_flags & COPYVM) {
 		p->mm->min_flt = p->mm->maj_flt = 0;
 		p->mm->cmin_flt = p->mm->cmaj_flt = 0;
@@ -193,6 +209,34 @@ static int copy_mm(unsigned long clone_flags, struct task_struct * p)
 	改变当前目录、根目录等信息都将直接影响到其他线程。
 */
 
+/*
+ * Called by a vfork() child in execve() and exit(), before it lets go of
+ * its memory: the vmas go back to the parent along with anything the
+ * child did to them meanwhile, the child gets a page directory of its
+ * own, and the parent may run again.
+ */
+void vfork_release(struct task_struct * tsk)
+{
+	struct task_struct * parent = tsk->p_vfork;
+	struct vm_area_struct * mpnt;
+
+	if (!parent)
+		return;
+	tsk->p_vfork = NULL;
+	for (mpnt = tsk->mm->mmap ; mpnt ; mpnt = mpnt->vm_next)
+		mpnt->vm_task = parent;
+	parent->mm->mmap = tsk->mm->mmap;
+	parent->mm->mmap_avl = tsk->mm->mmap_avl;
+	parent->mm->brk = tsk->mm->brk;
+	parent->mm->swappable = 1;
+	tsk->mm->mmap = NULL;
+	tsk->mm->mmap_avl = NULL;
+	tsk->mm->rss = 0;
+	clear_page_tables(tsk);
+	parent->flags &= ~PF_VFORK;
+	wake_up(&parent->vfork_wait);
+}
+
 static void copy_fs(unsigned long clone_flags, struct task_struct * p)
 {
 	if (current->fs->pwd)
@@ -268,6 +312,10 @@ int do_fork(unsigned long clone_flags, unsigned long usp, struct pt_regs *regs)
 	p->start_time = jiffies;
 	//进程现在还不可以换出
 	p->mm->swappable = 0;	/* don't try to swap it out before it's set up */
+	p->task_nr = nr;
+	p->p_vfork = NULL;
+	p->vfork_wait = NULL;
+	p->flags &= ~PF_VFORK;
 	task[nr] = p;
 	//将进程链入系统进程链表中
 	SET_LINKS(p);
@@ -276,8 +324,10 @@ int do_fork(unsigned long clone_flags, unsigned long usp, struct pt_regs *regs)
 	//拷贝父进程的系统堆栈并做相应的调整
 	copy_thread(nr, clone_flags, usp, p, regs);
 	//copy_mm、copy_files和copy_fs会根据clone_flags标志来决定是复制还是共享父进程的vm、files和fs
-	if (copy_mm(clone_flags, p))
+	if (dup_fd_table(p->files))
 		goto bad_fork_cleanup;
+	if (copy_mm(clone_flags, p))
+		goto bad_fork_cleanup_files;
 	//子进程的信号量的undo队列为空
 	p->semundo = NULL;
 	copy_files(clone_flags, p);
@@ -291,7 +341,16 @@ int do_fork(unsigned long clone_flags, unsigned long usp, struct pt_regs *regs)
 	p->counter = current->counter >> 1;
 	//可以将子进程置为可运行状态了
 	p->state = TASK_RUNNING;	/* do this last, just in case */
+	if (clone_flags & COPYVFORK) {
+		nr = p->pid;
+		current->flags |= PF_VFORK;
+		while (current->flags & PF_VFORK)
+			sleep_on(&current->vfork_wait);
+		return nr;
+	}
 	return p->pid;
+bad_fork_cleanup_files:
+	free_fd_table(p->files);
 bad_fork_cleanup:
 	task[nr] = NULL;
 	REMOVE_LINKS(p);
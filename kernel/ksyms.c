@@ -279,6 +279,11 @@ struct symbol_table symbol_table = {
 	X(flush_old_exec),
 	X(open_inode),
 	X(read_exec),
+	X(exec_cache_alloc),
+	X(exec_cache_find),
+	X(exec_cache_add),
+	X(exec_cache_gen),
+	X(exec_cache_put),
 
 	/* Miscellaneous access points */
 	X(si_meminfo),
@@ -376,6 +381,7 @@ struct symbol_table symbol_table = {
 	X(msdos_unlink),
 	X(msdos_unlink_umsdos),
 	X(msdos_write_inode),
+	X(msdos_write_super),
 #endif
 	/********************************************************
 	 * Do not add anything below this line,
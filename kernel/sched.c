@@ -269,7 +269,8 @@ void wake_up(struct wait_queue **q)
 				if (p->counter > current->counter + 3)
 					need_resched = 1;
 			}
-		}
+		} else if (tmp->func)
+			tmp->func(tmp);
 		if (!tmp->next) {
 			printk("wait_queue is bad (eip = %p)\n",
 				__builtin_return_address(0));
@@ -296,7 +297,8 @@ void wake_up_interruptible(struct wait_queue **q)
 				if (p->counter > current->counter + 3)
 					need_resched = 1;
 			}
-		}
+		} else if (tmp->func)
+			tmp->func(tmp);
 		if (!tmp->next) {
 			printk("wait_queue is bad (eip = %p)\n",
 				__builtin_return_address(0));
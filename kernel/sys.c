@@ -769,7 +769,7 @@ asmlinkage int sys_setrlimit(unsigned int resource, struct rlimit *rlim)
 	    !suser())
 		return -EPERM;
 	if (resource == RLIMIT_NOFILE) {
-		if (new_rlim.rlim_cur > NR_OPEN || new_rlim.rlim_max > NR_OPEN)
+		if (new_rlim.rlim_cur > NR_OPEN_MAX || new_rlim.rlim_max > NR_OPEN_MAX)
 			return -EPERM;
 	}
 	*old_rlim = new_rlim;
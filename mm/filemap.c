@@ -31,6 +31,7 @@
 #include <linux/mman.h>
 #include <linux/string.h>
 #include <linux/malloc.h>
+#include <linux/locks.h>
 
 #include <asm/segment.h>
 #include <asm/system.h>
@@ -41,27 +42,152 @@
  * though.
  */
 
+/*
+ * Faults on file mappings read ahead and map around.
+ *
+ * A fault that lands at or a little past where the last one left off
+ * counts as sequential: the readahead window doubles, up to
+ * FILEMAP_RA_MAX pages, and the blocks of the next window are queued
+ * with READA so that they are in the buffer cache before we get there.
+ * Any other fault closes the window.
+ *
+ * Every fault also maps those pages of its aligned FILEMAP_AROUND group
+ * whose blocks are already cached in a page of their own, so a scan
+ * through cached data takes one trap per group rather than per page.
+ */
+#define FILEMAP_RA_MIN	4
+#define FILEMAP_RA_MAX	32
+#define FILEMAP_AROUND	8
+
+static inline void filemap_bmap(struct inode * inode, unsigned long offset, int * nr)
+{
+	unsigned int block;
+	int i;
+
+	block = offset >> inode->i_sb->s_blocksize_bits;	//将文件偏移转化为块数
+	i = PAGE_SIZE >> inode->i_sb->s_blocksize_bits;
+	do {
+		//具体的文件系统只有支持此函数才能支持mmap
+		*nr++ = bmap(inode,block++);	//应该是通过逻辑块号得到实际块号 bmap->block map 将inode对应的文件中的逻辑块号1 2 3 转化为磁盘上对应的实际块号
+	} while (--i > 0);
+}
+
+static inline int filemap_sequential(struct vm_area_struct * area, unsigned long offset)
+{
+	if (offset < area->vm_ra_next)
+		return 0;
+	return offset < area->vm_ra_next + FILEMAP_AROUND * PAGE_SIZE ||
+		offset < area->vm_ra_end;
+}
+
+static void filemap_readahead(struct inode * inode, unsigned long offset,
+	unsigned long end)
+{
+	struct buffer_head * bh[8];
+	int size = inode->i_sb->s_blocksize;
+	int nr[8];
+	int i, n;
+
+	for ( ; offset < end && offset < inode->i_size ; offset += PAGE_SIZE) {
+		filemap_bmap(inode, offset, nr);
+		for (i = 0, n = 0 ; i < PAGE_SIZE / size ; i++) {
+			struct buffer_head * tmp;
+
+			if (!nr[i])
+				continue;
+			tmp = getblk(inode->i_dev, nr[i], size);
+			if (tmp->b_uptodate || tmp->b_lock) {
+				brelse(tmp);
+				continue;
+			}
+			bh[n++] = tmp;
+		}
+		if (n)
+			ll_rw_block(READA, n, bh);
+		while (n-- > 0)
+			brelse(bh[n]);
+	}
+}
+
+static void filemap_map_around(struct vm_area_struct * area, unsigned long address)
+{
+	struct inode * inode = area->vm_inode;
+	unsigned long start, end, offset, page;
+	pgd_t * pgd;
+	pmd_t * pmd;
+	pte_t * pte, entry;
+	int nr[8];
+
+	pgd = pgd_offset(area->vm_task, address);
+	if (pgd_none(*pgd) || pgd_bad(*pgd))
+		return;
+	pmd = pmd_offset(pgd, address);
+	if (pmd_none(*pmd) || pmd_bad(*pmd))
+		return;
+	start = address & ~(FILEMAP_AROUND * PAGE_SIZE - 1);
+	end = start + FILEMAP_AROUND * PAGE_SIZE;
+	if (start < area->vm_start)
+		start = area->vm_start;
+	if (end > area->vm_end)
+		end = area->vm_end;
+	pte = pte_offset(pmd, start);
+	for ( ; start < end ; start += PAGE_SIZE, pte++) {
+		if (start == address || !pte_none(*pte))
+			continue;
+		offset = start - area->vm_start + area->vm_offset;
+		if (offset >= inode->i_size)
+			break;
+		filemap_bmap(inode, offset, nr);
+		page = get_cached_page(inode->i_dev, nr, inode->i_sb->s_blocksize);
+		if (!page)
+			continue;
+		/* bmap() may have slept */
+		if (!pte_none(*pte)) {
+			free_page(page);
+			continue;
+		}
+		entry = mk_pte(page, area->vm_page_prot);
+		if (!(area->vm_flags & VM_SHARED))
+			entry = pte_wrprotect(entry);
+		*pte = entry;
+		area->vm_task->mm->rss++;
+	}
+}
+
 static unsigned long filemap_nopage(struct vm_area_struct * area, unsigned long address,
 	unsigned long page, int no_share)
 {
 	struct inode * inode = area->vm_inode;
-	unsigned int block;
+	unsigned long offset, ra_start, ra_end;
 	int nr[8];	//4K？
-	int i, *p;
 
 	address &= PAGE_MASK;
-	block = address - area->vm_start + area->vm_offset;	//获取address地址处对应的文件中的块地址
-	block >>= inode->i_sb->s_blocksize_bits;	//将block转化为块数
-	i = PAGE_SIZE >> inode->i_sb->s_blocksize_bits;
-	p = nr;
-	do {
-		//具体的文件系统只有支持此函数才能支持mmap
-		*p = bmap(inode,block);	//应该是通过逻辑块号得到实际块号 bmap->block map 将inode对应的文件中的逻辑块号1 2 3 转化为磁盘上对应的实际块号
-		i--;
-		block++;
-		p++;
-	} while (i > 0);
-	return bread_page(page, inode->i_dev, nr, inode->i_sb->s_blocksize, no_share);
+	offset = address - area->vm_start + area->vm_offset;	//获取address地址处对应的文件中的偏移
+	if (filemap_sequential(area, offset)) {
+		area->vm_ra_size <<= 1;
+		if (area->vm_ra_size < FILEMAP_RA_MIN)
+			area->vm_ra_size = FILEMAP_RA_MIN;
+		if (area->vm_ra_size > FILEMAP_RA_MAX)
+			area->vm_ra_size = FILEMAP_RA_MAX;
+	} else
+		area->vm_ra_size = 0;
+	area->vm_ra_next = offset + PAGE_SIZE;
+
+	filemap_bmap(inode, offset, nr);
+	page = bread_page(page, inode->i_dev, nr, inode->i_sb->s_blocksize, no_share);
+
+	if (area->vm_ra_size) {
+		ra_start = offset + PAGE_SIZE;
+		if (ra_start < area->vm_ra_end)
+			ra_start = area->vm_ra_end;
+		ra_end = offset + PAGE_SIZE + area->vm_ra_size * PAGE_SIZE;
+		if (ra_start < ra_end) {
+			filemap_readahead(inode, ra_start, ra_end);
+			area->vm_ra_end = ra_end;
+		}
+	}
+	filemap_map_around(area, address);
+	return page;
 }
 
 /*
@@ -286,5 +412,277 @@ int generic_mmap(struct inode * inode, struct file * file, struct vm_area_struct
 	vma->vm_inode = inode;
 	inode->i_count++;
 	vma->vm_ops = ops;	//这是本函数的实质
+	vma->vm_ra_next = vma->vm_offset;
+	vma->vm_ra_end = vma->vm_offset;
+	vma->vm_ra_size = 0;
 	return 0;
 }
+
+/*
+ * read() for filesystems that keep file data in the buffer cache and
+ * can bmap() it.
+ *
+ * Every open file has a readahead window.  A read that starts in the
+ * block where the previous one ended, or just after it, is sequential.
+ * The first sequential read opens the window at the device's
+ * read_ahead[] size.  Whenever the reader gets into the window queued
+ * last, the next one is queued with READA at twice the size, up to
+ * FILE_RA_MAX bytes, and we don't wait for it.  Any other read, or an
+ * lseek(), closes the window.
+ *
+ * The blocks the read itself needs go through the usual two-stage
+ * loop: request as many as we can, wait for the first one, then copy
+ * out whatever has completed.
+ */
+#define FILE_RA_MAX	(128*1024)
+#define NBUF		32
+
+static struct buffer_head * file_getblk(struct inode * inode, unsigned long block)
+{
+	int nr = bmap(inode, block);
+
+	if (!nr)
+		return NULL;
+	return getblk(inode->i_dev, nr, inode->i_sb->s_blocksize);
+}
+
+static void file_readahead(struct inode * inode, unsigned long block, unsigned long end)
+{
+	struct buffer_head * bh[NBUF], * tmp;
+	int n = 0;
+
+	for ( ; block < end ; block++) {
+		tmp = file_getblk(inode, block);
+		if (!tmp)
+			continue;
+		if (tmp->b_uptodate || tmp->b_lock) {
+			brelse(tmp);
+			continue;
+		}
+		bh[n++] = tmp;
+		if (n < NBUF)
+			continue;
+		ll_rw_block(READA, n, bh);
+		while (n > 0)
+			brelse(bh[--n]);
+	}
+	if (n) {
+		ll_rw_block(READA, n, bh);
+		while (n > 0)
+			brelse(bh[--n]);
+	}
+}
+
+/*
+ * A read of blocks [block, end) of a file 'size' blocks long has had its
+ * own blocks requested: move the window along.
+ */
+static void file_update_ra(struct inode * inode, struct file * filp,
+	unsigned long block, unsigned long end, unsigned long size)
+{
+	int bits = inode->i_sb->s_blocksize_bits;
+	unsigned long min, max, start;
+
+	min = read_ahead[MAJOR(inode->i_dev)] >> (bits - 9);
+	max = FILE_RA_MAX >> bits;
+	if (min > max)
+		min = max;
+	if (!min || !filp->f_reada ||
+	    block + 1 < filp->f_ranext || block > filp->f_ranext) {
+		filp->f_ranext = end;
+		filp->f_raend = end;
+		filp->f_ralen = 0;
+		return;
+	}
+	filp->f_ranext = end;
+	if (filp->f_ralen) {
+		/* not yet into the last window queued? */
+		if (filp->f_raend > filp->f_ralen &&
+		    end <= filp->f_raend - filp->f_ralen)
+			return;
+		filp->f_ralen <<= 1;
+		if (filp->f_ralen > max)
+			filp->f_ralen = max;
+	} else
+		filp->f_ralen = min;
+	start = filp->f_raend;
+	if (start < end)
+		start = end;
+	if (start >= size)
+		return;
+	filp->f_raend = start + filp->f_ralen;
+	if (filp->f_raend > size)
+		filp->f_raend = size;
+	file_readahead(inode, start, filp->f_raend);
+}
+
+/*
+ * Hand 'chars' bytes of a block (zeroes for a hole, when 'from' is NULL)
+ * to the reader.  The iovec is a kernel copy and is consumed as we go, so
+ * the next block carries on where this one stopped.
+ */
+static void file_copy_out(struct iovec * iov, char * from, int chars)
+{
+	int copy;
+
+	while (chars > 0) {
+		copy = iov->iov_len;
+		if (copy > chars)
+			copy = chars;
+		if (copy) {
+			char * to = (char *) iov->iov_base;
+
+			iov->iov_base = to + copy;
+			iov->iov_len -= copy;
+			chars -= copy;
+			if (from) {
+				memcpy_tofs(to, from, copy);
+				from += copy;
+			} else {
+				while (copy-- > 0)
+					put_fs_byte(0, to++);
+			}
+		}
+		iov++;
+	}
+}
+
+/*
+ * Read 'count' bytes at f_pos into the pieces of 'iov'.  The blocks are
+ * looked up and requested once for the whole vector, however it is cut up.
+ */
+static int file_read_iov(struct inode * inode, struct file * filp,
+	struct iovec * iov, int count)
+{
+	int read, left, chars;
+	int offset, blocksize;
+	unsigned long block, next, end;
+	unsigned int size;
+	int bhrequest, uptodate, ra_done;
+	struct buffer_head ** bhb, ** bhe;
+	struct buffer_head * bhreq[NBUF];
+	struct buffer_head * buflist[NBUF];
+
+	if (!inode) {
+		printk("file_read_iov: inode = NULL\n");
+		return -EINVAL;
+	}
+	if (!S_ISREG(inode->i_mode)) {
+		printk("file_read_iov: mode = %07o\n",inode->i_mode);
+		return -EINVAL;
+	}
+	offset = filp->f_pos;
+	size = inode->i_size;
+	if (offset > size)
+		left = 0;
+	else
+		left = size - offset;
+	if (left > count)
+		left = count;
+	if (left <= 0)
+		return 0;
+	read = 0;
+	blocksize = inode->i_sb->s_blocksize;
+	block = offset >> inode->i_sb->s_blocksize_bits;
+	offset &= blocksize - 1;
+	size = (size + blocksize - 1) >> inode->i_sb->s_blocksize_bits;
+	end = block + ((left + offset + blocksize - 1) >> inode->i_sb->s_blocksize_bits);
+	next = block;
+	ra_done = 0;
+	bhb = bhe = buflist;
+
+	do {
+		bhrequest = 0;
+		uptodate = 1;
+		while (next < end) {
+			*bhb = file_getblk(inode, next++);
+			if (*bhb && !(*bhb)->b_uptodate) {
+				uptodate = 0;
+				bhreq[bhrequest++] = *bhb;
+			}
+
+			if (++bhb == &buflist[NBUF])
+				bhb = buflist;
+
+			/* If the block we have on hand is uptodate, go ahead
+			   and complete processing. */
+			if (uptodate)
+				break;
+			if (bhb == bhe)
+				break;
+		}
+
+		/* Now request them all */
+		if (bhrequest)
+			ll_rw_block(READ, bhrequest, bhreq);
+
+		/* and queue the readahead behind them */
+		if (!ra_done) {
+			file_update_ra(inode, filp, block, end, size);
+			ra_done = 1;
+		}
+
+		do { /* Finish off all I/O that has actually completed */
+			if (*bhe) {
+				wait_on_buffer(*bhe);
+				if (!(*bhe)->b_uptodate) {	/* read error? */
+					brelse(*bhe);
+					if (++bhe == &buflist[NBUF])
+						bhe = buflist;
+					left = 0;
+					break;
+				}
+			}
+			if (left < blocksize - offset)
+				chars = left;
+			else
+				chars = blocksize - offset;
+			filp->f_pos += chars;
+			left -= chars;
+			read += chars;
+			if (*bhe) {
+				file_copy_out(iov, offset+(*bhe)->b_data, chars);
+				brelse(*bhe);
+			} else
+				file_copy_out(iov, NULL, chars);
+			offset = 0;
+			if (++bhe == &buflist[NBUF])
+				bhe = buflist;
+		} while (left > 0 && bhe != bhb && (!*bhe || !(*bhe)->b_lock));
+	} while (left > 0);
+
+	/* Release the blocks we didn't get to */
+	while (bhe != bhb) {
+		brelse(*bhe);
+		if (++bhe == &buflist[NBUF])
+			bhe = buflist;
+	}
+	if (!read)
+		return -EIO;
+	filp->f_reada = 1;
+	if (!IS_RDONLY(inode)) {
+		inode->i_atime = CURRENT_TIME;
+		inode->i_dirt = 1;
+	}
+	return read;
+}
+
+int generic_file_read(struct inode * inode, struct file * filp, char * buf, int count)
+{
+	struct iovec iov;
+
+	iov.iov_base = buf;
+	iov.iov_len = count;
+	return file_read_iov(inode, filp, &iov, count);
+}
+
+int generic_file_readv(struct inode * inode, struct file * filp,
+	struct iovec * iov, int nr)
+{
+	int count = 0;
+	int i;
+
+	for (i = 0 ; i < nr ; i++)
+		count += iov[i].iov_len;
+	return file_read_iov(inode, filp, iov, count);
+}
@@ -92,7 +92,7 @@ unsigned long high_memory = 0;
  */
 int nr_swap_pages = 0;
 int nr_free_pages = 0;
-struct mem_list free_area_list[NR_MEM_LISTS];
+struct mem_zone mem_zones[NR_ZONES];
 unsigned char * free_area_map[NR_MEM_LISTS];
 
 #define copy_page(from,to) memcpy((void *) to, (void *) from, PAGE_SIZE)
@@ -100,6 +100,8 @@ unsigned char * free_area_map[NR_MEM_LISTS];
 #define USER_PTRS_PER_PGD (TASK_SIZE / PGDIR_SIZE)
 
 mem_map_t * mem_map = NULL;
+unsigned char * mem_age = NULL;
+unsigned long * mem_rmap = NULL;
 
 /*
  * oom() prints a message (so that the user knows why the process died),
@@ -298,7 +300,19 @@ static inline void copy_one_pte(pte_t * old_pte, pte_t * new_pte)
 	mem_map[MAP_NR(pte_page(pte))]++;
 }
 
-static inline int copy_one_pmd(pmd_t * old_pmd, pmd_t * new_pmd)
+/*
+ * Write-protect a pte of a page table that is about to be shared, so that
+ * the first write through it will come to do_wp_page() and unshare_pte().
+ */
+static inline void share_one_pte(pte_t * ptep)
+{
+	pte_t pte = *ptep;
+
+	if (pte_present(pte) && pte_cow(pte))
+		*ptep = pte_wrprotect(pte);
+}
+
+static inline int copy_one_pmd(pmd_t * old_pmd, pmd_t * new_pmd, int share)
 {
 	int j;
 	pte_t *old_pte, *new_pte;
@@ -317,6 +331,18 @@ static inline int copy_one_pmd(pmd_t * old_pmd, pmd_t * new_pmd)
 		*new_pmd = *old_pmd;
 		return 0;
 	}
+	/*
+	 * The table maps one big private area: don't copy it now, just
+	 * share it read-only. The pages stay referenced once, by the
+	 * table, and whoever first changes a pte gets a copy of their own.
+	 */
+	if (share) {
+		for (j = 0 ; j < PTRS_PER_PTE ; j++)
+			share_one_pte(old_pte + j);
+		pte_reuse(old_pte);
+		*new_pmd = *old_pmd;
+		return 0;
+	}
 	//否则，申请一页新的页面，并将pmd所指向的三级页表中的页表项一项一项的复制到new_pte页面中来，why？
 	new_pte = pte_alloc(new_pmd, 0);	//pte_alloc和pte_alloc_kernel的区别是，后者申请的页面带有共享标志
 	if (!new_pte)
@@ -329,7 +355,7 @@ static inline int copy_one_pmd(pmd_t * old_pmd, pmd_t * new_pmd)
 	return 0;
 }
 
-static inline int copy_one_pgd(pgd_t * old_pgd, pgd_t * new_pgd)
+static inline int copy_one_pgd(pgd_t * old_pgd, pgd_t * new_pgd, int share)
 {
 	int j;
 	pmd_t *old_pmd, *new_pmd;
@@ -351,7 +377,7 @@ static inline int copy_one_pgd(pgd_t * old_pgd, pgd_t * new_pgd)
 	if (!new_pmd)
 		return -ENOMEM;
 	for (j = 0 ; j < PTRS_PER_PMD ; j++) {
-		int error = copy_one_pmd(old_pmd, new_pmd);
+		int error = copy_one_pmd(old_pmd, new_pmd, share);
 		if (error)
 			return error;
 		old_pmd++;
@@ -360,10 +386,31 @@ static inline int copy_one_pgd(pgd_t * old_pgd, pgd_t * new_pgd)
 	return 0;
 }
 
+/*
+ * Can the page tables under 'address' be shared at fork time instead of
+ * copied?  Only if they lie entirely inside one private mapping: nothing
+ * else will then go through them without a fault first.
+ */
+static int share_page_tables(unsigned long address)
+{
+	struct vm_area_struct * vma;
+
+	if (address >= TASK_SIZE)
+		return 0;
+	vma = find_vma(current, address);
+	if (!vma || vma->vm_start > address)
+		return 0;
+	if (vma->vm_end - address < PGDIR_SIZE)
+		return 0;
+	return !(vma->vm_flags & VM_SHARED);
+}
+
 /*
  * copy_page_tables() just copies the whole process memory range:
  * note the special handling of RESERVED (	ie kernel) pages, which
- * means that they are always shared by all processes.
+ * means that they are always shared by all processes. Page tables
+ * that cover a single large private area are shared rather than
+ * copied, see unshare_pte().
  */
 int copy_page_tables(struct task_struct * tsk)
 {
@@ -378,7 +425,8 @@ int copy_page_tables(struct task_struct * tsk)
 	old_pgd = pgd_offset(current, 0);
 	//页目录表页面可能常驻内存
 	for (i = 0 ; i < PTRS_PER_PGD ; i++) {
-		int errno = copy_one_pgd(old_pgd, new_pgd);
+		int errno = copy_one_pgd(old_pgd, new_pgd,
+			share_page_tables(i * PGDIR_SIZE));
 		if (errno) {
 			free_page_tables(tsk);
 			invalidate();
@@ -391,6 +439,39 @@ int copy_page_tables(struct task_struct * tsk)
 	return 0;
 }
 
+/*
+ * Give the task its own copy of a page table that fork() left shared,
+ * before changing any pte in it. Returns the pte for 'address' in the
+ * now private table, or NULL if we're out of memory.
+ */
+pte_t * unshare_pte(pmd_t * pmd, unsigned long address)
+{
+	pte_t * old_pte, * new_pte;
+	unsigned long page;
+	int j;
+
+	address = (address >> PAGE_SHIFT) & (PTRS_PER_PTE - 1);
+	old_pte = (pte_t *) pmd_page(*pmd);
+	if (!pte_inuse(old_pte))
+		return old_pte + address;
+	page = get_free_page(GFP_KERNEL);
+	/* we may have slept: the other user may have let go of it by now */
+	if ((pte_t *) pmd_page(*pmd) != old_pte || !pte_inuse(old_pte)) {
+		if (page)
+			free_page(page);
+		return (pte_t *) pmd_page(*pmd) + address;
+	}
+	if (!page)
+		return NULL;
+	new_pte = (pte_t *) page;
+	for (j = 0 ; j < PTRS_PER_PTE ; j++)
+		copy_one_pte(old_pte + j, new_pte + j);
+	pmd_val(*pmd) = _PAGE_TABLE | page;
+	pte_free(old_pte);
+	invalidate();
+	return new_pte + address;
+}
+
 static inline void forget_pte(pte_t page)
 {
 	if (pte_none(page))
@@ -421,6 +502,19 @@ static inline void unmap_pte_range(pmd_t * pmd, unsigned long address, unsigned
 	}
 	pte = pte_offset(pmd, address);
 	address &= ~PMD_MASK;
+	if (pte_inuse(pte)) {
+		/* all of a shared table goes: just drop our reference to it */
+		if (!address && size >= PMD_SIZE) {
+			pte_free(pte);
+			pmd_clear(pmd);
+			return;
+		}
+		pte = unshare_pte(pmd, address);
+		if (!pte) {
+			oom(current);
+			return;
+		}
+	}
 	end = address + size;
 	if (end >= PMD_SIZE)
 		end = PMD_SIZE;
@@ -465,14 +559,17 @@ int unmap_page_range(unsigned long address, unsigned long size)
 {
 	pgd_t * dir;
 	unsigned long end = address + size;
+	struct tlb_batch tb;
 
+	tlb_batch_init(&tb);
+	tlb_note_range(&tb, address, end);
 	dir = pgd_offset(current, address);
 	while (address < end) {
 		unmap_pmd_range(dir, address, end - address);
 		address = (address + PGDIR_SIZE) & PGDIR_MASK;
 		dir++;
 	}
-	invalidate();
+	tlb_flush(&tb);
 	return 0;
 }
 
@@ -503,6 +600,8 @@ static inline int zeromap_pmd_range(pmd_t * pmd, unsigned long address, unsigned
 		end = PGDIR_SIZE;
 	do {
 		pte_t * pte = pte_alloc(pmd, address);
+		if (pte)
+			pte = unshare_pte(pmd, address);
 		if (!pte)
 			return -ENOMEM;
 		zeromap_pte_range(pte, address, end - address, zero_pte);
@@ -523,7 +622,10 @@ int zeromap_page_range(unsigned long address, unsigned long size, pgprot_t prot)
 	pgd_t * dir;
 	unsigned long end = address + size;
 	pte_t zero_pte;
+	struct tlb_batch tb;
 
+	tlb_batch_init(&tb);
+	tlb_note_range(&tb, address, end);
 	zero_pte = pte_wrprotect(mk_pte(ZERO_PAGE, prot));
 	dir = pgd_offset(current, address);
 	while (address < end) {
@@ -537,7 +639,7 @@ int zeromap_page_range(unsigned long address, unsigned long size, pgprot_t prot)
 		address = (address + PGDIR_SIZE) & PGDIR_MASK;
 		dir++;
 	}
-	invalidate();
+	tlb_flush(&tb);
 	return error;
 }
 
@@ -583,6 +685,8 @@ static inline int remap_pmd_range(pmd_t * pmd, unsigned long address, unsigned l
 	offset -= address;
 	do {
 		pte_t * pte = pte_alloc(pmd, address);
+		if (pte)
+			pte = unshare_pte(pmd, address);
 		if (!pte)
 			return -ENOMEM;
 		remap_pte_range(pte, address, end - address, address + offset, prot);
@@ -597,7 +701,10 @@ int remap_page_range(unsigned long from, unsigned long offset, unsigned long siz
 	int error = 0;
 	pgd_t * dir;
 	unsigned long end = from + size;
+	struct tlb_batch tb;
 
+	tlb_batch_init(&tb);
+	tlb_note_range(&tb, from, end);
 	offset -= from;
 	dir = pgd_offset(current, from);
 	while (from < end) {
@@ -611,7 +718,7 @@ int remap_page_range(unsigned long from, unsigned long offset, unsigned long siz
 		from = (from + PGDIR_SIZE) & PGDIR_MASK;
 		dir++;
 	}
-	invalidate();
+	tlb_flush(&tb);
 	return error;
 }
 
@@ -662,6 +769,7 @@ unsigned long put_dirty_page(struct task_struct * tsk, unsigned long page, unsig
 		invalidate();
 	}
 	*pte = pte_mkwrite(pte_mkdirty(mk_pte(page, PAGE_COPY)));
+	set_page_owner(page, tsk, address);
 /* no need for invalidate */
 	return page;
 }
@@ -702,7 +810,11 @@ void do_wp_page(struct vm_area_struct * vma, unsigned long address,
 		goto end_wp_page;
 	if (pmd_bad(*page_middle))
 		goto bad_wp_pagemiddle;
-	page_table = pte_offset(page_middle, address);
+	page_table = unshare_pte(page_middle, address);
+	if (!page_table) {
+		oom(vma->vm_task);
+		goto end_wp_page;
+	}
 	pte = *page_table;
 	if (!pte_present(pte))
 		goto end_wp_page;
@@ -721,20 +833,21 @@ void do_wp_page(struct vm_area_struct * vma, unsigned long address,
 				++vma->vm_task->mm->rss;
 			copy_page(old_page,new_page);
 			*page_table = pte_mkwrite(pte_mkdirty(mk_pte(new_page, vma->vm_page_prot)));
+			set_page_owner(new_page, vma->vm_task, address);
 			free_page(old_page);	//decrementing the shared-page counter for the old page?
-			invalidate();
+			invalidate_page(address);
 			return;
 		}
 		*page_table = BAD_PAGE;
 		free_page(old_page);
 		oom(vma->vm_task);
-		invalidate();
+		invalidate_page(address);
 		return;
 	}
 	//说明mem_map[MAP_NR(old_page)] == 1，此页面为次进程所独享，把此页面改为可写，被修改过的，why？
 	/*之所以将其设置为脏的，是为了之后将其交换缓冲删除，而且执行到这里肯定是对页面进行了写操作*/
 	*page_table = pte_mkdirty(pte_mkwrite(pte));
-	invalidate();
+	invalidate_page(address);
 	if (new_page)
 		free_page(new_page);
 	return;
@@ -840,7 +953,8 @@ bad_area:
 }
 
 //申请一页新的页面并映射到page_table处
-static inline void get_empty_page(struct vm_area_struct * vma, pte_t * page_table)
+static inline void get_empty_page(struct vm_area_struct * vma, pte_t * page_table,
+	unsigned long address)
 {
 	unsigned long tmp;
 
@@ -850,6 +964,7 @@ static inline void get_empty_page(struct vm_area_struct * vma, pte_t * page_tabl
 		return;
 	}
 	put_page(page_table, pte_mkwrite(mk_pte(tmp, vma->vm_page_prot)));
+	set_page_owner(tmp, vma->vm_task, address);
 }
 
 /*
@@ -1042,6 +1157,8 @@ static inline pte_t * get_empty_pgtable(struct task_struct * tsk,unsigned long a
 		return NULL;
 	}
 	pte = pte_alloc(pmd, address);
+	if (pte)
+		pte = unshare_pte(pmd, address);
 	if (!pte) {
 		oom(tsk);
 		return NULL;
@@ -1056,6 +1173,8 @@ static inline void do_swap_page(struct vm_area_struct * vma, unsigned long addre
 
 	if (!vma->vm_ops || !vma->vm_ops->swapin) {
 		swap_in(vma, page_table, pte_val(entry), write_access);
+		if (pte_present(*page_table))
+			set_page_owner(pte_page(*page_table), vma->vm_task, address);
 		return;
 	}
 	page = vma->vm_ops->swapin(vma, address - vma->vm_start + vma->vm_offset, pte_val(entry));
@@ -1068,6 +1187,7 @@ static inline void do_swap_page(struct vm_area_struct * vma, unsigned long addre
 	++vma->vm_task->mm->rss;
 	++vma->vm_task->mm->maj_flt;
 	*page_table = page;
+	set_page_owner(pte_page(page), vma->vm_task, address);
 	return;
 }
 
@@ -1104,7 +1224,7 @@ void do_no_page(struct vm_area_struct * vma, unsigned long address,
 	if (!vma->vm_ops || !vma->vm_ops->nopage) {
 		++vma->vm_task->mm->rss;
 		++vma->vm_task->mm->min_flt;
-		get_empty_page(vma, page_table);
+		get_empty_page(vma, page_table, address);
 		return;
 	}
 	page = get_free_page(GFP_KERNEL);
@@ -1147,6 +1267,7 @@ void do_no_page(struct vm_area_struct * vma, unsigned long address,
 	} else if (mem_map[MAP_NR(page)] > 1 && !(vma->vm_flags & VM_SHARED))
 		entry = pte_wrprotect(entry);
 	put_page(page_table, entry);
+	set_page_owner(page, vma->vm_task, address);
 }
 
 /*
@@ -1199,3 +1320,51 @@ void handle_mm_fault(struct vm_area_struct * vma, unsigned long address,
 no_memory:
 	oom(vma->vm_task);
 }
+
+/*
+ * Find the page behind 'address' in another task's address space,
+ * faulting it in (and breaking COW if 'write_access' is set), and pin it
+ * with an extra mem_map reference so that it can be copied to or from
+ * even if we sleep.  A written page is marked dirty up front: dirty
+ * pages with more than one user are never swapped out.  Returns the
+ * kernel address of the page, or 0; release it with free_page().
+ */
+unsigned long get_user_page(struct task_struct * tsk, unsigned long address,
+	int write_access)
+{
+	struct vm_area_struct * vma;
+	pgd_t *pgd;
+	pmd_t *pmd;
+	pte_t *pte;
+	unsigned long page;
+	int tries = 3;
+
+	vma = find_vma(tsk, address);
+	if (!vma || vma->vm_start > address)
+		return 0;
+	if (!(vma->vm_flags & (write_access ? VM_WRITE : VM_READ)))
+		return 0;
+	while (tries--) {
+		pgd = pgd_offset(tsk, address);
+		if (pgd_none(*pgd) || pgd_bad(*pgd))
+			goto fault;
+		pmd = pmd_offset(pgd, address);
+		if (pmd_none(*pmd) || pmd_bad(*pmd))
+			goto fault;
+		pte = pte_offset(pmd, address);
+		if (!pte_present(*pte))
+			goto fault;
+		if (write_access && !pte_write(*pte))
+			goto fault;
+		page = pte_page(*pte);
+		if (page >= high_memory || (mem_map[MAP_NR(page)] & MAP_PAGE_RESERVED))
+			return 0;
+		if (write_access)
+			*pte = pte_mkdirty(*pte);
+		mem_map[MAP_NR(page)]++;
+		return page;
+fault:
+		handle_mm_fault(vma, address, write_access);
+	}
+	return 0;
+}
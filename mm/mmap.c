@@ -265,7 +265,7 @@ asmlinkage int sys_mmap(unsigned long *buffer)
 	flags = get_fs_long(buffer+3);
 	if (!(flags & MAP_ANONYMOUS)) {
 		unsigned long fd = get_fs_long(buffer+4);
-		if (fd >= NR_OPEN || !(file = current->files->fd[fd]))
+		if (fd >= current->files->max_fds || !(file = current->files->fd[fd]))
 			return -EBADF;
 	}
 	return do_mmap(file, get_fs_long(buffer), get_fs_long(buffer+1),
@@ -58,7 +58,11 @@ static inline void change_pte_range(pmd_t * pmd, unsigned long address,
 		pmd_clear(pmd);
 		return;
 	}
-	pte = pte_offset(pmd, address);
+	pte = unshare_pte(pmd, address);
+	if (!pte) {
+		oom(current);
+		return;
+	}
 	address &= ~PMD_MASK;
 	end = address + size;
 	if (end > PMD_SIZE)
@@ -102,14 +106,17 @@ static inline void change_pmd_range(pgd_t * pgd, unsigned long address,
 static void change_protection(unsigned long start, unsigned long end, pgprot_t newprot)
 {
 	pgd_t *dir;
+	struct tlb_batch tb;
 
+	tlb_batch_init(&tb);
+	tlb_note_range(&tb, start, end);
 	dir = pgd_offset(current, start);
 	while (start < end) {
 		change_pmd_range(dir, start, end - start, newprot);
 		start = (start + PGDIR_SIZE) & PGDIR_MASK;
 		dir++;
 	}
-	invalidate();
+	tlb_flush(&tb);
 	return;
 }
 
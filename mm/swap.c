@@ -71,6 +71,7 @@
 #include <linux/string.h>
 #include <linux/stat.h>
 #include <linux/fs.h>
+#include <linux/swap.h>
 
 #include <asm/dma.h>
 #include <asm/system.h> /* for cli()/sti() */
@@ -88,7 +89,31 @@
 #define SWP_OFFSET(entry) ((entry) >> 12)
 #define SWP_ENTRY(type,offset) (((type) << 1) | ((offset) << 12))
 
+/*
+ * Swap slots are handed out in runs of SWAP_CLUSTER, so that the pages
+ * one swap_out() pass takes from a process end up next to each other:
+ * they are written back to back and read back in one go.
+ */
+#define SWAP_CLUSTER	8
+
+/*
+ * Slots a compressed swap area gets for each page of its pool, which is
+ * about the best compression we can hope for.
+ */
+#define ZSWAP_SLOTS	4
+
+/*
+ * Free page watermarks.  kswapd is woken when nr_free_pages falls to
+ * free_pages_low and frees pages until it is back up to free_pages_high.
+ * Ordinary allocators only reclaim for themselves below min_free_pages,
+ * and the pages under that are left for GFP_ATOMIC.
+ */
 int min_free_pages = 20;
+int free_pages_low = 40;
+int free_pages_high = 60;
+
+static struct wait_queue * kswapd_wait = NULL;
+static int kswapd_running = 0;
 
 //静态变量(nr_swapfiles)来记录当前活动的交换文件数
 static int nr_swapfiles = 0;
@@ -116,6 +141,9 @@ static struct swap_info_struct {
 	int highest_bit;
 	//表示了设备的最大页面号，也就是设备或者文件的物理大小
 	unsigned long max;	
+	int cluster_next;	/* next slot of the current cluster */
+	int cluster_nr;		/* slots left in it */
+	struct zswap_area * zswap;	/* compressed in memory, see zswap.c */
 } swap_info[MAX_SWAPFILES];	//Linux内核允许多个交换设备，所以在内核中就定义了一个数组来列出各个交换设备
 
 extern int shm_swap (int);
@@ -182,54 +210,17 @@ static unsigned long init_swap_cache(unsigned long mem_start,
 	return (unsigned long) (swap_cache + swap_cache_size);
 }
 
-void rw_swap_page(int rw, unsigned long entry, char * buf)
+/*
+ * Do the actual I/O for one page of a swap device or file.  The caller
+ * has locked the slot in swap_lockmap.
+ */
+static void swap_io(struct swap_info_struct * p, int rw, unsigned long offset,
+	char * buf)
 {
-	unsigned long type, offset;
-	struct swap_info_struct * p;
-
-	//取得entry所指向的交换设备序号
-	type = SWP_TYPE(entry);
-	//如果此序号大于系统所允许的最大值
-	if (type >= nr_swapfiles) {
-		printk("Internal error: bad swap-device\n");
-		return;
-	}
-	//p指向entry所指向的交换设备的swap_info_struct结构
-	p = &swap_info[type];
-	//取得entry所指向的交换设备中的对应的页面号
-	offset = SWP_OFFSET(entry);
-	//如果此页面号大于此交换设备中最大的页面号
-	if (offset >= p->max) {
-		printk("rw_swap_page: weirdness\n");
-		return;
-	}
-	//如果此交换设备的swap_map不为空，但是此交换分配位图中对应的offset页面位为0
-	//表示此页面尚未被分配使用，说明系统出了问题
-	if (p->swap_map && !p->swap_map[offset]) {
-		printk("Hmm.. Trying to use unallocated swap (%08lx)\n", entry);
-		return;
-	}
-	//如果此交换设备没有处于正使用的状态
-	if (!(p->flags & SWP_USED)) {
-		printk("Trying to swap to unused swap-device\n");
-		return;
-	}
-	//尝试锁住此交换页面
-	//setbit()尝试将交换设备的swap_lockmap位图的offset位置位，并返回原来的值
-	//如果原来就是1（即被其他进程锁住了），那就睡眠，直到位图锁被其他进程释放（置零）
-	//然后唤醒本进程，本进程将其置位并返回原值0，则继续向下执行
-	while (set_bit(offset,p->swap_lockmap))
-		sleep_on(&lock_queue);
-	//如果是读交换页面
-	if (rw == READ)
-		//增加内核读交换页面的次数
-		kstat.pswpin++;
-	//否则，是写交换页面
-	else
-		//增加内核写交换页面的次数
-		kstat.pswpout++;
+	if (p->zswap) {
+		zswap_io(p->zswap, rw, offset, buf);
 	//如果交换空间是设备文件
-	if (p->swap_device) {
+	} else if (p->swap_device) {
 		//读写此设备文件
 		ll_rw_page(rw,p->swap_device,offset,buf);
 	//否则，如果交换页在交换文件中
@@ -280,6 +271,55 @@ void rw_swap_page(int rw, unsigned long entry, char * buf)
 		ll_rw_swap_file(rw,swapf->i_dev, zones, i,buf);
 	} else
 		printk("re_swap_page: no swap file or device\n");
+}
+
+void rw_swap_page(int rw, unsigned long entry, char * buf)
+{
+	unsigned long type, offset;
+	struct swap_info_struct * p;
+
+	//取得entry所指向的交换设备序号
+	type = SWP_TYPE(entry);
+	//如果此序号大于系统所允许的最大值
+	if (type >= nr_swapfiles) {
+		printk("Internal error: bad swap-device\n");
+		return;
+	}
+	//p指向entry所指向的交换设备的swap_info_struct结构
+	p = &swap_info[type];
+	//取得entry所指向的交换设备中的对应的页面号
+	offset = SWP_OFFSET(entry);
+	//如果此页面号大于此交换设备中最大的页面号
+	if (offset >= p->max) {
+		printk("rw_swap_page: weirdness\n");
+		return;
+	}
+	//如果此交换设备的swap_map不为空，但是此交换分配位图中对应的offset页面位为0
+	//表示此页面尚未被分配使用，说明系统出了问题
+	if (p->swap_map && !p->swap_map[offset]) {
+		printk("Hmm.. Trying to use unallocated swap (%08lx)\n", entry);
+		return;
+	}
+	//如果此交换设备没有处于正使用的状态
+	if (!(p->flags & SWP_USED)) {
+		printk("Trying to swap to unused swap-device\n");
+		return;
+	}
+	//尝试锁住此交换页面
+	//setbit()尝试将交换设备的swap_lockmap位图的offset位置位，并返回原来的值
+	//如果原来就是1（即被其他进程锁住了），那就睡眠，直到位图锁被其他进程释放（置零）
+	//然后唤醒本进程，本进程将其置位并返回原值0，则继续向下执行
+	while (set_bit(offset,p->swap_lockmap))
+		sleep_on(&lock_queue);
+	//如果是读交换页面
+	if (rw == READ)
+		//增加内核读交换页面的次数
+		kstat.pswpin++;
+	//否则，是写交换页面
+	else
+		//增加内核写交换页面的次数
+		kstat.pswpout++;
+	swap_io(p, rw, offset, buf);
 	//解锁此交换页面
 	if (offset && !clear_bit(offset,p->swap_lockmap))
 		printk("rw_swap_page: lock already cleared\n");
@@ -287,39 +327,98 @@ void rw_swap_page(int rw, unsigned long entry, char * buf)
 	wake_up(&lock_queue);
 }
 
+static inline unsigned int scan_swap_map(struct swap_info_struct * p,
+	unsigned int type)
+{
+	unsigned int offset, run;
+
+	/*
+	 * Carry on with the current cluster if we can ...
+	 */
+	if (p->cluster_nr) {
+		while (p->cluster_next <= p->highest_bit) {
+			offset = p->cluster_next++;
+			if (p->swap_map[offset])
+				continue;
+			if (test_bit(offset, p->swap_lockmap))
+				continue;
+			p->cluster_nr--;
+			goto got_page;
+		}
+	}
+	/*
+	 * ... otherwise start a new one on a run of SWAP_CLUSTER free slots,
+	 * so that its pages really do end up next to each other ...
+	 */
+	p->cluster_nr = 0;
+	run = 0;
+	for (offset = p->lowest_bit; offset <= p->highest_bit ; offset++) {
+		if (p->swap_map[offset] || test_bit(offset, p->swap_lockmap)) {
+			run = 0;
+			continue;
+		}
+		if (++run < SWAP_CLUSTER)
+			continue;
+		offset -= SWAP_CLUSTER - 1;
+		p->cluster_nr = SWAP_CLUSTER - 1;
+		goto got_page;
+	}
+	/*
+	 * ... and fall back to single slots when the area is too fragmented.
+	 */
+	//遍历交换页面位图
+	for (offset = p->lowest_bit; offset <= p->highest_bit ; offset++) {
+		//如果当前的交换页面位图被置位（被其他进程使用），则continue
+		if (p->swap_map[offset])
+			continue;
+		//如果当前交换页面处于锁定状态
+		if (test_bit(offset, p->swap_lockmap))
+			continue;
+		p->lowest_bit = offset;
+got_page:
+		//将此交换页面位图置位
+		p->swap_map[offset] = 1;
+		//减少系统中的可用交换页面数
+		nr_swap_pages--;
+		if (offset == p->highest_bit)
+			p->highest_bit--;
+		p->cluster_next = offset + 1;
+		//返回此交换页面的entry
+		return SWP_ENTRY(type,offset);
+	}
+	return 0;
+}
+
 //内存中的一页被换出时，调用get_swap_page()会得到一个记录换出位置的索引，然后在页表项中回填（1--31位）此索引。
 //这是为了在发生缺页异常时进行处理（do_no_page)。索引的高7位给定交换文件，后24位给定设备中的页插槽号。
+/*
+ * Compressed areas are used first, for as long as their pool has room;
+ * after that the pages go to the swap devices and files.
+ */
 unsigned int get_swap_page(void)
 {
 	struct swap_info_struct * p;
-	unsigned int offset, type;
+	unsigned int entry, type;
 
+	p = swap_info;
+	for (type = 0 ; type < nr_swapfiles ; type++,p++) {
+		if ((p->flags & SWP_WRITEOK) != SWP_WRITEOK)
+			continue;
+		if (!p->zswap || zswap_full(p->zswap))
+			continue;
+		if ((entry = scan_swap_map(p, type)) != 0)
+			return entry;
+	}
 	p = swap_info;
 	//遍历swap_info数组，试图找到一个可以使用的交换设备/文件
 	for (type = 0 ; type < nr_swapfiles ; type++,p++) {
 		//如果当前交换设备/文件没有处于准备就绪状态，则继续遍历下一项
 		if ((p->flags & SWP_WRITEOK) != SWP_WRITEOK)
 			continue;
-		//执行到这里，说明当前交换设备/文件处于就绪状态，则需找其中可以使用的一个交换页面
-		
-		//遍历交换页面位图
-		for (offset = p->lowest_bit; offset <= p->highest_bit ; offset++) {
-			//如果当前的交换页面位图被置位（被其他进程使用），则continue
-			if (p->swap_map[offset])
-				continue;
-			//如果当前交换页面处于锁定状态
-			if (test_bit(offset, p->swap_lockmap))
-				continue;
-			//将此交换页面位图置位
-			p->swap_map[offset] = 1;
-			//减少系统中的可用交换页面数
-			nr_swap_pages--;
-			if (offset == p->highest_bit)
-				p->highest_bit--;
-			p->lowest_bit = offset;
-			//返回此交换页面的entry
-			return SWP_ENTRY(type,offset);
-		}
+		if (p->zswap)
+			continue;
+		if ((entry = scan_swap_map(p, type)) != 0)
+			return entry;
 	}
 	return 0;
 }
@@ -387,8 +486,249 @@ void swap_free(unsigned long entry)
 	if (!p->swap_map[offset])
 		printk("swap_free: swap-space map bad (entry %08lx)\n",entry);
 	else
-		if (!--p->swap_map[offset])
+		if (!--p->swap_map[offset]) {
 			nr_swap_pages++;
+			if (p->zswap)
+				zswap_drop(p->zswap, offset);
+		}
+}
+
+/*
+ * Dirty pages swap_out() has given slots to but not yet written.  Their
+ * slots are locked as soon as they are queued, so anybody faulting on one
+ * waits in the usual way until the write is done.
+ */
+static struct swap_batch {
+	unsigned long entry;
+	unsigned long page;
+} swap_batch[SWAP_CLUSTER];
+static int swap_batch_nr = 0;
+
+static void swap_batch_add(unsigned long entry, unsigned long page)
+{
+	set_bit(SWP_OFFSET(entry), swap_info[SWP_TYPE(entry)].swap_lockmap);
+	swap_batch[swap_batch_nr].entry = entry;
+	swap_batch[swap_batch_nr].page = page;
+	swap_batch_nr++;
+}
+
+/*
+ * Write the batch out, one back-to-back run of requests for each stretch
+ * of adjacent slots on a swap device, then unlock the slots and free the
+ * pages.  We work on a private copy: we sleep here, and another swap_out()
+ * may start a new batch meanwhile.
+ */
+static void swap_batch_flush(void)
+{
+	struct swap_batch batch[SWAP_CLUSTER];
+	char * bufs[SWAP_CLUSTER];
+	struct swap_info_struct * p;
+	unsigned long offset;
+	int nr, i, j, k;
+
+	nr = swap_batch_nr;
+	memcpy(batch, swap_batch, nr * sizeof(struct swap_batch));
+	swap_batch_nr = 0;
+
+	for (i = 1; i < nr; i++) {
+		struct swap_batch tmp = batch[i];
+		for (j = i; j > 0 && batch[j-1].entry > tmp.entry; j--)
+			batch[j] = batch[j-1];
+		batch[j] = tmp;
+	}
+
+	for (i = 0; i < nr; i = j) {
+		p = swap_info + SWP_TYPE(batch[i].entry);
+		offset = SWP_OFFSET(batch[i].entry);
+		bufs[0] = (char *) batch[i].page;
+		for (j = i + 1; j < nr; j++) {
+			if (SWP_TYPE(batch[j].entry) != SWP_TYPE(batch[i].entry))
+				break;
+			if (SWP_OFFSET(batch[j].entry) != offset + j - i)
+				break;
+			bufs[j - i] = (char *) batch[j].page;
+		}
+		kstat.pswpout += j - i;
+		if (p->swap_device)
+			ll_rw_pages(WRITE, p->swap_device, offset, bufs, j - i);
+		else
+			for (k = 0; k < j - i; k++)
+				swap_io(p, WRITE, offset + k, bufs[k]);
+		for (k = i; k < j; k++) {
+			if (!clear_bit(SWP_OFFSET(batch[k].entry), p->swap_lockmap))
+				printk("swap_batch_flush: lock already cleared\n");
+			free_page(batch[k].page);
+		}
+		wake_up(&lock_queue);
+	}
+}
+
+/*
+ * Swap-in readahead.  A fault on a swap device reads the aligned cluster
+ * of slots around the one it wants.  The extra pages are parked here, each
+ * holding a reference on its slot so that it can't be reused, until a
+ * fault on that entry picks the page up or newer ones push it out.
+ */
+#define SWAP_RA_SIZE	32
+
+static struct swap_ra {
+	unsigned long entry;
+	unsigned long page;
+} swap_ra[SWAP_RA_SIZE];
+static int swap_ra_next = 0;
+
+static unsigned long swap_ra_find(unsigned long entry)
+{
+	unsigned long page;
+	int i;
+
+	for (i = 0 ; i < SWAP_RA_SIZE ; i++) {
+		if (swap_ra[i].entry != entry)
+			continue;
+		page = swap_ra[i].page;
+		swap_ra[i].entry = 0;
+		swap_ra[i].page = 0;
+		swap_free(entry);
+		return page;
+	}
+	return 0;
+}
+
+static void swap_ra_drop(int i)
+{
+	unsigned long entry = swap_ra[i].entry;
+	unsigned long page = swap_ra[i].page;
+
+	if (!entry)
+		return;
+	swap_ra[i].entry = 0;
+	swap_ra[i].page = 0;
+	free_page(page);
+	swap_free(entry);
+}
+
+static void swap_ra_insert(unsigned long entry, unsigned long page)
+{
+	int i = swap_ra_next;
+
+	swap_ra_next = (i + 1) % SWAP_RA_SIZE;
+	swap_ra_drop(i);
+	swap_ra[i].entry = entry;
+	swap_ra[i].page = page;
+}
+
+/*
+ * Read-ahead pages are the first thing to go when memory is short.
+ */
+static int swap_ra_shrink(void)
+{
+	int i;
+
+	for (i = 0 ; i < SWAP_RA_SIZE ; i++) {
+		if (swap_ra[i].entry) {
+			swap_ra_drop(i);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/*
+ * Forget everything read ahead from one swap area (for swapoff).
+ */
+static void swap_ra_flush(unsigned int type)
+{
+	int i;
+
+	for (i = 0 ; i < SWAP_RA_SIZE ; i++)
+		if (swap_ra[i].entry && SWP_TYPE(swap_ra[i].entry) == type)
+			swap_ra_drop(i);
+}
+
+static inline int swap_ra_wanted(struct swap_info_struct * p, unsigned int type,
+	unsigned long offset)
+{
+	int i;
+
+	if (!offset || offset >= p->max)
+		return 0;
+	if (!p->swap_map[offset] || p->swap_map[offset] == 0x80)
+		return 0;
+	if (test_bit(offset, p->swap_lockmap))
+		return 0;
+	for (i = 0 ; i < SWAP_RA_SIZE ; i++)
+		if (swap_ra[i].entry == SWP_ENTRY(type,offset))
+			return 0;
+	return 1;
+}
+
+/*
+ * Read the page for 'entry' into 'page', along with as many of its
+ * neighbours in the same cluster as form one run with it.  Swap files,
+ * and any time free memory is already low, get a plain single-page read.
+ */
+static void read_swap_cluster(unsigned long entry, unsigned long page)
+{
+	struct swap_info_struct * p;
+	unsigned int type = SWP_TYPE(entry);
+	unsigned long offset = SWP_OFFSET(entry);
+	unsigned long start;
+	unsigned long pages[SWAP_CLUSTER];
+	char * bufs[SWAP_CLUSTER];
+	int i, first, last;
+
+	p = swap_info + type;
+	if (type >= nr_swapfiles || !(p->flags & SWP_USED) || !p->swap_device ||
+	    offset >= p->max || !p->swap_map[offset] ||
+	    nr_free_pages <= free_pages_low) {
+		read_swap_page(entry, (char *) page);
+		return;
+	}
+
+	/*
+	 * Get the pages first: that may sleep, the rest must not until
+	 * the slots are locked.
+	 */
+	start = offset & ~(SWAP_CLUSTER-1);
+	for (i = 0 ; i < SWAP_CLUSTER ; i++) {
+		if (start + i == offset)
+			pages[i] = page;
+		else
+			pages[i] = __get_free_page(GFP_BUFFER);
+	}
+	while (set_bit(offset,p->swap_lockmap))
+		sleep_on(&lock_queue);
+
+	first = last = offset - start;
+	while (first > 0 && pages[first-1] &&
+	       swap_ra_wanted(p, type, start + first - 1))
+		first--;
+	while (last < SWAP_CLUSTER-1 && pages[last+1] &&
+	       swap_ra_wanted(p, type, start + last + 1))
+		last++;
+	for (i = first ; i <= last ; i++) {
+		bufs[i - first] = (char *) pages[i];
+		if (start + i == offset)
+			continue;
+		set_bit(start + i, p->swap_lockmap);
+		swap_duplicate(SWP_ENTRY(type, start + i));
+	}
+
+	kstat.pswpin += last - first + 1;
+	ll_rw_pages(READ, p->swap_device, start + first, bufs, last - first + 1);
+
+	for (i = first ; i <= last ; i++)
+		clear_bit(start + i, p->swap_lockmap);
+	wake_up(&lock_queue);
+
+	for (i = 0 ; i < SWAP_CLUSTER ; i++) {
+		if (start + i == offset || !pages[i])
+			continue;
+		if (i >= first && i <= last)
+			swap_ra_insert(SWP_ENTRY(type, start + i), pages[i]);
+		else
+			free_page(pages[i]);
+	}
 }
 
 /*
@@ -401,8 +741,22 @@ void swap_free(unsigned long entry)
 void swap_in(struct vm_area_struct * vma, pte_t * page_table,
 	unsigned long entry, int write_access)
 {
+	unsigned long page;
+
+	/*
+	 * A fault on a neighbouring slot may have read it already.
+	 */
+	if ((page = swap_ra_find(entry)) != 0) {
+		if (pte_val(*page_table) != entry) {
+			free_page(page);
+			return;
+		}
+		vma->vm_task->mm->rss++;
+		vma->vm_task->mm->min_flt++;
+		goto got_page;
+	}
 	//申请一页空闲物理内存
-	unsigned long page = get_free_page(GFP_KERNEL);
+	page = get_free_page(GFP_KERNEL);
 	//在get_free_page期间，进程可能睡眠，在睡眠期间可能由其它一些原因已经将页面交换回来了
 	if (pte_val(*page_table) != entry) {
 		free_page(page);
@@ -417,7 +771,7 @@ void swap_in(struct vm_area_struct * vma, pte_t * page_table,
 		return;
 	}
 	//将交换页面中的内容读入page物理页面中
-	read_swap_page(entry, (char *) page);
+	read_swap_cluster(entry, page);
 	//read_swap_page同样可能导致睡眠...
 	if (pte_val(*page_table) != entry) {
 		free_page(page);
@@ -425,6 +779,7 @@ void swap_in(struct vm_area_struct * vma, pte_t * page_table,
 	}
 	vma->vm_task->mm->rss++;
 	vma->vm_task->mm->maj_flt++;
+got_page:
 	//如果page_in操作不是由写操作引起的，则说明此操作暂时不会修改物理页面内容，
 	//之前保存在交换文件中的页面内容将和物理页面中的内容保持一致
 	//则将指向交换文件页面的指针保存在交换缓冲中，这样的话，在之后如果要将此页
@@ -468,6 +823,26 @@ void swap_in(struct vm_area_struct * vma, pte_t * page_table,
  */
  //当本函数返回0时，其上一层程序就会跳过这个页面，而尝试着换出同一个页面表中映射的下一个页面
  //如果一个页面表已经穷尽，就再往上退一层尝试下一个页面表
+/*
+ * Page aging: a page that was referenced since the last look gains
+ * PAGE_AGE_ADV (up to PAGE_AGE_MAX), one that wasn't loses half of its
+ * age.  A page needs a few scans without a reference before it goes.
+ */
+static inline void touch_page(unsigned long page)
+{
+	unsigned char * age = mem_age + MAP_NR(page);
+
+	if (*age < PAGE_AGE_MAX - PAGE_AGE_ADV)
+		*age += PAGE_AGE_ADV;
+	else
+		*age = PAGE_AGE_MAX;
+}
+
+static inline void age_page(unsigned long page)
+{
+	mem_age[MAP_NR(page)] >>= 1;
+}
+
 static inline int try_to_swap_out(struct vm_area_struct* vma, unsigned long address, pte_t * page_table)
 {
 	pte_t pte;
@@ -489,12 +864,18 @@ static inline int try_to_swap_out(struct vm_area_struct* vma, unsigned long addr
 	//若删除成功或者页面是年轻的（最近被访问过），则将此页面设置为未访问过的
 	//那么下次就可能将其交换出去（体现了LRU思想）
 	//若删除失败...
-	if ((pte_dirty(pte) && delete_from_swap_cache(page)) || pte_young(pte))  {
+	if (pte_young(pte)) {
 		//将页面属性设置为old，表明此次不将其交换出去，但下一次就可能将其交换出去
 		*page_table = pte_mkold(pte);
+		touch_page(page);
 		//返回0，注意，这里并没有成功的交换出此页面
 		return 0;
 	}
+	age_page(page);
+	if (mem_age[MAP_NR(page)])
+		return 0;
+	if (pte_dirty(pte) && delete_from_swap_cache(page))
+		return 0;
 	//程序执行到此处，说明如果页面是脏的，页面没有在交换缓冲区中，则将页面换出到交换区中去
 	//为的是保持盘上内容和物理内存页面内容的一致性
 	if (pte_dirty(pte)) {
@@ -512,8 +893,18 @@ static inline int try_to_swap_out(struct vm_area_struct* vma, unsigned long addr
 				return 0;
 			vma->vm_task->mm->rss--;
 			pte_val(*page_table) = entry;
-			invalidate();
-			write_swap_page(entry, (char *) page);
+			invalidate_page(address);
+			/*
+			 * Queue the write and keep scanning, so that the
+			 * neighbours get the neighbouring slots; the batch
+			 * is written when it is full or swap_out() is done
+			 * with this process.
+			 */
+			swap_batch_add(entry, page);
+			if (swap_batch_nr < SWAP_CLUSTER)
+				return 0;
+			swap_batch_flush();
+			return 1;	/* we slept: the process may not exist any more */
 		}
 		free_page(page);	//释放物理内存页面（swap_out的真正目的），说明已经将其换到交换文件中去了
 		return 1;	/* we slept: the process may not exist any more */
@@ -531,13 +922,13 @@ static inline int try_to_swap_out(struct vm_area_struct* vma, unsigned long addr
 		}
 		vma->vm_task->mm->rss--;
 		pte_val(*page_table) = entry;
-		invalidate();
+		invalidate_page(address);
 		free_page(page);
 		return 1;
 	} 
 	vma->vm_task->mm->rss--;
 	pte_clear(page_table);
-	invalidate();
+	invalidate_page(address);
 	entry = mem_map[MAP_NR(page)];
 	free_page(page);
 	return entry;
@@ -681,15 +1072,93 @@ static int swap_out_process(struct task_struct * p)
 	return 0;
 }
 
+/*
+ * The page-aging clock.  Walking one process after another ages the pages
+ * of a small process as often as those of a big one, and evicts from
+ * whichever process is next rather than the coldest pages in the system.
+ * So first sweep mem_map[] itself, and reach the pte of each private page
+ * through its owner hint: every page is aged at the same rate, and the
+ * first ones found cold are the ones that go.  Shared pages and pages with
+ * no usable hint are left to the per-process scan.
+ */
+static unsigned long age_hand = 0;
+
+static pte_t * owner_pte(unsigned long nr, struct vm_area_struct ** vmap)
+{
+	unsigned long owner = mem_rmap[nr];
+	unsigned long address = owner & PAGE_MASK;
+	struct task_struct * p;
+	struct vm_area_struct * vma;
+	pgd_t * pgd;
+	pmd_t * pmd;
+	pte_t * pte;
+
+	if (!owner)
+		return NULL;
+	p = task[owner & ~PAGE_MASK];
+	if (!p || !p->mm->swappable)
+		goto stale;
+	vma = find_vma(p, address);
+	if (!vma || address < vma->vm_start)
+		goto stale;
+	pgd = pgd_offset(p, address);
+	if (pgd_none(*pgd) || pgd_bad(*pgd))
+		goto stale;
+	pmd = pmd_offset(pgd, address);
+	if (pmd_none(*pmd) || pmd_bad(*pmd))
+		goto stale;
+	pte = pte_offset(pmd, address);
+	if (!pte_present(*pte) || MAP_NR(pte_page(*pte)) != nr)
+		goto stale;
+	*vmap = vma;
+	return pte;
+stale:
+	mem_rmap[nr] = 0;
+	return NULL;
+}
+
+static int age_scan(unsigned int priority)
+{
+	unsigned long limit = MAP_NR(high_memory);
+	unsigned long count = limit >> priority;
+
+	while (count-- > 0) {
+		struct vm_area_struct * vma;
+		unsigned long nr = age_hand;
+		pte_t * pte;
+
+		if (++age_hand >= limit)
+			age_hand = 0;
+		if (mem_map[nr] != 1)
+			continue;
+		pte = owner_pte(nr, &vma);
+		if (!pte)
+			continue;
+		if (try_to_swap_out(vma, mem_rmap[nr] & PAGE_MASK, pte)) {
+			if (swap_batch_nr)
+				swap_batch_flush();
+			return 1;
+		}
+	}
+	if (swap_batch_nr) {
+		swap_batch_flush();
+		return 1;
+	}
+	return 0;
+}
+
 //参见《Linux内核源代码情景分析》第二章第八节的内容 很经典
 //这个函数最然叫'swap_out'，但实际上只是为把一些页面交换到交换设备上做好准备
 //并不一定是物理意义上的页面换出（因为最终函数要调用到try_to_swap_out()函数）
 static int swap_out(unsigned int priority)
 {
 	static int swap_task;
-	int loop, counter;
+	int loop, counter, result;
 	struct task_struct *p;
 
+	if (age_scan(priority))
+		return 1;
+
 /*
 	这个函数的主体是一个for循环，循环的次数取决于counter。这个数值决定了
 	吧页面换出去的决心有多大--即外层for循环的次数。
@@ -765,7 +1234,12 @@ static int swap_out(unsigned int priority)
 		if (!--p->mm->swap_cnt)
 			swap_task++;
 		//试图swap_out进程p的一页物理内存
-		switch (swap_out_process(p)) {
+		result = swap_out_process(p);
+		if (swap_batch_nr) {
+			swap_batch_flush();
+			return 1;
+		}
+		switch (result) {
 			case 0:
 				//如果返回0，表明没有交换出任何一页页面
 				if (p->mm->swap_cnt)
@@ -782,6 +1256,68 @@ static int swap_out(unsigned int priority)
 	return 0;
 }
 
+/*
+ * Pre-zeroed pages.  While memory is plentiful the idle task clears free
+ * pages ahead of time, and get_free_page() takes from here first, so a
+ * fault on fresh anonymous memory or a new page table doesn't have to
+ * clear a page itself.  The pool is linked through the first word of
+ * each page, and is the first thing try_to_free_page() gives back.
+ */
+#define ZERO_POOL_MAX	64
+
+static unsigned long zero_pool = 0;
+static int zero_pool_nr = 0;
+
+unsigned long zero_pool_get(void)
+{
+	unsigned long flags, page;
+
+	save_flags(flags);
+	cli();
+	page = zero_pool;
+	if (page) {
+		zero_pool = *(unsigned long *) page;
+		zero_pool_nr--;
+	}
+	restore_flags(flags);
+	if (page)
+		*(unsigned long *) page = 0;
+	return page;
+}
+
+/*
+ * Called from the idle loop: add one page to the pool if there is room,
+ * and memory to spare.  Returns 0 when there's nothing more to do.
+ */
+int zero_pool_fill(void)
+{
+	unsigned long flags, page;
+
+	if (zero_pool_nr >= ZERO_POOL_MAX || nr_free_pages <= free_pages_high)
+		return 0;
+	page = __get_free_page(GFP_BUFFER);
+	if (!page)
+		return 0;
+	memset((void *) page, 0, PAGE_SIZE);
+	save_flags(flags);
+	cli();
+	*(unsigned long *) page = zero_pool;
+	zero_pool = page;
+	zero_pool_nr++;
+	restore_flags(flags);
+	return 1;
+}
+
+static int zero_pool_shrink(void)
+{
+	unsigned long page = zero_pool_get();
+
+	if (!page)
+		return 0;
+	free_page(page);
+	return 1;
+}
+
 /*
  * we keep on shrinking one resource until it's considered "too hard",
  * and then switch to the next one (priority being an indication on how
@@ -796,11 +1332,17 @@ static int try_to_free_page(int priority)
 	static int state = 0;
 	int i=6;
 
+	if (zero_pool_shrink())
+		return 1;
+	if (swap_ra_shrink())
+		return 1;
 	switch (state) {
 		do {
 		case 0:
 			if (priority != GFP_NOBUFFER && shrink_buffers(i))
 				return 1;
+			if (priority != GFP_ATOMIC && shrink_inodes(i))
+				return 1;
 			state = 1;
 		case 1:
 			if (shm_swap(i))
@@ -815,6 +1357,34 @@ static int try_to_free_page(int priority)
 	return 0;
 }
 
+/*
+ * The reclaim daemon.  init forks a process that calls this and never
+ * returns, much like update does with bdflush.  It sleeps until an
+ * allocation takes the free pool down to free_pages_low, then frees pages
+ * in the background until free_pages_high is reached or nothing more can
+ * be freed, so that foreground allocators rarely have to do it themselves.
+ */
+asmlinkage int sys_kswapd(void)
+{
+	if (!suser())
+		return -EPERM;
+	if (kswapd_running)
+		return -EBUSY;
+	kswapd_running = 1;
+	strcpy(current->comm, "kswapd");
+
+	for (;;) {
+		current->signal = 0;
+		interruptible_sleep_on(&kswapd_wait);
+		while (nr_free_pages < free_pages_high) {
+			if (!try_to_free_page(GFP_KERNEL))
+				break;
+			if (need_resched)
+				schedule();
+		}
+	}
+}
+
 static inline void add_mem_queue(struct mem_list * head, struct mem_list * entry)
 {
 	entry->prev = head;
@@ -844,6 +1414,13 @@ static inline void remove_mem_queue(struct mem_list * head, struct mem_list * en
  * for a freshly allocated page (get_free_page()).
  */
 
+static inline struct mem_zone * zone_of(unsigned long addr)
+{
+	if (addr < mem_zones[ZONE_NORMAL].start)
+		return mem_zones + ZONE_DMA;
+	return mem_zones + ZONE_NORMAL;
+}
+
 /*
  * Buddy system. Hairy. You really aren't expected to understand this
  */
@@ -852,9 +1429,11 @@ static inline void free_pages_ok(unsigned long addr, unsigned long order)
 {
 	unsigned long index = MAP_NR(addr) >> (1 + order);	//找到要释放的内存块在相应空闲链表中的索引号
 	unsigned long mask = PAGE_MASK << order;	//对应空闲链表中页面块大小屏蔽码
+	struct mem_zone * zone = zone_of(addr);
 
 	addr &= mask;	//地址对齐
 	nr_free_pages += 1 << order;	//增加空闲页面数
+	zone->nr_free_pages += 1 << order;
 	//遍历空闲页面链表数组
 	while (order < NR_MEM_LISTS-1) {
 		//change_bit()函数返回位图原值，加上！的意思就是改变之后的值
@@ -867,7 +1446,7 @@ static inline void free_pages_ok(unsigned long addr, unsigned long order)
 		//值为0，说明两个“伙伴”都归还了，将此“伙伴”从此链表中移除
 		//从这也可以看出来，只有将两个“伙伴”都归还之后，才从链表移除
 		//只要有“伙伴”之一空闲，链表项就存在？
-		remove_mem_queue(free_area_list+order, (struct mem_list *) (addr ^ (1+~mask)));	//1+~mask==-mask
+		remove_mem_queue(zone->free_area_list+order, (struct mem_list *) (addr ^ (1+~mask)));	//1+~mask==-mask
 		//遍历下一个链表，看能不能将其合并进去，即相当于释放此“伙伴”，释放过程得以循环
 		order++;
 		index >>= 1;
@@ -875,7 +1454,7 @@ static inline void free_pages_ok(unsigned long addr, unsigned long order)
 		addr &= mask;
 	}
 	//“合并”
-	add_mem_queue(free_area_list+order, (struct mem_list *) addr);
+	add_mem_queue(zone->free_area_list+order, (struct mem_list *) addr);
 }
 
 static inline void check_free_buffers(unsigned long addr)
@@ -921,16 +1500,17 @@ void free_pages(unsigned long addr, unsigned long order)
 /*
  * Some ugly macros to speed up __get_free_pages()..
  */
-#define RMQUEUE(order) \
-do { struct mem_list * queue = free_area_list+order; \	//取得相应链表头指针
+#define RMQUEUE(zone,order) \
+do { struct mem_list * queue = zone->free_area_list+order; \	//取得相应链表头指针
      unsigned long new_order = order; \					//记录分配得到的链表的oeder
 	do { struct mem_list *next = queue->next; \			//指向链表头指针下一项
 		if (queue != next) { \							//若链表不为空（表示有空闲页面）
 			(queue->next = next->next)->prev = queue; \	//将此“伙伴”项从链表中移除
 			mark_used((unsigned long) next, new_order); \	//change_bit
 			nr_free_pages -= 1 << order; \	//减少空闲页面数
+			zone->nr_free_pages -= 1 << order; \
 			restore_flags(flags); \			
-			EXPAND(next, order, new_order); \	//
+			EXPAND(zone, next, order, new_order); \	//
 			return (unsigned long) next; \
 		} new_order++; queue++; \	//此链表为空，则遍历下一链表
 	} while (new_order < NR_MEM_LISTS); \
@@ -941,21 +1521,23 @@ static inline int mark_used(unsigned long addr, unsigned long order)
 	return change_bit(MAP_NR(addr) >> (1+order), free_area_map[order]);
 }
 
-#define EXPAND(addr,low,high) \
+#define EXPAND(zone,addr,low,high) \
 do { unsigned long size = PAGE_SIZE << high; \	//得到相应的页面大小
 	while (high > low) { \					//若high==low，说明分配的页面数也是请求的页面数，则不必循环，
 		high--; size >>= 1; cli(); \	//为下次的循环做准备
-		add_mem_queue(free_area_list+high, addr); \	//将大“伙伴”中分配剩下的一半加入到次级链表中（high已经减一了）
+		add_mem_queue(zone->free_area_list+high, addr); \	//将大“伙伴”中分配剩下的一半加入到次级链表中（high已经减一了）
 		mark_used((unsigned long) addr, high); \	//change_bit
 		restore_flags(flags); \
 		addr = (struct mem_list *) (size + (unsigned long) addr); \	//将一半的一半加入到次次级链表中，如此循环
 	} mem_map[MAP_NR((unsigned long) addr)] = 1; \
+	mem_age[MAP_NR((unsigned long) addr)] = PAGE_AGE_INIT; \
 } while (0)
 
 unsigned long __get_free_pages(int priority, unsigned long order)
 {
 	unsigned long flags;
 	int reserved_pages;
+	struct mem_zone * zone;
 
 	if (intr_count && priority != GFP_ATOMIC) {
 		static int count = 0;
@@ -970,11 +1552,23 @@ unsigned long __get_free_pages(int priority, unsigned long order)
 		reserved_pages = min_free_pages;
 	save_flags(flags);
 repeat:
+	if (nr_free_pages <= free_pages_low && kswapd_running)
+		wake_up_interruptible(&kswapd_wait);
 	cli();
 	if ((priority==GFP_ATOMIC) || nr_free_pages > reserved_pages) {
-		RMQUEUE(order);	//从伙伴系统分配页面
-		restore_flags(flags);
-		return 0;
+		/*
+		 * Ordinary memory first.  The DMA zone is only used above
+		 * its own reserve, which is kept for the ISA drivers.
+		 */
+		zone = mem_zones + ZONE_NORMAL;
+		RMQUEUE(zone, order);	//从伙伴系统分配页面
+		zone = mem_zones + ZONE_DMA;
+		if (priority == GFP_ATOMIC || zone->nr_free_pages > zone->pages_min ||
+		    !mem_zones[ZONE_NORMAL].size) {
+			RMQUEUE(zone, order);
+			restore_flags(flags);
+			return 0;
+		}
 	}
 	restore_flags(flags);
 	if (priority != GFP_BUFFER && try_to_free_page(priority))
@@ -983,30 +1577,42 @@ repeat:
 }
 
 /*
- * Yes, I know this is ugly. Don't tell me.
+ * DMA memory comes straight off the DMA zone's lists.  As before, this
+ * never tries to free memory: that wouldn't know to free low pages.
  */
 unsigned long __get_dma_pages(int priority, unsigned long order)
 {
-	unsigned long list = 0;
-	unsigned long result;
-	unsigned long limit = MAX_DMA_ADDRESS;
+	unsigned long flags;
+	struct mem_zone * zone = mem_zones + ZONE_DMA;
 
-	/* if (EISA_bus) limit = ~0UL; */
-	if (priority != GFP_ATOMIC)
-		priority = GFP_BUFFER;
-	for (;;) {
-		result = __get_free_pages(priority, order);
-		if (result < limit) /* covers failure as well */
-			break;
-		*(unsigned long *) result = list;
-		list = result;
-	}
-	while (list) {
-		unsigned long tmp = list;
-		list = *(unsigned long *) list;
-		free_pages(tmp, order);
+	save_flags(flags);
+	cli();
+	if (priority == GFP_ATOMIC || nr_free_pages > min_free_pages)
+		RMQUEUE(zone, order);
+	restore_flags(flags);
+	return 0;
+}
+
+/*
+ * Count the free blocks of each order in a zone.  Returns the free pages
+ * that are not in blocks of the largest order, which is how fragmented
+ * the zone is.  Called with interrupts off.
+ */
+static unsigned long zone_free_blocks(struct mem_zone * zone, unsigned long * nr)
+{
+	unsigned long order, small = 0;
+
+	for (order = 0 ; order < NR_MEM_LISTS ; order++) {
+		struct mem_list * head = zone->free_area_list + order;
+		struct mem_list * tmp;
+
+		nr[order] = 0;
+		for (tmp = head->next ; tmp != head ; tmp = tmp->next)
+			nr[order]++;
+		if (order < NR_MEM_LISTS-1)
+			small += nr[order] << order;
 	}
-	return result;
+	return small;
 }
 
 /*
@@ -1017,27 +1623,61 @@ unsigned long __get_dma_pages(int priority, unsigned long order)
 void show_free_areas(void)
 {
  	unsigned long order, flags;
- 	unsigned long total = 0;
+	unsigned long nr[NR_MEM_LISTS];
+	struct mem_zone * zone;
 
-	printk("Free pages:      %6dkB\n ( ",nr_free_pages<<(PAGE_SHIFT-10));
-	save_flags(flags);
-	cli();
- 	for (order=0 ; order < NR_MEM_LISTS; order++) {
-		struct mem_list * tmp;
-		unsigned long nr = 0;
-		for (tmp = free_area_list[order].next ; tmp != free_area_list + order ; tmp = tmp->next) {
-			nr ++;
+	printk("Free pages:      %6dkB\n",nr_free_pages<<(PAGE_SHIFT-10));
+	for (zone = mem_zones ; zone < mem_zones + NR_ZONES ; zone++) {
+		unsigned long total = 0;
+
+		if (!zone->size)
+			continue;
+		save_flags(flags);
+		cli();
+		zone_free_blocks(zone, nr);
+		restore_flags(flags);
+		printk("%-6s ( ", zone->name);
+		for (order=0 ; order < NR_MEM_LISTS; order++) {
+			total += nr[order] * ((PAGE_SIZE>>10) << order);
+			printk("%lu*%lukB ", nr[order], (PAGE_SIZE>>10) << order);
 		}
-		total += nr * ((PAGE_SIZE>>10) << order);
-		printk("%lu*%lukB ", nr, (PAGE_SIZE>>10) << order);
+		printk("= %lukB)\n", total);
 	}
-	restore_flags(flags);
-	printk("= %lukB)\n", total);
 #ifdef SWAP_CACHE_INFO
 	show_swap_cache_info();
 #endif	
 }
 
+/*
+ * /proc/zoneinfo
+ */
+int get_zoneinfo(char * buffer)
+{
+	unsigned long order, flags, small, free;
+	unsigned long nr[NR_MEM_LISTS];
+	struct mem_zone * zone;
+	int len = 0;
+
+	for (zone = mem_zones ; zone < mem_zones + NR_ZONES ; zone++) {
+		if (!zone->size)
+			continue;
+		save_flags(flags);
+		cli();
+		small = zone_free_blocks(zone, nr);
+		free = zone->nr_free_pages;
+		restore_flags(flags);
+		len += sprintf(buffer+len, "%-6s pages %lu free %lu min %d low %d high %d\n"
+			"       blocks",
+			zone->name, zone->size, free,
+			zone->pages_min, zone->pages_low, zone->pages_high);
+		for (order = 0 ; order < NR_MEM_LISTS ; order++)
+			len += sprintf(buffer+len, " %lu", nr[order]);
+		len += sprintf(buffer+len, "\n       fragmentation %lu%%\n",
+			free ? small * 100 / free : 0);
+	}
+	return len;
+}
+
 /*
  * Trying to stop swapping from a file is fraught with races, so
  * we repeat quite a bit here when we have to pause. swapoff()
@@ -1291,16 +1931,25 @@ asmlinkage int sys_swapoff(const char * specialfile)
 
 	if (!suser())
 		return -EPERM;
-	//在文件系统中寻找要关闭交换设备（文件）i节点
-	i = namei(specialfile,&inode);
-	//若没找到 则直接返回
-	if (i)
-		return i;
+	inode = NULL;
+	if (specialfile) {
+		//在文件系统中寻找要关闭交换设备（文件）i节点
+		i = namei(specialfile,&inode);
+		//若没找到 则直接返回
+		if (i)
+			return i;
+	}
 	p = swap_info;
 	//遍历交换设备结构数组，找到要关闭的交换设备项结构信息
 	for (type = 0 ; type < nr_swapfiles ; type++,p++) {
 		if ((p->flags & SWP_WRITEOK) != SWP_WRITEOK)
 			continue;
+		/* swapoff(NULL) is for the compressed area */
+		if (!inode) {
+			if (p->zswap)
+				break;
+			continue;
+		}
 		//如果swap_file不为空，则交换设备映射磁盘文件
 		if (p->swap_file) {
 			//如果映射的磁盘文件i节点和要关闭的交换设备（文件）相等，则表明找到了相应的交换设备项
@@ -1320,6 +1969,7 @@ asmlinkage int sys_swapoff(const char * specialfile)
 		return -EINVAL;
 	}
 	p->flags = SWP_USED;
+	swap_ra_flush(type);
 	i = try_to_unuse(type);	//应该是将swap_out到要关闭的交换设备中的页面swap_in回进程的物理页面
 	if (i) {
 		iput(inode);
@@ -1341,6 +1991,10 @@ asmlinkage int sys_swapoff(const char * specialfile)
 	iput(inode);
 
 	nr_swap_pages -= p->pages;
+	if (p->zswap) {
+		zswap_destroy(p->zswap);
+		p->zswap = NULL;
+	}
 	iput(p->swap_file);
 	p->swap_file = NULL;
 	p->swap_device = 0;
@@ -1357,7 +2011,39 @@ asmlinkage int sys_swapoff(const char * specialfile)
  *
  * The swapon system call
  */
-asmlinkage int sys_swapon(const char * specialfile)
+/*
+ * A compressed swap area has no header to read: all of its slots are
+ * free, and the lock map only has room for 8*PAGE_SIZE of them.
+ */
+static int swapon_compressed(struct swap_info_struct * p, unsigned long cap)
+{
+	if (!cap)
+		cap = MAP_NR(high_memory) / 4;
+	p->max = cap * ZSWAP_SLOTS + 1;
+	if (p->max > 8*PAGE_SIZE)
+		p->max = 8*PAGE_SIZE;
+	p->swap_lockmap = (unsigned char *) get_free_page(GFP_USER);
+	if (!p->swap_lockmap)
+		return -ENOMEM;
+	p->swap_map = (unsigned char *) vmalloc(p->max);
+	if (!p->swap_map)
+		return -ENOMEM;
+	memset(p->swap_map, 0, p->max);
+	p->swap_map[0] = 0x80;
+	p->zswap = zswap_create(p->max, cap);
+	if (!p->zswap)
+		return -ENOMEM;
+	p->lowest_bit = 1;
+	p->highest_bit = p->max - 1;
+	p->flags = SWP_WRITEOK;
+	p->pages = p->max - 1;
+	nr_swap_pages += p->pages;
+	printk("Adding compressed swap: %ldk pool, %dk swap-space\n",
+		cap << (PAGE_SHIFT - 10), p->pages << (PAGE_SHIFT - 10));
+	return 0;
+}
+
+asmlinkage int sys_swapon(const char * specialfile, int swap_flags)
 {
 	struct swap_info_struct * p;
 	struct inode * swap_inode;
@@ -1386,6 +2072,22 @@ asmlinkage int sys_swapon(const char * specialfile)
 	p->lowest_bit = 0;
 	p->highest_bit = 0;
 	p->max = 1;
+	p->cluster_next = 0;
+	p->cluster_nr = 0;
+	p->zswap = NULL;
+	/*
+	 * Old binaries don't pass swap_flags at all, but they always pass
+	 * a file name.
+	 */
+	if (!specialfile) {
+		error = -EINVAL;
+		if (!(swap_flags & SWAP_FLAG_COMPRESS))
+			goto bad_swap_2;
+		error = swapon_compressed(p, swap_flags & SWAP_FLAG_SIZE_MASK);
+		if (error)
+			goto bad_swap_2;
+		return 0;
+	}
 	//在文件系统中找到指定的交换设备（文件）i节点
 	error = namei(specialfile,&swap_inode);
 	if (error)
@@ -1534,6 +2236,8 @@ unsigned long free_area_init(unsigned long start_mem, unsigned long end_mem)
 	if (i < 16)
 		i = 16;
 	min_free_pages = i;
+	free_pages_low = i + i;
+	free_pages_high = i + i + i;
 	start_mem = init_swap_cache(start_mem, end_mem);
 	mem_map = (mem_map_t *) start_mem;
 	p = mem_map + MAP_NR(end_mem);
@@ -1541,11 +2245,44 @@ unsigned long free_area_init(unsigned long start_mem, unsigned long end_mem)
 	//全部页面初始化为MAP_PAGE_RESERVED的
 	while (p > mem_map)
 		*--p = MAP_PAGE_RESERVED;
+	start_mem = (start_mem + sizeof(long) - 1) & ~(sizeof(long) - 1);
+	mem_rmap = (unsigned long *) start_mem;
+	start_mem += MAP_NR(end_mem) * sizeof(unsigned long);
+	memset(mem_rmap, 0, MAP_NR(end_mem) * sizeof(unsigned long));
+	mem_age = (unsigned char *) start_mem;
+	start_mem += MAP_NR(end_mem);
+	memset(mem_age, 0, MAP_NR(end_mem));
+	start_mem = (start_mem + sizeof(long) - 1) & ~(sizeof(long) - 1);
+
+	/*
+	 * Split memory into zones, each with watermarks scaled to its size
+	 * like the global ones above.
+	 */
+	mem_zones[ZONE_DMA].name = "DMA";
+	mem_zones[ZONE_DMA].start = PAGE_OFFSET;
+	mem_zones[ZONE_DMA].end = end_mem < MAX_DMA_ADDRESS ? end_mem : MAX_DMA_ADDRESS;
+	mem_zones[ZONE_NORMAL].name = "Normal";
+	mem_zones[ZONE_NORMAL].start = mem_zones[ZONE_DMA].end;
+	mem_zones[ZONE_NORMAL].end = end_mem;
+	for (i = 0 ; i < NR_ZONES ; i++) {
+		struct mem_zone * zone = mem_zones + i;
+		int j;
+
+		for (j = 0 ; j < NR_MEM_LISTS ; j++)
+			zone->free_area_list[j].prev = zone->free_area_list[j].next =
+				&zone->free_area_list[j];
+		zone->size = (zone->end - zone->start) >> PAGE_SHIFT;
+		zone->nr_free_pages = 0;
+		zone->pages_min = zone->size >> 7;
+		if (zone->size && zone->pages_min < 4)
+			zone->pages_min = 4;
+		zone->pages_low = zone->pages_min * 2;
+		zone->pages_high = zone->pages_min * 3;
+	}
 
-	//初始化free_area_list及free_area_map
+	//初始化free_area_map
 	for (i = 0 ; i < NR_MEM_LISTS ; i++) {
 		unsigned long bitmap_size;	//相应的free_area_map位图的长度
-		free_area_list[i].prev = free_area_list[i].next = &free_area_list[i];
 		mask += mask;	//屏蔽码 用于"对齐"页面数
 		//"对齐"页面数 比如，若实际物理页面数为N=19，
 		//order=1的free_area_list对应的单个list元素为2个连续的页面，则页面总数要求为2的整倍数,则N截为18
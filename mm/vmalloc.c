@@ -67,9 +67,339 @@ struct vm_struct {
 	void * addr;	// 虚拟地址的开始
 	unsigned long size;		// 分配大小
 	struct vm_struct * next;
+	struct vm_struct * vm_avl_left;
+	struct vm_struct * vm_avl_right;
+	int vm_avl_height;
+	unsigned long gap;	/* free space between the previous area and us */
+	unsigned long max_gap;	/* largest gap in this subtree */
+	struct vm_struct * lazy_next;
 };
 
+#define VM_LAZY		0x0001	/* vfree()d, the TLB not yet flushed */
+
+/*
+ * vfree() doesn't flush the TLB: the pages are freed at once, but the
+ * address range stays allocated until this many pages have piled up,
+ * and then one invalidate() makes them all reusable.
+ */
+#define VM_LAZY_MAX	1024
+
 static struct vm_struct * vmlist = NULL;
+static struct vm_struct * vm_avl = NULL;
+static struct vm_struct * vm_lazy = NULL;
+static unsigned long vm_lazy_pages = 0;
+
+/*
+ * The areas are kept on vmlist, sorted by address, and in an AVL tree
+ * keyed by address (the same balancing as the vma trees in mmap.c).
+ * Each node also carries the free gap in front of it and the largest
+ * gap in its subtree, so both vmalloc() and vfree() are O(log n).
+ */
+#define vm_avl_empty	(struct vm_struct *) NULL
+#define vm_avl_maxheight	41
+#define vm_heightof(tree)	((tree) == vm_avl_empty ? 0 : (tree)->vm_avl_height)
+#define vm_max_gapof(tree)	((tree) == vm_avl_empty ? 0 : (tree)->max_gap)
+
+static inline void vm_fix_gap(struct vm_struct * node)
+{
+	unsigned long gap = node->gap;
+
+	if (vm_max_gapof(node->vm_avl_left) > gap)
+		gap = node->vm_avl_left->max_gap;
+	if (vm_max_gapof(node->vm_avl_right) > gap)
+		gap = node->vm_avl_right->max_gap;
+	node->max_gap = gap;
+}
+
+/*
+ * Rebalance after an insert or delete, see avl_rebalance() in mmap.c.
+ * We can't stop early once the heights settle: the max_gap of every
+ * node up to the root may have changed.
+ */
+static void vm_avl_rebalance(struct vm_struct *** nodeplaces_ptr, int count)
+{
+	for ( ; count > 0 ; count--) {
+		struct vm_struct ** nodeplace = *--nodeplaces_ptr;
+		struct vm_struct * node = *nodeplace;
+		struct vm_struct * nodeleft = node->vm_avl_left;
+		struct vm_struct * noderight = node->vm_avl_right;
+		int heightleft = vm_heightof(nodeleft);
+		int heightright = vm_heightof(noderight);
+		if (heightright + 1 < heightleft) {
+			struct vm_struct * nodeleftleft = nodeleft->vm_avl_left;
+			struct vm_struct * nodeleftright = nodeleft->vm_avl_right;
+			int heightleftright = vm_heightof(nodeleftright);
+			if (vm_heightof(nodeleftleft) >= heightleftright) {
+				node->vm_avl_left = nodeleftright; nodeleft->vm_avl_right = node;
+				nodeleft->vm_avl_height = 1 + (node->vm_avl_height = 1 + heightleftright);
+				vm_fix_gap(node);
+				vm_fix_gap(nodeleft);
+				*nodeplace = nodeleft;
+			} else {
+				nodeleft->vm_avl_right = nodeleftright->vm_avl_left;
+				node->vm_avl_left = nodeleftright->vm_avl_right;
+				nodeleftright->vm_avl_left = nodeleft;
+				nodeleftright->vm_avl_right = node;
+				nodeleft->vm_avl_height = node->vm_avl_height = heightleftright;
+				nodeleftright->vm_avl_height = heightleft;
+				vm_fix_gap(nodeleft);
+				vm_fix_gap(node);
+				vm_fix_gap(nodeleftright);
+				*nodeplace = nodeleftright;
+			}
+		}
+		else if (heightleft + 1 < heightright) {
+			struct vm_struct * noderightright = noderight->vm_avl_right;
+			struct vm_struct * noderightleft = noderight->vm_avl_left;
+			int heightrightleft = vm_heightof(noderightleft);
+			if (vm_heightof(noderightright) >= heightrightleft) {
+				node->vm_avl_right = noderightleft; noderight->vm_avl_left = node;
+				noderight->vm_avl_height = 1 + (node->vm_avl_height = 1 + heightrightleft);
+				vm_fix_gap(node);
+				vm_fix_gap(noderight);
+				*nodeplace = noderight;
+			} else {
+				noderight->vm_avl_left = noderightleft->vm_avl_right;
+				node->vm_avl_right = noderightleft->vm_avl_left;
+				noderightleft->vm_avl_right = noderight;
+				noderightleft->vm_avl_left = node;
+				noderight->vm_avl_height = node->vm_avl_height = heightrightleft;
+				noderightleft->vm_avl_height = heightright;
+				vm_fix_gap(noderight);
+				vm_fix_gap(node);
+				vm_fix_gap(noderightleft);
+				*nodeplace = noderightleft;
+			}
+		}
+		else {
+			node->vm_avl_height = (heightleft<heightright ? heightright : heightleft) + 1;
+			vm_fix_gap(node);
+		}
+	}
+}
+
+/* Insert a node, and return the node to the left of it. */
+static struct vm_struct * vm_avl_insert(struct vm_struct * new_node)
+{
+	unsigned long key = (unsigned long) new_node->addr;
+	struct vm_struct ** nodeplace = &vm_avl;
+	struct vm_struct ** stack[vm_avl_maxheight];
+	int stack_count = 0;
+	struct vm_struct *** stack_ptr = &stack[0];
+	struct vm_struct * to_the_left = NULL;
+
+	for (;;) {
+		struct vm_struct * node = *nodeplace;
+		if (node == vm_avl_empty)
+			break;
+		*stack_ptr++ = nodeplace; stack_count++;
+		if (key < (unsigned long) node->addr)
+			nodeplace = &node->vm_avl_left;
+		else {
+			to_the_left = node;
+			nodeplace = &node->vm_avl_right;
+		}
+	}
+	new_node->vm_avl_left = vm_avl_empty;
+	new_node->vm_avl_right = vm_avl_empty;
+	new_node->vm_avl_height = 1;
+	new_node->max_gap = new_node->gap;
+	*nodeplace = new_node;
+	vm_avl_rebalance(stack_ptr,stack_count);
+	return to_the_left;
+}
+
+static void vm_avl_remove(struct vm_struct * node_to_delete)
+{
+	unsigned long key = (unsigned long) node_to_delete->addr;
+	struct vm_struct ** nodeplace = &vm_avl;
+	struct vm_struct ** stack[vm_avl_maxheight];
+	int stack_count = 0;
+	struct vm_struct *** stack_ptr = &stack[0];
+	struct vm_struct ** nodeplace_to_delete;
+
+	for (;;) {
+		struct vm_struct * node = *nodeplace;
+		if (node == vm_avl_empty) {
+			printk("vm_avl_remove: node to delete not found in tree\n");
+			return;
+		}
+		*stack_ptr++ = nodeplace; stack_count++;
+		if (key == (unsigned long) node->addr)
+			break;
+		if (key < (unsigned long) node->addr)
+			nodeplace = &node->vm_avl_left;
+		else
+			nodeplace = &node->vm_avl_right;
+	}
+	nodeplace_to_delete = nodeplace;
+	if (node_to_delete->vm_avl_left == vm_avl_empty) {
+		*nodeplace_to_delete = node_to_delete->vm_avl_right;
+		stack_ptr--; stack_count--;
+	} else {
+		struct vm_struct *** stack_ptr_to_delete = stack_ptr;
+		struct vm_struct ** nodeplace = &node_to_delete->vm_avl_left;
+		struct vm_struct * node;
+		for (;;) {
+			node = *nodeplace;
+			if (node->vm_avl_right == vm_avl_empty)
+				break;
+			*stack_ptr++ = nodeplace; stack_count++;
+			nodeplace = &node->vm_avl_right;
+		}
+		*nodeplace = node->vm_avl_left;
+		node->vm_avl_left = node_to_delete->vm_avl_left;
+		node->vm_avl_right = node_to_delete->vm_avl_right;
+		node->vm_avl_height = node_to_delete->vm_avl_height;
+		*nodeplace_to_delete = node;
+		*stack_ptr_to_delete = &node->vm_avl_left;
+	}
+	vm_avl_rebalance(stack_ptr,stack_count);
+}
+
+/* Recompute max_gap from the root down to the node at 'key'. */
+static void vm_avl_fix_path(unsigned long key)
+{
+	struct vm_struct * stack[vm_avl_maxheight];
+	struct vm_struct * node = vm_avl;
+	int count = 0;
+
+	while (node != vm_avl_empty) {
+		stack[count++] = node;
+		if (key == (unsigned long) node->addr)
+			break;
+		if (key < (unsigned long) node->addr)
+			node = node->vm_avl_left;
+		else
+			node = node->vm_avl_right;
+	}
+	while (count > 0)
+		vm_fix_gap(stack[--count]);
+}
+
+static struct vm_struct * vm_find(void * addr)
+{
+	struct vm_struct * tree = vm_avl;
+
+	while (tree != vm_avl_empty) {
+		if (addr == tree->addr)
+			return tree;
+		if (addr < tree->addr)
+			tree = tree->vm_avl_left;
+		else
+			tree = tree->vm_avl_right;
+	}
+	return NULL;
+}
+
+/* The areas to the left and to the right of 'node' (which is in the tree). */
+static void vm_neighbours(struct vm_struct * node, struct vm_struct ** to_the_left,
+	struct vm_struct ** to_the_right)
+{
+	struct vm_struct * tree = vm_avl;
+
+	*to_the_left = *to_the_right = NULL;
+	while (tree != node) {
+		if (node->addr < tree->addr) {
+			*to_the_right = tree;
+			tree = tree->vm_avl_left;
+		} else {
+			*to_the_left = tree;
+			tree = tree->vm_avl_right;
+		}
+	}
+	if ((tree = node->vm_avl_left) != vm_avl_empty) {
+		while (tree->vm_avl_right != vm_avl_empty)
+			tree = tree->vm_avl_right;
+		*to_the_left = tree;
+	}
+	if ((tree = node->vm_avl_right) != vm_avl_empty) {
+		while (tree->vm_avl_left != vm_avl_empty)
+			tree = tree->vm_avl_left;
+		*to_the_right = tree;
+	}
+}
+
+/*
+ * Find room for 'area' (area->size already set): the lowest gap that is
+ * big enough, or else the space after the last area.
+ */
+static int vm_place(struct vm_struct * area)
+{
+	struct vm_struct * tree = vm_avl, * left;
+	struct vm_struct * next = NULL;
+	unsigned long addr;
+
+	if (vm_max_gapof(tree) >= area->size) {
+		for (;;) {
+			if (vm_max_gapof(tree->vm_avl_left) >= area->size)
+				tree = tree->vm_avl_left;
+			else if (tree->gap >= area->size)
+				break;
+			else
+				tree = tree->vm_avl_right;
+		}
+		next = tree;
+		addr = (unsigned long) next->addr - next->gap;
+	} else {
+		addr = VMALLOC_START;
+		if (tree != vm_avl_empty) {
+			while (tree->vm_avl_right != vm_avl_empty)
+				tree = tree->vm_avl_right;
+			addr = (unsigned long) tree->addr + tree->size;
+		}
+		if (addr + area->size > VMALLOC_END || addr + area->size < addr)
+			return 0;
+	}
+	area->addr = (void *) addr;
+	area->gap = 0;
+	if (next)
+		next->gap -= area->size;
+	left = vm_avl_insert(area);
+	if (left) {
+		area->next = left->next;
+		left->next = area;
+	} else {
+		area->next = vmlist;
+		vmlist = area;
+	}
+	return 1;
+}
+
+static void vm_unplace(struct vm_struct * area)
+{
+	struct vm_struct * left, * right;
+
+	vm_neighbours(area, &left, &right);
+	if (left)
+		left->next = right;
+	else
+		vmlist = right;
+	vm_avl_remove(area);
+	if (right) {
+		right->gap += area->gap + area->size;
+		vm_avl_fix_path((unsigned long) right->addr);
+	}
+}
+
+/*
+ * Flush the TLB once for everything vfree() has unmapped since last
+ * time, and give the address ranges back.
+ */
+static void vm_purge_lazy(void)
+{
+	struct vm_struct * tmp;
+
+	if (!vm_lazy)
+		return;
+	invalidate();
+	while ((tmp = vm_lazy) != NULL) {
+		vm_lazy = tmp->lazy_next;
+		vm_unplace(tmp);
+		kfree(tmp);
+	}
+	vm_lazy_pages = 0;
+}
 
 static inline void set_pgdir(unsigned long address, pgd_t entry)
 {
@@ -136,6 +466,10 @@ static inline void free_area_pmd(pgd_t * dir, unsigned long address, unsigned lo
 	}
 }
 
+/*
+ * No TLB flush here: the range isn't reused before vm_purge_lazy() has
+ * done one for it.
+ */
 static void free_area_pages(unsigned long address, unsigned long size)
 {
 	pgd_t * dir;
@@ -147,7 +481,6 @@ static void free_area_pages(unsigned long address, unsigned long size)
 		address = (address + PGDIR_SIZE) & PGDIR_MASK;
 		dir++;
 	}
-	invalidate();
 }
 
 //alloc_area_XXX函数将所指定的虚拟线性空间范围分配并映射物理内存页面
@@ -211,7 +544,7 @@ static int alloc_area_pages(unsigned long address, unsigned long size)
 		address = (address + PGDIR_SIZE) & PGDIR_MASK;
 		dir++;
 	}
-	invalidate();
+	/* no invalidate(): the TLB holds nothing for ptes that weren't present */
 	return 0;
 }
 
@@ -232,7 +565,7 @@ static int alloc_area_pages(unsigned long address, unsigned long size)
 
 void vfree(void * addr)
 {
-	struct vm_struct **p, *tmp;
+	struct vm_struct *tmp;
 
 	if (!addr)
 		return;
@@ -240,24 +573,26 @@ void vfree(void * addr)
 		printk("Trying to vfree() bad address (%p)\n", addr);
 		return;
 	}
-	for (p = &vmlist ; (tmp = *p) ; p = &tmp->next) {
-		if (tmp->addr == addr) {
-			*p = tmp->next;
-			//将线性地址空间所覆盖的范围内分配并映射的全部物理内存释放掉
-			free_area_pages(VMALLOC_VMADDR(tmp->addr), tmp->size);
-			kfree(tmp);
-			return;
-		}
+	tmp = vm_find(addr);
+	if (!tmp || (tmp->flags & VM_LAZY)) {
+		printk("Trying to vfree() nonexistent vm area (%p)\n", addr);
+		return;
 	}
-	printk("Trying to vfree() nonexistent vm area (%p)\n", addr);
+	//将线性地址空间所覆盖的范围内分配并映射的全部物理内存释放掉
+	free_area_pages(VMALLOC_VMADDR(tmp->addr), tmp->size);
+	tmp->flags |= VM_LAZY;
+	tmp->lazy_next = vm_lazy;
+	vm_lazy = tmp;
+	vm_lazy_pages += tmp->size >> PAGE_SHIFT;
+	if (vm_lazy_pages > VM_LAZY_MAX)
+		vm_purge_lazy();
 }
 
 //而vmalloc申请的内存则位于vmalloc_start～vmalloc_end之间，与物理地址没有简单的转换关系，
 //虽然在逻辑上它们也是连续的，但是在物理上它们不要求连续。
 void * vmalloc(unsigned long size)
 {
-	void * addr;
-	struct vm_struct **p, *tmp, *area;
+	struct vm_struct *area;
 
 	/* to align the pointer to the (next) page boundary */
 	////检查请求分配的内存大小有没有超过最大的物理页面数。如果超过返回 0 ，表示分配失败
@@ -269,25 +604,22 @@ void * vmalloc(unsigned long size)
 	area = (struct vm_struct *) kmalloc(sizeof(*area), GFP_KERNEL);
 	if (!area)
 		return NULL;
-	addr = (void *) VMALLOC_START;	//VMALLOC_START开始遍历vmlist链表,将申请到的vm_struct结构插入到 vm_list链表中.
+	area->flags = 0;
 	area->size = size + PAGE_SIZE;	//不同的内核虚拟地址被4k大小(PAGE_SIZE)的空闲区间隔，以防止越界
-	area->next = NULL;
-	//将area插入到vmlist链表中去，我在想，是不是有bug，比如第一次申请high_memory大小的空间，第二次再申请high_memory大小的空间
-	for (p = &vmlist; (tmp = *p) ; p = &tmp->next) {
-		//遍历vmlist链表,将area插入到前后两者间间隙放得下area的位置
-		if (size + (unsigned long) addr < (unsigned long) tmp->addr)
-			break;
-		addr = (void *) (tmp->size + (unsigned long) tmp->addr);
+	if (!vm_place(area)) {
+		/* maybe vfree()d space is waiting for its TLB flush */
+		vm_purge_lazy();
+		if (!vm_place(area)) {
+			kfree(area);
+			return NULL;
+		}
 	}
-	area->addr = addr;
-	area->next = *p;
-	*p = area;
 	//将线性地址空间所覆盖的范围全部分配并映射物理内存
-	if (alloc_area_pages(VMALLOC_VMADDR(addr), size)) {
-		vfree(addr);
+	if (alloc_area_pages(VMALLOC_VMADDR(area->addr), size)) {
+		vfree(area->addr);
 		return NULL;
 	}
-	return addr;
+	return area->addr;
 }
 
 int vread(char *buf, char *addr, int count)
@@ -297,6 +629,8 @@ int vread(char *buf, char *addr, int count)
 	int n;
 
 	for (p = &vmlist; (tmp = *p) ; p = &tmp->next) {
+		if (tmp->flags & VM_LAZY)
+			continue;
 		vaddr = (char *) tmp->addr;
 		while (addr < vaddr) {
 			if (count == 0)
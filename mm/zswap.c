@@ -0,0 +1,366 @@
+/*
+ *  linux/mm/zswap.c
+ *
+ *  Compressed swap in memory.
+ */
+
+/*
+ * A compressed swap area has no device or file behind it: a page written
+ * to one of its slots is compressed and packed into pool pages, and read
+ * back by decompressing it.  Pages that don't compress are kept whole,
+ * and pages of zeroes take no space at all.  The pool never grows beyond
+ * the cap given to swapon(); get_swap_page() stops handing out slots
+ * once it is reached, so later pages go to the next swap area.
+ *
+ * Compression is a small LZ77: groups of eight items behind a control
+ * byte, each item a literal byte or a two byte (length, distance) match
+ * into the last 1kB.  It doesn't sleep, and neither does anything else
+ * here, so the static work areas need no locking.
+ */
+
+#include <linux/mm.h>
+#include <linux/sched.h>
+#include <linux/kernel.h>
+#include <linux/string.h>
+#include <linux/malloc.h>
+
+#include <asm/system.h>
+
+#define ZS_MATCH_MIN	3
+#define ZS_MATCH_MAX	(ZS_MATCH_MIN + 63)
+#define ZS_DIST_MAX	1023
+#define ZS_HASH_BITS	10
+#define ZS_HASH_SIZE	(1 << ZS_HASH_BITS)
+
+/* worst case growth of one group: control byte and eight matches */
+#define ZS_GROUP_MAX	(1 + 8*2)
+
+/* what a slot holds */
+#define ZS_NONE		0
+#define ZS_ZERO		1	/* a page of zeroes */
+#define ZS_PACKED	2	/* compressed, inside a pool page */
+#define ZS_PAGE		3	/* didn't compress: a page of its own */
+
+struct zswap_slot {
+	char * data;
+	unsigned short len;
+	unsigned short kind;
+};
+
+/* header at the start of every pool page that holds packed data */
+struct zswap_pool_page {
+	int live;		/* bytes still in use */
+	int next;		/* where the next chunk goes */
+};
+
+struct zswap_area {
+	struct zswap_slot * slots;
+	unsigned long max;
+	unsigned long cap;	/* most pool pages we may hold */
+	unsigned long pages;	/* pool pages we do hold */
+	unsigned long open;	/* pool page being filled */
+};
+
+static unsigned short zs_hash[ZS_HASH_SIZE];
+static unsigned char zs_buf[PAGE_SIZE];
+
+static int zs_areas = 0;
+static unsigned long zs_stored = 0;	/* pages held, all areas */
+static unsigned long zs_pool = 0;	/* pool pages, all areas */
+
+static inline unsigned int zs_hashof(unsigned char * p)
+{
+	unsigned int v = (p[0] << 16) | (p[1] << 8) | p[2];
+
+	return (v * 2654435761U) >> (32 - ZS_HASH_BITS);
+}
+
+/*
+ * Compress a page into 'dst'.  Returns the compressed length, or -1 if it
+ * wouldn't fit in 'max' bytes.
+ */
+static int zs_compress(unsigned char * src, unsigned char * dst, int max)
+{
+	unsigned char * copymap = NULL;
+	int copymask = 0x80;
+	int s = 0, d = 0;
+
+	memset(zs_hash, 0, sizeof(zs_hash));
+	while (s < PAGE_SIZE) {
+		unsigned int h;
+		int cand, dist, len;
+
+		if ((copymask <<= 1) == 0x100) {
+			if (d > max - ZS_GROUP_MAX)
+				return -1;
+			copymask = 1;
+			copymap = dst + d;
+			dst[d++] = 0;
+		}
+		if (s > PAGE_SIZE - ZS_MATCH_MAX) {
+			dst[d++] = src[s++];
+			continue;
+		}
+		h = zs_hashof(src + s);
+		cand = zs_hash[h] - 1;
+		zs_hash[h] = s + 1;
+		dist = s - cand;
+		if (cand < 0 || dist > ZS_DIST_MAX ||
+		    src[cand] != src[s] || src[cand+1] != src[s+1] ||
+		    src[cand+2] != src[s+2]) {
+			dst[d++] = src[s++];
+			continue;
+		}
+		len = ZS_MATCH_MIN;
+		while (len < ZS_MATCH_MAX && src[s+len] == src[cand+len])
+			len++;
+		*copymap |= copymask;
+		dst[d++] = ((len - ZS_MATCH_MIN) << 2) | (dist >> 8);
+		dst[d++] = dist;
+		s += len;
+	}
+	return d;
+}
+
+static void zs_decompress(unsigned char * src, int slen, unsigned char * dst)
+{
+	int copymap = 0, copymask = 0x80;
+	int s = 0, d = 0;
+
+	while (s < slen && d < PAGE_SIZE) {
+		if ((copymask <<= 1) == 0x100) {
+			copymask = 1;
+			copymap = src[s++];
+			if (s >= slen)
+				break;
+		}
+		if (copymap & copymask) {
+			int len = (src[s] >> 2) + ZS_MATCH_MIN;
+			int from = d - (((src[s] & 3) << 8) | src[s+1]);
+
+			s += 2;
+			if (from < 0)
+				break;
+			while (len-- && d < PAGE_SIZE)
+				dst[d++] = dst[from++];
+		} else
+			dst[d++] = src[s++];
+	}
+	if (d < PAGE_SIZE)
+		printk("zswap: bad compressed page\n");
+}
+
+static inline int zs_zero_page(unsigned long * p)
+{
+	int i;
+
+	for (i = 0 ; i < PAGE_SIZE / sizeof(unsigned long) ; i++)
+		if (p[i])
+			return 0;
+	return 1;
+}
+
+/*
+ * Find room for 'len' bytes of packed data.  Chunks are only ever appended
+ * to the open pool page; a page is given back when the last chunk in it
+ * is dropped.
+ */
+static char * zs_alloc(struct zswap_area * za, int len)
+{
+	struct zswap_pool_page * pp = (struct zswap_pool_page *) za->open;
+	unsigned long page;
+
+	len = (len + 3) & ~3;
+	if (!pp || pp->next + len > PAGE_SIZE) {
+		if (za->pages >= za->cap)
+			return NULL;
+		page = __get_free_page(GFP_ATOMIC);
+		if (!page)
+			return NULL;
+		za->pages++;
+		zs_pool++;
+		if (pp && !pp->live) {
+			free_page(za->open);
+			za->pages--;
+			zs_pool--;
+		}
+		pp = (struct zswap_pool_page *) page;
+		pp->live = 0;
+		pp->next = sizeof(struct zswap_pool_page);
+		za->open = page;
+	}
+	pp->live += len;
+	pp->next += len;
+	return (char *) pp + pp->next - len;
+}
+
+static void zs_release(struct zswap_area * za, char * data, int len)
+{
+	unsigned long page = (unsigned long) data & PAGE_MASK;
+	struct zswap_pool_page * pp = (struct zswap_pool_page *) page;
+
+	pp->live -= (len + 3) & ~3;
+	if (!pp->live && page != za->open) {
+		free_page(page);
+		za->pages--;
+		zs_pool--;
+	}
+}
+
+void zswap_drop(struct zswap_area * za, unsigned long offset)
+{
+	struct zswap_slot * zs = za->slots + offset;
+
+	switch (zs->kind) {
+		case ZS_NONE:
+			return;
+		case ZS_PACKED:
+			zs_release(za, zs->data, zs->len);
+			break;
+		case ZS_PAGE:
+			free_page((unsigned long) zs->data);
+			za->pages--;
+			zs_pool--;
+			break;
+	}
+	zs->kind = ZS_NONE;
+	zs->data = NULL;
+	zs->len = 0;
+	zs_stored--;
+}
+
+static void zswap_store(struct zswap_area * za, unsigned long offset, char * buf)
+{
+	struct zswap_slot * zs = za->slots + offset;
+	unsigned long page;
+	int len;
+
+	zswap_drop(za, offset);
+	zs_stored++;
+	if (zs_zero_page((unsigned long *) buf)) {
+		zs->kind = ZS_ZERO;
+		return;
+	}
+	len = zs_compress((unsigned char *) buf, zs_buf,
+		PAGE_SIZE - sizeof(struct zswap_pool_page));
+	if (len > 0 && (zs->data = zs_alloc(za, len)) != NULL) {
+		memcpy(zs->data, zs_buf, len);
+		zs->len = len;
+		zs->kind = ZS_PACKED;
+		return;
+	}
+	/*
+	 * Doesn't compress, or the pool is full.  Keep the page whole: a copy
+	 * if we can get one, else the caller's page itself, which then simply
+	 * stays in memory.
+	 */
+	zs->kind = ZS_PAGE;
+	zs->len = PAGE_SIZE;
+	za->pages++;
+	zs_pool++;
+	page = 0;
+	if (za->pages <= za->cap)
+		page = __get_free_page(GFP_ATOMIC);
+	if (page) {
+		memcpy((void *) page, buf, PAGE_SIZE);
+		zs->data = (char *) page;
+		return;
+	}
+	page = (unsigned long) buf;
+	if (page & ~PAGE_MASK || page >= high_memory) {
+		printk("zswap: can't keep page %08lx\n", page);
+		zs->kind = ZS_NONE;
+		za->pages--;
+		zs_pool--;
+		zs_stored--;
+		return;
+	}
+	mem_map[MAP_NR(page)]++;
+	zs->data = buf;
+}
+
+void zswap_io(struct zswap_area * za, int rw, unsigned long offset, char * buf)
+{
+	struct zswap_slot * zs = za->slots + offset;
+
+	if (rw != READ) {
+		zswap_store(za, offset, buf);
+		return;
+	}
+	switch (zs->kind) {
+		case ZS_ZERO:
+			memset(buf, 0, PAGE_SIZE);
+			break;
+		case ZS_PACKED:
+			zs_decompress((unsigned char *) zs->data, zs->len,
+				(unsigned char *) buf);
+			break;
+		case ZS_PAGE:
+			memcpy(buf, zs->data, PAGE_SIZE);
+			break;
+		default:
+			printk("zswap: reading empty slot %lu\n", offset);
+			memset(buf, 0, PAGE_SIZE);
+	}
+}
+
+int zswap_full(struct zswap_area * za)
+{
+	return za->pages >= za->cap;
+}
+
+struct zswap_area * zswap_create(unsigned long max, unsigned long cap)
+{
+	struct zswap_area * za;
+
+	za = (struct zswap_area *) kmalloc(sizeof(*za), GFP_KERNEL);
+	if (!za)
+		return NULL;
+	za->slots = (struct zswap_slot *) vmalloc(max * sizeof(struct zswap_slot));
+	if (!za->slots) {
+		kfree(za);
+		return NULL;
+	}
+	memset(za->slots, 0, max * sizeof(struct zswap_slot));
+	za->max = max;
+	za->cap = cap;
+	za->pages = 0;
+	za->open = 0;
+	zs_areas++;
+	return za;
+}
+
+/*
+ * Called by swapoff() once every slot has been read back and freed.
+ */
+void zswap_destroy(struct zswap_area * za)
+{
+	unsigned long i;
+
+	for (i = 0 ; i < za->max ; i++)
+		zswap_drop(za, i);
+	if (za->open) {
+		free_page(za->open);
+		zs_pool--;
+	}
+	vfree(za->slots);
+	kfree(za);
+	zs_areas--;
+}
+
+/*
+ * Extra lines for /proc/meminfo.
+ */
+int zswap_get_info(char * buffer)
+{
+	unsigned long ratio;
+
+	if (!zs_areas)
+		return 0;
+	ratio = zs_pool ? zs_stored * 100 / zs_pool : 0;
+	return sprintf(buffer, "ZswapStored: %8lu kB\n"
+		"ZswapPool:   %8lu kB\n"
+		"ZswapRatio:  %5lu.%02lu\n",
+		zs_stored << (PAGE_SHIFT - 10), zs_pool << (PAGE_SHIFT - 10),
+		ratio / 100, ratio % 100);
+}
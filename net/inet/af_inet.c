@@ -1204,6 +1204,99 @@ static int inet_sendto(struct socket *sock, void *ubuf, int size, int noblock,
 			   (struct sockaddr_in *)sin, addr_len));
 }
 
+/*
+ *	Scatter/gather I/O. Protocols without their own sendmsg/recvmsg get
+ *	the pieces one at a time, which is only right for a stream: anything
+ *	else must keep its record boundaries and so takes a single piece.
+ */
+
+static int inet_sendmsg(struct socket *sock, struct msghdr *msg, int len,
+	    int noblock, unsigned flags)
+{
+	struct sock *sk = (struct sock *) sock->data;
+	struct iovec *iov;
+	int sent, err, i;
+
+	if (sk->shutdown & SEND_SHUTDOWN) 
+	{
+		send_sig(SIGPIPE, current, 1);
+		return(-EPIPE);
+	}
+	if(sk->err)
+		return inet_error(sk);
+	/* We may need to bind the socket. */
+	if(inet_autobind(sk)!=0)
+		return -EAGAIN;
+	if (sk->prot->sendmsg)
+		return(sk->prot->sendmsg(sk, msg, len, noblock, flags));
+	if (msg->msg_iovlen != 1 && sk->type != SOCK_STREAM)
+		return(-EOPNOTSUPP);
+	if (msg->msg_name && sk->prot->sendto == NULL)
+		return(-EOPNOTSUPP);
+
+	sent = 0;
+	for (i = 0, iov = msg->msg_iov; i < msg->msg_iovlen; i++, iov++)
+	{
+		if (!iov->iov_len)
+			continue;
+		if (msg->msg_name)
+			err = sk->prot->sendto(sk, (unsigned char *) iov->iov_base,
+				iov->iov_len, noblock, flags,
+				(struct sockaddr_in *) msg->msg_name, msg->msg_namelen);
+		else
+			err = sk->prot->write(sk, (unsigned char *) iov->iov_base,
+				iov->iov_len, noblock, flags);
+		if (err < 0)
+			return(sent ? sent : err);
+		sent += err;
+		if (err < iov->iov_len)
+			break;
+	}
+	return(sent);
+}
+
+
+static int inet_recvmsg(struct socket *sock, struct msghdr *msg, int len,
+	    int noblock, unsigned flags, int *addr_len)
+{
+	struct sock *sk = (struct sock *) sock->data;
+	struct iovec *iov;
+	int copied, err, i;
+
+	if (sk->prot->recvfrom == NULL) 
+		return(-EOPNOTSUPP);
+	if(sk->err)
+		return inet_error(sk);
+	/* We may need to bind the socket. */
+	if(inet_autobind(sk)!=0)
+		return(-EAGAIN);
+	if (sk->prot->recvmsg)
+		return(sk->prot->recvmsg(sk, msg, len, noblock, flags, addr_len));
+	if (msg->msg_iovlen != 1 && sk->type != SOCK_STREAM)
+		return(-EOPNOTSUPP);
+
+	/*
+	 *	Only the first piece may wait for data; after that we take
+	 *	what has already arrived.
+	 */
+
+	copied = 0;
+	for (i = 0, iov = msg->msg_iov; i < msg->msg_iovlen; i++, iov++)
+	{
+		if (!iov->iov_len)
+			continue;
+		err = sk->prot->recvfrom(sk, (unsigned char *) iov->iov_base,
+			iov->iov_len, noblock || copied, flags,
+			(struct sockaddr_in *) msg->msg_name, addr_len);
+		if (err < 0)
+			return(copied ? copied : err);
+		copied += err;
+		if (err < iov->iov_len)
+			break;
+	}
+	return(copied);
+}
+
 
 static int inet_shutdown(struct socket *sock, int how)
 {
@@ -1503,6 +1596,8 @@ static struct proto_ops inet_proto_ops = {
 	inet_setsockopt,
 	inet_getsockopt,
 	inet_fcntl,
+	inet_sendmsg,
+	inet_recvmsg,
 };
 
 extern unsigned long seq_offset;
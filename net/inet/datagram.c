@@ -28,6 +28,7 @@
 #include <linux/mm.h>
 #include <linux/interrupt.h>
 #include <linux/in.h>
+#include <linux/net.h>
 #include <linux/errno.h>
 #include <linux/sched.h>
 #include <linux/inet.h>
@@ -167,6 +168,11 @@ void skb_copy_datagram(struct sk_buff *skb, int offset, char *to, int size)
 	memcpy_tofs(to,skb->h.raw+offset,size);
 }
 
+void skb_copy_datagram_iovec(struct sk_buff *skb, int offset, struct iovec *to, int size)
+{
+	memcpy_toiovec(to,skb->h.raw+offset,size);
+}
+
 /*
  *	Datagram select: Again totally generic. Moved from udp.c
  *	Now does seqpacket.
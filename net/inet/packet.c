@@ -402,6 +402,8 @@ struct proto packet_prot =
 	NULL,
 	NULL,			/* No set/get socket options */
 	NULL,
+	NULL,			/* No scatter/gather */
+	NULL,
 	128,
 	0,
 	{NULL,},
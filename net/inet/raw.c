@@ -311,6 +311,8 @@ struct proto raw_prot = {
 	NULL,
 	ip_setsockopt,
 	ip_getsockopt,
+	NULL,
+	NULL,
 	128,
 	0,
 	{NULL,},
@@ -36,6 +36,7 @@
 #include <linux/config.h>
 
 #include <linux/skbuff.h>	/* struct sk_buff */
+#include <linux/socket.h>	/* struct msghdr */
 #include "protocol.h"		/* struct inet_protocol */
 #ifdef CONFIG_AX25
 #include "ax25.h"
@@ -251,6 +252,11 @@ struct proto {
   				 char *optval, int optlen);
   int			(*getsockopt)(struct sock *sk, int level, int optname,
   				char *optval, int *option);  	 
+  int			(*sendmsg)(struct sock *sk, struct msghdr *msg,
+				   int len, int noblock, unsigned flags);
+  int			(*recvmsg)(struct sock *sk, struct msghdr *msg,
+				   int len, int noblock, unsigned flags,
+				   int *addr_len);
   unsigned short	max_header;
   unsigned long		retransmits;
   struct sock *		sock_array[SOCK_ARRAY_SIZE];
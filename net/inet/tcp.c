@@ -1429,11 +1429,13 @@ extern __inline int tcp_build_header(struct tcphdr *th, struct sock *sk, int pus
 }
 
 /*
- *	This routine copies from a user buffer into a socket,
- *	and starts the transmit system.
+ *	This routine copies from a user iovec into a socket,
+ *	and starts the transmit system. The iovec is consumed as
+ *	we go, so a segment is filled across as many pieces as it
+ *	takes rather than being cut short at the end of each one.
  */
 
-static int tcp_write(struct sock *sk, unsigned char *from,
+static int do_tcp_sendmsg(struct sock *sk, struct iovec *from,
 	  int len, int nonblock, unsigned flags)
 {
 	int copied = 0;
@@ -1571,9 +1573,8 @@ static int tcp_write(struct sock *sk, unsigned char *from,
 			  		copy = 0;
 				}
 	  
-				memcpy_fromfs(skb->data + skb->len, from, copy);
+				memcpy_fromiovec(skb->data + skb->len, from, copy);
 				skb->len += copy;
-				from += copy;
 				copied += copy;
 				len -= copy;
 				sk->write_seq += copy;
@@ -1719,9 +1720,8 @@ static int tcp_write(struct sock *sk, unsigned char *from,
 			((struct tcphdr *)buff)->urg_ptr = ntohs(copy);
 		}
 		skb->len += tmp;
-		memcpy_fromfs(buff+tmp, from, copy);
+		memcpy_fromiovec(buff+tmp, from, copy);
 
-		from += copy;
 		copied += copy;
 		len -= copy;
 		skb->len += copy;
@@ -1758,6 +1758,16 @@ static int tcp_write(struct sock *sk, unsigned char *from,
 	return(copied);
 }
 
+static int tcp_write(struct sock *sk, unsigned char *from,
+	  int len, int nonblock, unsigned flags)
+{
+	struct iovec iov;
+
+	iov.iov_base = from;
+	iov.iov_len = len;
+	return do_tcp_sendmsg(sk, &iov, len, nonblock, flags);
+}
+
 /*
  *	This is just a wrapper. 
  */
@@ -1781,6 +1791,33 @@ static int tcp_sendto(struct sock *sk, unsigned char *from,
 	return tcp_write(sk, from, len, nonblock, flags);
 }
 
+/*
+ *	sendmsg()/writev(): the whole iovec goes out as one stream.
+ */
+
+static int tcp_sendmsg(struct sock *sk, struct msghdr *msg,
+	  int len, int nonblock, unsigned flags)
+{
+	struct sockaddr_in *addr = (struct sockaddr_in *) msg->msg_name;
+
+	if (flags & ~(MSG_OOB|MSG_DONTROUTE))
+		return -EINVAL;
+	if (addr) 
+	{
+		if (sk->state == TCP_CLOSE)
+			return -ENOTCONN;
+		if (msg->msg_namelen < sizeof(*addr))
+			return -EINVAL;
+		if (addr->sin_family && addr->sin_family != AF_INET) 
+			return -EINVAL;
+		if (addr->sin_port != sk->dummy_th.dest) 
+			return -EISCONN;
+		if (addr->sin_addr.s_addr != sk->daddr) 
+			return -EISCONN;
+	}
+	return do_tcp_sendmsg(sk, msg->msg_iov, len, nonblock, flags);
+}
+
 
 /*
  *	Send an ack if one is backlogged at this point. Ought to merge
@@ -5089,6 +5126,8 @@ struct proto tcp_prot = {
 	tcp_shutdown,
 	tcp_setsockopt,
 	tcp_getsockopt,
+	tcp_sendmsg,
+	NULL,
 	128,
 	0,
 	{NULL,},
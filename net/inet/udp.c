@@ -54,6 +54,7 @@
 #include <linux/sched.h>
 #include <linux/fcntl.h>
 #include <linux/socket.h>
+#include <linux/net.h>
 #include <linux/sockios.h>
 #include <linux/in.h>
 #include <linux/errno.h>
@@ -249,7 +250,7 @@ static void udp_send_check(struct udphdr *uh, unsigned long saddr,
 
 
 static int udp_send(struct sock *sk, struct sockaddr_in *sin,
-	 unsigned char *from, int len, int rt)
+	 struct iovec *iov, int len, int rt)
 {
 	struct sk_buff *skb;
 	struct device *dev;
@@ -317,10 +318,10 @@ static int udp_send(struct sock *sk, struct sockaddr_in *sin,
 	buff = (unsigned char *) (uh + 1);
 
 	/*
-	 *	Copy the user data. 
+	 *	Copy the user data, gathering it from all the pieces. 
 	 */
 	 
-	memcpy_fromfs(buff, from, len);
+	memcpy_fromiovec(buff, iov, len);
 
   	/*
   	 *	Set up the UDP checksum. 
@@ -339,7 +340,12 @@ static int udp_send(struct sock *sk, struct sockaddr_in *sin,
 }
 
 
-static int udp_sendto(struct sock *sk, unsigned char *from, int len, int noblock,
+/*
+ *	Send one datagram gathered from an iovec. This is the common tail of
+ *	sendto() and sendmsg().
+ */
+
+static int udp_sendiov(struct sock *sk, struct iovec *iov, int len,
 	   unsigned flags, struct sockaddr_in *usin, int addr_len)
 {
 	struct sockaddr_in sin;
@@ -387,13 +393,36 @@ static int udp_sendto(struct sock *sk, unsigned char *from, int len, int noblock
 	sk->inuse = 1;
 
 	/* Send the packet. */
-	tmp = udp_send(sk, &sin, from, len, flags);
+	tmp = udp_send(sk, &sin, iov, len, flags);
 
 	/* The datagram has been sent off.  Release the socket. */
 	release_sock(sk);
 	return(tmp);
 }
 
+
+static int udp_sendto(struct sock *sk, unsigned char *from, int len, int noblock,
+	   unsigned flags, struct sockaddr_in *usin, int addr_len)
+{
+	struct iovec iov;
+
+	iov.iov_base = from;
+	iov.iov_len = len;
+	return(udp_sendiov(sk, &iov, len, flags, usin, addr_len));
+}
+
+
+/*
+ *	Scatter/gather send: the pieces of the iovec make up one datagram.
+ */
+
+static int udp_sendmsg(struct sock *sk, struct msghdr *msg, int len, int noblock,
+	   unsigned flags)
+{
+	return(udp_sendiov(sk, msg->msg_iov, len, flags,
+		(struct sockaddr_in *) msg->msg_name, msg->msg_namelen));
+}
+
 /*
  *	In BSD SOCK_DGRAM a write is just like a send.
  */
@@ -464,10 +493,10 @@ int udp_ioctl(struct sock *sk, int cmd, unsigned long arg)
  * 	return it, otherwise we block.
  */
 
-int udp_recvfrom(struct sock *sk, unsigned char *to, int len,
-	     int noblock, unsigned flags, struct sockaddr_in *sin,
-	     int *addr_len)
+int udp_recvmsg(struct sock *sk, struct msghdr *msg, int len,
+	     int noblock, unsigned flags, int *addr_len)
 {
+	struct sockaddr_in *sin = (struct sockaddr_in *) msg->msg_name;
   	int copied = 0;
   	int truesize;
   	struct sk_buff *skb;
@@ -496,7 +525,7 @@ int udp_recvfrom(struct sock *sk, unsigned char *to, int len,
   	 *	FIXME : should use udp header size info value 
   	 */
   	 
-	skb_copy_datagram(skb,sizeof(struct udphdr),to,copied);
+	skb_copy_datagram_iovec(skb,sizeof(struct udphdr),msg->msg_iov,copied);
 	sk->stamp=skb->stamp;
 
 	/* Copy the address. */
@@ -512,6 +541,22 @@ int udp_recvfrom(struct sock *sk, unsigned char *to, int len,
   	return(truesize);
 }
 
+
+int udp_recvfrom(struct sock *sk, unsigned char *to, int len,
+	     int noblock, unsigned flags, struct sockaddr_in *sin,
+	     int *addr_len)
+{
+	struct msghdr msg;
+	struct iovec iov;
+
+	iov.iov_base = to;
+	iov.iov_len = len;
+	msg.msg_name = sin;
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	return(udp_recvmsg(sk, &msg, len, noblock, flags, addr_len));
+}
+
 /*
  *	Read has the same semantics as recv in SOCK_DGRAM
  */
@@ -726,6 +771,8 @@ struct proto udp_prot = {
 	NULL,
 	ip_setsockopt,
 	ip_getsockopt,
+	udp_sendmsg,
+	udp_recvmsg,
 	128,
 	0,
 	{NULL,},
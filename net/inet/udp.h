@@ -36,6 +36,9 @@ extern void	udp_err(int err, unsigned char *header, unsigned long daddr,
 extern int	udp_recvfrom(struct sock *sk, unsigned char *to,
 			     int len, int noblock, unsigned flags,
 			     struct sockaddr_in *sin, int *addr_len);
+extern int	udp_recvmsg(struct sock *sk, struct msghdr *msg,
+			    int len, int noblock, unsigned flags,
+			    int *addr_len);
 extern int	udp_read(struct sock *sk, unsigned char *buff,
 			 int len, int noblock, unsigned flags);
 extern int	udp_connect(struct sock *sk,
@@ -73,6 +73,10 @@ static int sock_write(struct inode *inode, struct file *file, char *buf,
 		      int size);
 static int sock_readdir(struct inode *inode, struct file *file,
 			struct dirent *dirent, int count);
+static int sock_readv(struct inode *inode, struct file *file,
+		      struct iovec *iov, int count);
+static int sock_writev(struct inode *inode, struct file *file,
+		       struct iovec *iov, int count);
 static void sock_close(struct inode *inode, struct file *file);
 static int sock_select(struct inode *inode, struct file *file, int which, select_table *seltable);
 static int sock_ioctl(struct inode *inode, struct file *file,
@@ -97,7 +101,11 @@ static struct file_operations socket_file_ops = {
 	NULL,			/* no special open code... */
 	sock_close,
 	NULL,			/* no fsync */
-	sock_fasync
+	sock_fasync,
+	NULL,			/* check_media_change */
+	NULL,			/* revalidate */
+	sock_readv,
+	sock_writev
 };
 
 /*
@@ -152,6 +160,90 @@ static int move_addr_to_user(void *kaddr, int klen, void *uaddr, int *ulen)
  	return 0;
 }
 
+/*
+ *	Copy data between the kernel and a user iovec whose pieces have
+ *	already been verified. The iovec is a kernel copy and is consumed
+ *	as we go, so a later call carries on where the last one stopped.
+ */
+
+void memcpy_fromiovec(unsigned char *to, struct iovec *iov, int len)
+{
+	int copy;
+
+	while(len>0)
+	{
+		if(iov->iov_len)
+		{
+			copy=(len<iov->iov_len)?len:iov->iov_len;
+			memcpy_fromfs(to,iov->iov_base,copy);
+			to+=copy;
+			len-=copy;
+			iov->iov_base=(char *)iov->iov_base+copy;
+			iov->iov_len-=copy;
+		}
+		iov++;
+	}
+}
+
+void memcpy_toiovec(struct iovec *iov, unsigned char *from, int len)
+{
+	int copy;
+
+	while(len>0)
+	{
+		if(iov->iov_len)
+		{
+			copy=(len<iov->iov_len)?len:iov->iov_len;
+			memcpy_tofs(iov->iov_base,from,copy);
+			from+=copy;
+			len-=copy;
+			iov->iov_base=(char *)iov->iov_base+copy;
+			iov->iov_len-=copy;
+		}
+		iov++;
+	}
+}
+
+/*
+ *	Bring a user msghdr and its iovec into the kernel, checking that
+ *	every piece can be accessed. The kernel msghdr is pointed at the
+ *	kernel copy of the iovec. Returns the total length of the pieces.
+ */
+
+static int move_msghdr_to_kernel(struct msghdr *umsg, struct msghdr *msg,
+	struct iovec *iov, int type)
+{
+	int err;
+	int len;
+	int i;
+
+	if((err=verify_area(VERIFY_READ,umsg,sizeof(*umsg)))<0)
+		return err;
+	memcpy_fromfs(msg,umsg,sizeof(*msg));
+	if(msg->msg_accrightslen)
+		return -EOPNOTSUPP;
+	if(msg->msg_iovlen<=0 || msg->msg_iovlen>UIO_MAXIOV)
+		return -EINVAL;
+	if((err=verify_area(VERIFY_READ,msg->msg_iov,
+			msg->msg_iovlen*sizeof(struct iovec)))<0)
+		return err;
+	memcpy_fromfs(iov,msg->msg_iov,msg->msg_iovlen*sizeof(struct iovec));
+	msg->msg_iov=iov;
+	len=0;
+	for(i=0;i<msg->msg_iovlen;i++)
+	{
+		if(iov[i].iov_len<0)
+			return -EINVAL;
+		if(iov[i].iov_len &&
+			(err=verify_area(type,iov[i].iov_base,iov[i].iov_len))<0)
+			return err;
+		len+=iov[i].iov_len;
+		if(len<0)
+			return -EINVAL;
+	}
+	return len;
+}
+
 /*
  *	Obtains the first available file descriptor and sets it up for use. 
  */
@@ -169,17 +261,14 @@ static int get_fd(struct inode *inode)
 	if (!file) 
 		return(-1);
 
-	for (fd = 0; fd < NR_OPEN; ++fd)
-		if (!current->files->fd[fd]) 
-			break;
-	if (fd == NR_OPEN) 
+	fd = get_unused_fd(0);
+	if (fd < 0) 
 	{
-		file->f_count = 0;
+		put_filp(file);
 		return(-1);
 	}
 
-	FD_CLR(fd, &current->files->close_on_exec);
-		current->files->fd[fd] = file;
+	fd_install(fd, file);
 	file->f_op = &socket_file_ops;
 	file->f_mode = 3;
 	file->f_flags = O_RDWR;
@@ -212,7 +301,7 @@ static inline struct socket *sockfd_lookup(int fd, struct file **pfile)
 	struct file *file;
 	struct inode *inode;
 
-	if (fd < 0 || fd >= NR_OPEN || !(file = current->files->fd[fd])) 
+	if (fd < 0 || fd >= current->files->max_fds || !(file = current->files->fd[fd])) 
 		return NULL;
 
 	inode = file->f_inode;
@@ -366,6 +455,108 @@ static int sock_write(struct inode *inode, struct file *file, char *ubuf, int si
 	return(sock->ops->write(sock, ubuf, size,(file->f_flags & O_NONBLOCK)));
 }
 
+/*
+ *	readv/writev on a socket. The pieces have been checked by the caller
+ *	and are passed down as one message, so a stream protocol with a
+ *	sendmsg operation can fill whole segments across them. Families
+ *	without sendmsg/recvmsg take the pieces one at a time.
+ */
+
+static int sock_readv(struct inode *inode, struct file *file,
+	struct iovec *iov, int count)
+{
+	struct socket *sock;
+	struct msghdr msg;
+	char address[MAX_SOCK_ADDR];
+	int nonblock = (file->f_flags & O_NONBLOCK);
+	int len, alen, err, i;
+
+	if (!(sock = socki_lookup(inode))) 
+	{
+		printk("NET: sock_readv: can't find socket for inode!\n");
+		return(-EBADF);
+	}
+	if (sock->flags & SO_ACCEPTCON) 
+		return(-EINVAL);
+
+	len=0;
+	for(i=0;i<count;i++)
+		len+=iov[i].iov_len;
+	if(sock->ops->recvmsg)
+	{
+		msg.msg_name=address;
+		msg.msg_namelen=sizeof(address);
+		msg.msg_iov=iov;
+		msg.msg_iovlen=count;
+		msg.msg_accrights=NULL;
+		msg.msg_accrightslen=0;
+		alen=0;
+		return(sock->ops->recvmsg(sock, &msg, len, nonblock, 0, &alen));
+	}
+
+	/* Only the first piece may wait for data. */
+	len=0;
+	for(i=0;i<count;i++)
+	{
+		if(!iov[i].iov_len)
+			continue;
+		err=sock->ops->read(sock, iov[i].iov_base, iov[i].iov_len,
+			nonblock || len);
+		if(err<0)
+			return(len ? len : err);
+		len+=err;
+		if(err<iov[i].iov_len)
+			break;
+	}
+	return(len);
+}
+
+static int sock_writev(struct inode *inode, struct file *file,
+	struct iovec *iov, int count)
+{
+	struct socket *sock;
+	struct msghdr msg;
+	int nonblock = (file->f_flags & O_NONBLOCK);
+	int len, err, i;
+
+	if (!(sock = socki_lookup(inode))) 
+	{
+		printk("NET: sock_writev: can't find socket for inode!\n");
+		return(-EBADF);
+	}
+	if (sock->flags & SO_ACCEPTCON) 
+		return(-EINVAL);
+
+	len=0;
+	for(i=0;i<count;i++)
+		len+=iov[i].iov_len;
+	if(sock->ops->sendmsg)
+	{
+		msg.msg_name=NULL;
+		msg.msg_namelen=0;
+		msg.msg_iov=iov;
+		msg.msg_iovlen=count;
+		msg.msg_accrights=NULL;
+		msg.msg_accrightslen=0;
+		return(sock->ops->sendmsg(sock, &msg, len, nonblock, 0));
+	}
+
+	len=0;
+	for(i=0;i<count;i++)
+	{
+		if(!iov[i].iov_len)
+			continue;
+		err=sock->ops->write(sock, iov[i].iov_base, iov[i].iov_len,
+			nonblock);
+		if(err<0)
+			return(len ? len : err);
+		len+=err;
+		if(err<iov[i].iov_len)
+			break;
+	}
+	return(len);
+}
+
 /*
  *	You can't read directories from a socket!
  */
@@ -735,7 +926,7 @@ static int sock_bind(int fd, struct sockaddr *umyaddr, int addrlen)
 	char address[MAX_SOCK_ADDR];
 	int err;
 
-	if (fd < 0 || fd >= NR_OPEN || current->files->fd[fd] == NULL)
+	if (fd < 0 || fd >= current->files->max_fds || current->files->fd[fd] == NULL)
 		return(-EBADF);
 	
 	if (!(sock = sockfd_lookup(fd, NULL))) 
@@ -762,7 +953,7 @@ static int sock_listen(int fd, int backlog)
 {
 	struct socket *sock;
 
-	if (fd < 0 || fd >= NR_OPEN || current->files->fd[fd] == NULL)
+	if (fd < 0 || fd >= current->files->max_fds || current->files->fd[fd] == NULL)
 		return(-EBADF);
 	if (!(sock = sockfd_lookup(fd, NULL))) 
 		return(-ENOTSOCK);
@@ -795,7 +986,7 @@ static int sock_accept(int fd, struct sockaddr *upeer_sockaddr, int *upeer_addrl
 	char address[MAX_SOCK_ADDR];
 	int len;
 
-	if (fd < 0 || fd >= NR_OPEN || ((file = current->files->fd[fd]) == NULL))
+	if (fd < 0 || fd >= current->files->max_fds || ((file = current->files->fd[fd]) == NULL))
 		return(-EBADF);
   	if (!(sock = sockfd_lookup(fd, &file))) 
 		return(-ENOTSOCK);
@@ -857,7 +1048,7 @@ static int sock_connect(int fd, struct sockaddr *uservaddr, int addrlen)
 	char address[MAX_SOCK_ADDR];
 	int err;
 
-	if (fd < 0 || fd >= NR_OPEN || (file=current->files->fd[fd]) == NULL)
+	if (fd < 0 || fd >= current->files->max_fds || (file=current->files->fd[fd]) == NULL)
 		return(-EBADF);
 	if (!(sock = sockfd_lookup(fd, &file)))
 		return(-ENOTSOCK);
@@ -907,7 +1098,7 @@ static int sock_getsockname(int fd, struct sockaddr *usockaddr, int *usockaddr_l
 	int len;
 	int err;
 	
-	if (fd < 0 || fd >= NR_OPEN || current->files->fd[fd] == NULL)
+	if (fd < 0 || fd >= current->files->max_fds || current->files->fd[fd] == NULL)
 		return(-EBADF);
 	if (!(sock = sockfd_lookup(fd, NULL)))
 		return(-ENOTSOCK);
@@ -932,7 +1123,7 @@ static int sock_getpeername(int fd, struct sockaddr *usockaddr, int *usockaddr_l
 	int len;
 	int err;
 
-	if (fd < 0 || fd >= NR_OPEN || current->files->fd[fd] == NULL)
+	if (fd < 0 || fd >= current->files->max_fds || current->files->fd[fd] == NULL)
 		return(-EBADF);
 	if (!(sock = sockfd_lookup(fd, NULL)))
 		return(-ENOTSOCK);
@@ -956,7 +1147,7 @@ static int sock_send(int fd, void * buff, int len, unsigned flags)
 	struct file *file;
 	int err;
 
-	if (fd < 0 || fd >= NR_OPEN || ((file = current->files->fd[fd]) == NULL))
+	if (fd < 0 || fd >= current->files->max_fds || ((file = current->files->fd[fd]) == NULL))
 		return(-EBADF);
 	if (!(sock = sockfd_lookup(fd, NULL))) 
 		return(-ENOTSOCK);
@@ -983,7 +1174,7 @@ static int sock_sendto(int fd, void * buff, int len, unsigned flags,
 	char address[MAX_SOCK_ADDR];
 	int err;
 	
-	if (fd < 0 || fd >= NR_OPEN || ((file = current->files->fd[fd]) == NULL))
+	if (fd < 0 || fd >= current->files->max_fds || ((file = current->files->fd[fd]) == NULL))
 		return(-EBADF);
 	if (!(sock = sockfd_lookup(fd, NULL)))
 		return(-ENOTSOCK);
@@ -1016,7 +1207,7 @@ static int sock_recv(int fd, void * buff, int len, unsigned flags)
 	struct file *file;
 	int err;
 
-	if (fd < 0 || fd >= NR_OPEN || ((file = current->files->fd[fd]) == NULL))
+	if (fd < 0 || fd >= current->files->max_fds || ((file = current->files->fd[fd]) == NULL))
 		return(-EBADF);
 
 	if (!(sock = sockfd_lookup(fd, NULL))) 
@@ -1047,7 +1238,7 @@ static int sock_recvfrom(int fd, void * buff, int len, unsigned flags,
 	char address[MAX_SOCK_ADDR];
 	int err;
 	int alen;
-	if (fd < 0 || fd >= NR_OPEN || ((file = current->files->fd[fd]) == NULL))
+	if (fd < 0 || fd >= current->files->max_fds || ((file = current->files->fd[fd]) == NULL))
 		return(-EBADF);
 	if (!(sock = sockfd_lookup(fd, NULL))) 
 	  	return(-ENOTSOCK);
@@ -1071,6 +1262,186 @@ static int sock_recvfrom(int fd, void * buff, int len, unsigned flags,
 	return len;
 }
 
+/*
+ *	Send one message described by a user msghdr. Protocols without a
+ *	sendmsg operation can still take a single piece through send/sendto.
+ */
+
+static int do_sendmsg(struct socket *sock, struct msghdr *umsg, int nonblock,
+	unsigned flags)
+{
+	struct msghdr msg;
+	struct iovec iov[UIO_MAXIOV];
+	char address[MAX_SOCK_ADDR];
+	int len;
+	int err;
+
+	len=move_msghdr_to_kernel(umsg,&msg,iov,VERIFY_READ);
+	if(len<0)
+		return len;
+	if(msg.msg_name!=NULL)
+	{
+		if((err=move_addr_to_kernel(msg.msg_name,msg.msg_namelen,address))<0)
+			return err;
+		msg.msg_name=address;
+	}
+	else
+		msg.msg_namelen=0;
+
+	if(sock->ops->sendmsg)
+		return(sock->ops->sendmsg(sock, &msg, len, nonblock, flags));
+	if(msg.msg_iovlen!=1)
+		return -EOPNOTSUPP;
+	if(msg.msg_name==NULL)
+		return(sock->ops->send(sock, iov[0].iov_base, len, nonblock, flags));
+	return(sock->ops->sendto(sock, iov[0].iov_base, len, nonblock, flags,
+		(struct sockaddr *)address, msg.msg_namelen));
+}
+
+/*
+ *	Receive one message into a user msghdr, handing the sender's address
+ *	back through msg_name/msg_namelen if one was asked for.
+ */
+
+static int do_recvmsg(struct socket *sock, struct msghdr *umsg, int nonblock,
+	unsigned flags)
+{
+	struct msghdr msg;
+	struct iovec iov[UIO_MAXIOV];
+	char address[MAX_SOCK_ADDR];
+	void *uaddr;
+	int len;
+	int alen=0;
+	int err;
+
+	len=move_msghdr_to_kernel(umsg,&msg,iov,VERIFY_WRITE);
+	if(len<0)
+		return len;
+	uaddr=msg.msg_name;
+	msg.msg_name=address;
+	msg.msg_namelen=sizeof(address);
+
+	if(sock->ops->recvmsg)
+		len=sock->ops->recvmsg(sock, &msg, len, nonblock, flags, &alen);
+	else if(msg.msg_iovlen==1)
+		len=sock->ops->recvfrom(sock, iov[0].iov_base, len, nonblock,
+			flags, (struct sockaddr *)address, &alen);
+	else
+		return -EOPNOTSUPP;
+
+	if(len<0)
+		return len;
+	if(uaddr!=NULL && (err=move_addr_to_user(address,alen,uaddr,&umsg->msg_namelen))<0)
+		return err;
+	return len;
+}
+
+static int sock_sendmsg(int fd, struct msghdr *msg, unsigned flags)
+{
+	struct socket *sock;
+	struct file *file;
+
+	if (fd < 0 || fd >= current->files->max_fds || ((file = current->files->fd[fd]) == NULL))
+		return(-EBADF);
+	if (!(sock = sockfd_lookup(fd, NULL)))
+		return(-ENOTSOCK);
+
+	return(do_sendmsg(sock, msg, (file->f_flags & O_NONBLOCK), flags));
+}
+
+static int sock_recvmsg(int fd, struct msghdr *msg, unsigned flags)
+{
+	struct socket *sock;
+	struct file *file;
+
+	if (fd < 0 || fd >= current->files->max_fds || ((file = current->files->fd[fd]) == NULL))
+		return(-EBADF);
+	if (!(sock = sockfd_lookup(fd, NULL)))
+		return(-ENOTSOCK);
+
+	return(do_recvmsg(sock, msg, (file->f_flags & O_NONBLOCK), flags));
+}
+
+/*
+ *	Send a batch of messages in one call. Each message's length goes back
+ *	in its msg_len. We stop at the first error and return the number of
+ *	messages sent, or the error if there were none. At most UIO_MAXMMSG
+ *	messages go in one call.
+ */
+
+static int sock_sendmmsg(int fd, struct mmsghdr *vec, unsigned int vlen,
+	unsigned flags)
+{
+	struct socket *sock;
+	struct file *file;
+	int err=0;
+	int i;
+
+	if (fd < 0 || fd >= current->files->max_fds || ((file = current->files->fd[fd]) == NULL))
+		return(-EBADF);
+	if (!(sock = sockfd_lookup(fd, NULL)))
+		return(-ENOTSOCK);
+	if (vlen > UIO_MAXMMSG)
+		vlen = UIO_MAXMMSG;
+
+	for(i=0;i<vlen;i++)
+	{
+		if (need_resched)
+			schedule();
+		if(i && (current->signal & ~current->blocked))
+			break;
+		err=verify_area(VERIFY_WRITE,&vec[i].msg_len,sizeof(vec[i].msg_len));
+		if(err)
+			break;
+		err=do_sendmsg(sock, &vec[i].msg_hdr, (file->f_flags & O_NONBLOCK), flags);
+		if(err<0)
+			break;
+		put_fs_long(err,(unsigned long *)&vec[i].msg_len);
+	}
+	if(i)
+		return i;
+	return err;
+}
+
+/*
+ *	Receive a batch of messages. Only the first one may block: after
+ *	that we take what is already queued and return. The batch is capped
+ *	at UIO_MAXMMSG like the send side.
+ */
+
+static int sock_recvmmsg(int fd, struct mmsghdr *vec, unsigned int vlen,
+	unsigned flags)
+{
+	struct socket *sock;
+	struct file *file;
+	int err=0;
+	int i;
+
+	if (fd < 0 || fd >= current->files->max_fds || ((file = current->files->fd[fd]) == NULL))
+		return(-EBADF);
+	if (!(sock = sockfd_lookup(fd, NULL)))
+		return(-ENOTSOCK);
+	if (vlen > UIO_MAXMMSG)
+		vlen = UIO_MAXMMSG;
+
+	for(i=0;i<vlen;i++)
+	{
+		if (need_resched)
+			schedule();
+		err=verify_area(VERIFY_WRITE,&vec[i].msg_len,sizeof(vec[i].msg_len));
+		if(err)
+			break;
+		err=do_recvmsg(sock, &vec[i].msg_hdr,
+			(file->f_flags & O_NONBLOCK) || i, flags);
+		if(err<0)
+			break;
+		put_fs_long(err,(unsigned long *)&vec[i].msg_len);
+	}
+	if(i)
+		return i;
+	return err;
+}
+
 /*
  *	Set a socket option. Because we don't know the option lengths we have
  *	to pass the user mode parameter for the protocols to sort out.
@@ -1081,7 +1452,7 @@ static int sock_setsockopt(int fd, int level, int optname, char *optval, int opt
 	struct socket *sock;
 	struct file *file;
 	
-	if (fd < 0 || fd >= NR_OPEN || ((file = current->files->fd[fd]) == NULL))
+	if (fd < 0 || fd >= current->files->max_fds || ((file = current->files->fd[fd]) == NULL))
 		return(-EBADF);
 	if (!(sock = sockfd_lookup(fd, NULL))) 
 		return(-ENOTSOCK);
@@ -1099,7 +1470,7 @@ static int sock_getsockopt(int fd, int level, int optname, char *optval, int *op
 	struct socket *sock;
 	struct file *file;
 
-	if (fd < 0 || fd >= NR_OPEN || ((file = current->files->fd[fd]) == NULL))
+	if (fd < 0 || fd >= current->files->max_fds || ((file = current->files->fd[fd]) == NULL))
 		return(-EBADF);
 	if (!(sock = sockfd_lookup(fd, NULL)))
 		return(-ENOTSOCK);
@@ -1119,7 +1490,7 @@ static int sock_shutdown(int fd, int how)
 	struct socket *sock;
 	struct file *file;
 
-	if (fd < 0 || fd >= NR_OPEN || ((file = current->files->fd[fd]) == NULL))
+	if (fd < 0 || fd >= current->files->max_fds || ((file = current->files->fd[fd]) == NULL))
 		return(-EBADF);
 	if (!(sock = sockfd_lookup(fd, NULL))) 
 		return(-ENOTSOCK);
@@ -1274,6 +1645,36 @@ asmlinkage int sys_socketcall(int call, unsigned long *args)
 				get_fs_long(args+2),
 				(char *)get_fs_long(args+3),
 				(int *)get_fs_long(args+4)));
+		case SYS_SENDMSG:
+			er=verify_area(VERIFY_READ, args, 3*sizeof(unsigned long));
+			if(er)
+				return er;
+			return(sock_sendmsg(get_fs_long(args+0),
+				(struct msghdr *)get_fs_long(args+1),
+				get_fs_long(args+2)));
+		case SYS_RECVMSG:
+			er=verify_area(VERIFY_READ, args, 3*sizeof(unsigned long));
+			if(er)
+				return er;
+			return(sock_recvmsg(get_fs_long(args+0),
+				(struct msghdr *)get_fs_long(args+1),
+				get_fs_long(args+2)));
+		case SYS_RECVMMSG:
+			er=verify_area(VERIFY_READ, args, 4*sizeof(unsigned long));
+			if(er)
+				return er;
+			return(sock_recvmmsg(get_fs_long(args+0),
+				(struct mmsghdr *)get_fs_long(args+1),
+				get_fs_long(args+2),
+				get_fs_long(args+3)));
+		case SYS_SENDMMSG:
+			er=verify_area(VERIFY_READ, args, 4*sizeof(unsigned long));
+			if(er)
+				return er;
+			return(sock_sendmmsg(get_fs_long(args+0),
+				(struct mmsghdr *)get_fs_long(args+1),
+				get_fs_long(args+2),
+				get_fs_long(args+3)));
 		default:
 			return(-EINVAL);
 	}
@@ -42,6 +42,7 @@
 #include <linux/net.h>
 #include <linux/fs.h>
 #include <linux/malloc.h>
+#include <linux/mm.h>
 
 #include <asm/system.h>
 #include <asm/segment.h>
@@ -57,6 +58,13 @@
  
 struct unix_proto_data unix_datas[NSOCKETS_UNIX];
 
+/*
+ *	Bound sockets hashed by inode, so connect() doesn't have to scan
+ *	the whole of unix_datas[].
+ */
+
+static struct unix_proto_data *unix_hash[UN_HASH_SIZE];
+
 static int unix_proto_create(struct socket *sock, int protocol);
 static int unix_proto_dup(struct socket *newsock, struct socket *oldsock);
 static int unix_proto_release(struct socket *sock, struct socket *peer);
@@ -139,20 +147,72 @@ static int unix_proto_listen(struct socket *sock, int backlog)
 }
 
 /*
- *	Until the new NET3 Unix code is done we have no options.
+ *	The only options we have are the buffer sizes. SO_RCVBUF limits
+ *	how much may queue on this socket, SO_SNDBUF how much we will
+ *	queue at our peer.
  */
 
 static int unix_proto_setsockopt(struct socket *sock, int level, int optname,
 		      char *optval, int optlen)
 {
-	return(-EOPNOTSUPP);
+	struct unix_proto_data *upd = UN_DATA(sock);
+	int val;
+	int err;
+
+	if (level != SOL_SOCKET)
+		return(-EOPNOTSUPP);
+	if (optval == NULL)
+		return(-EINVAL);
+	err=verify_area(VERIFY_READ, optval, sizeof(int));
+	if(err)
+		return err;
+	val = get_fs_long((unsigned long *)optval);
+	if (val > UN_MAX_BUF)
+		val = UN_MAX_BUF;
+	if (val < PAGE_SIZE)
+		val = PAGE_SIZE;
+	switch(optname)
+	{
+		case SO_SNDBUF:
+			upd->sndbuf = val;
+			return(0);
+		case SO_RCVBUF:
+			upd->rcvbuf = val;
+			return(0);
+	}
+	return(-ENOPROTOOPT);
 }
 
 
 static int unix_proto_getsockopt(struct socket *sock, int level, int optname,
 		      char *optval, int *optlen)
 {
-	return(-EOPNOTSUPP);
+	struct unix_proto_data *upd = UN_DATA(sock);
+	int val;
+	int err;
+
+	if (level != SOL_SOCKET)
+		return(-EOPNOTSUPP);
+	switch(optname)
+	{
+		case SO_SNDBUF:
+			val = upd->sndbuf;
+			break;
+		case SO_RCVBUF:
+			val = upd->rcvbuf;
+			break;
+		default:
+			return(-ENOPROTOOPT);
+	}
+	err=verify_area(VERIFY_WRITE, optlen, sizeof(int));
+	if(err)
+		return err;
+	put_fs_long(sizeof(int),(unsigned long *) optlen);
+	err=verify_area(VERIFY_WRITE, optval, sizeof(int));
+	if(err)
+		return err;
+	put_fs_long(val,(unsigned long *)optval);
+	return(0);
 }
 
 
@@ -207,6 +267,30 @@ static int unix_proto_recv(struct socket *sock, void *buff, int len, int nonbloc
 	return(unix_proto_read(sock, (char *) buff, len, nonblock));
 }
 
+static void unix_hash_insert(struct unix_proto_data *upd)
+{
+	struct unix_proto_data **p = &unix_hash[UN_HASH(upd->inode)];
+
+	upd->hnext = *p;
+	*p = upd;
+}
+
+
+static void unix_hash_remove(struct unix_proto_data *upd)
+{
+	struct unix_proto_data **p = &unix_hash[UN_HASH(upd->inode)];
+
+	for (; *p; p = &(*p)->hnext)
+	{
+		if (*p == upd)
+		{
+			*p = upd->hnext;
+			break;
+		}
+	}
+	upd->hnext = NULL;
+}
+
 /*
  *	Given an address and an inode go find a unix control structure
  */
@@ -217,7 +301,7 @@ unix_data_lookup(struct sockaddr_un *sockun, int sockaddr_len,
 {
 	 struct unix_proto_data *upd;
 
-	 for(upd = unix_datas; upd <= last_unix_data; ++upd) 
+	 for(upd = unix_hash[UN_HASH(inode)]; upd; upd = upd->hnext) 
 	 {
 		if (upd->refcnt > 0 && upd->socket &&
 			upd->socket->state == SS_UNCONNECTED &&
@@ -230,10 +314,9 @@ unix_data_lookup(struct sockaddr_un *sockun, int sockaddr_len,
 }
 
 /*
- *	We allocate a page of data for the socket. This is woefully inadequate and helps cause vast
- *	amounts of excess task switching and blocking when transferring stuff like bitmaps via X.
- *	It doesn't help this problem that the Linux scheduler is desperately in need of a major 
- *	rewrite. Somewhere near 16K would be better maybe 32.
+ *	Buffer pages are no longer allocated here: the writer grows the
+ *	queue a page at a time up to rcvbuf, so a bulk transfer like an X
+ *	bitmap no longer blocks every 4K.
  */
 
 static struct unix_proto_data *
@@ -251,10 +334,13 @@ unix_data_alloc(void)
 			upd->socket = NULL;
 			upd->sockaddr_len = 0;
 			upd->sockaddr_un.sun_family = 0;
-			upd->buf = NULL;
-			upd->bp_head = upd->bp_tail = 0;
+			upd->q_head = upd->q_tail = NULL;
+			upd->q_rd = upd->q_wr = upd->q_len = 0;
+			upd->rcvbuf = upd->sndbuf = UN_DEFAULT_BUF;
+			upd->rd_task = NULL;
 			upd->inode = NULL;
 			upd->peerupd = NULL;
+			upd->hnext = NULL;
 			return(upd);
 		}
 	}
@@ -287,20 +373,22 @@ static void unix_data_deref(struct unix_proto_data *upd)
 	}
 	if (upd->refcnt == 1) 
 	{
-		if (upd->buf) 
+		struct unix_buf *ub;
+
+		while ((ub = upd->q_head) != NULL)
 		{
-			free_page((unsigned long)upd->buf);
-			upd->buf = NULL;
-			upd->bp_head = upd->bp_tail = 0;
+			upd->q_head = ub->next;
+			free_page((unsigned long) ub);
 		}
+		upd->q_tail = NULL;
+		upd->q_rd = upd->q_wr = upd->q_len = 0;
 	}
 	--upd->refcnt;
 }
 
 
 /*
- *	Upon a create, we allocate an empty protocol data,
- *	and grab a page to buffer writes.
+ *	Upon a create, we allocate an empty protocol data.
  */
  
 static int unix_proto_create(struct socket *sock, int protocol)
@@ -321,12 +409,6 @@ static int unix_proto_create(struct socket *sock, int protocol)
 		printk("UNIX: create: can't allocate buffer\n");
 		return(-ENOMEM);
 	}
-	if (!(upd->buf = (char*) get_free_page(GFP_USER))) 
-	{
-		printk("UNIX: create: can't get page!\n");
-		unix_data_deref(upd);
-		return(-ENOMEM);
-	}
 	upd->protocol = protocol;
 	upd->socket = sock;
 	UN_DATA(sock) = upd;
@@ -364,6 +446,7 @@ static int unix_proto_release(struct socket *sock, struct socket *peer)
 
 	if (upd->inode) 
 	{
+		unix_hash_remove(upd);
 		iput(upd->inode);
 		upd->inode = NULL;
 	}
@@ -380,8 +463,8 @@ static int unix_proto_release(struct socket *sock, struct socket *peer)
 
 /*
  *	Bind a name to a socket.
- *	This is where much of the work is done: we allocate a fresh page for
- *	the buffer, grab the appropriate inode and set things up.
+ *	This is where much of the work is done: we grab the appropriate
+ *	inode, hash it for connect() and set things up.
  *
  *	FIXME: what should we do if an address is already bound?
  *	  Here we return EINVAL, but it may be necessary to re-bind.
@@ -431,6 +514,7 @@ static int unix_proto_bind(struct socket *sock, struct sockaddr *umyaddr,
 		return(i);
 	}
 	upd->sockaddr_len = sockaddr_len;	/* now it's legal */
+	unix_hash_insert(upd);
 	
 	return(0);
 }
@@ -609,7 +693,7 @@ static int unix_proto_getname(struct socket *sock, struct sockaddr *usockaddr,
 static int unix_proto_read(struct socket *sock, char *ubuf, int size, int nonblock)
 {
 	struct unix_proto_data *upd;
-	int todo, avail;
+	int todo, avail, done;
 
 	if ((todo = size) <= 0) 
 		return(0);
@@ -623,9 +707,36 @@ static int unix_proto_read(struct socket *sock, char *ubuf, int size, int nonblo
 		}
 		if (nonblock) 
 			return(-EAGAIN);
+
+		/*
+		 *	Tell the writer where we want the data. If one turns
+		 *	up while we sleep it copies straight into ubuf and
+		 *	tells us how much it gave us in rd_done. The writer
+		 *	finds ubuf through our user page tables, so a kernel
+		 *	buffer (read under KERNEL_DS by splice or sendfile)
+		 *	has to wait for the queue.
+		 */
+
+		if (!upd->rd_task && get_fs() == USER_DS)
+		{
+			upd->rd_task = current;
+			upd->rd_buf = ubuf;
+			upd->rd_size = size;
+			upd->rd_done = 0;
+		}
 		sock->flags |= SO_WAITDATA;
 		interruptible_sleep_on(sock->wait);
 		sock->flags &= ~SO_WAITDATA;
+		unix_lock(upd);		/* wait for a handoff in progress */
+		done = 0;
+		if (upd->rd_task == current)
+		{
+			done = upd->rd_done;
+			upd->rd_task = NULL;
+		}
+		unix_unlock(upd);
+		if (done)
+			return(done);
 		if (current->signal & ~current->blocked) 
 		{
 			return(-ERESTARTSYS);
@@ -633,13 +744,14 @@ static int unix_proto_read(struct socket *sock, char *ubuf, int size, int nonblo
 	}
 
 /*
- *	Copy from the read buffer into the user's buffer,
- *	watching for wraparound. Then we wake up the writer.
+ *	Copy from the queue into the user's buffer, a page at a time,
+ *	freeing pages as we finish with them. Then we wake up the writer.
  */
    
 	unix_lock(upd);
 	do 
 	{
+		struct unix_buf *ub;
 		int part, cando;
 
 		if (avail <= 0) 
@@ -649,12 +761,22 @@ static int unix_proto_read(struct socket *sock, char *ubuf, int size, int nonblo
 			return(-EPIPE);
 		}
 
+		ub = upd->q_head;
 		if ((cando = todo) > avail) 
 			cando = avail;
-		if (cando >(part = BUF_SIZE - upd->bp_tail)) 
+		if (cando >(part = UN_PAGE_DATA - upd->q_rd)) 
 			cando = part;
-		memcpy_tofs(ubuf, upd->buf + upd->bp_tail, cando);
-		upd->bp_tail =(upd->bp_tail + cando) &(BUF_SIZE-1);
+		memcpy_tofs(ubuf, UN_BUF_DATA(ub) + upd->q_rd, cando);
+		upd->q_rd += cando;
+		upd->q_len -= cando;
+		if (upd->q_rd == UN_PAGE_DATA && ub->next)
+		{
+			upd->q_head = ub->next;
+			upd->q_rd = 0;
+			free_page((unsigned long) ub);
+		}
+		else if (!upd->q_len)
+			upd->q_rd = upd->q_wr = 0;
 		ubuf += cando;
 		todo -= cando;
 		if (sock->state == SS_CONNECTED)
@@ -670,6 +792,53 @@ static int unix_proto_read(struct socket *sock, char *ubuf, int size, int nonblo
 }
 
 
+/*
+ *	How much we may still queue at our peer: the smaller of its
+ *	receive and our send buffer limits.
+ */
+
+static inline int unix_space(struct unix_proto_data *upd,
+			     struct unix_proto_data *pupd)
+{
+	return(min(pupd->rcvbuf, upd->sndbuf) - pupd->q_len);
+}
+
+
+/*
+ *	The peer is asleep in unix_proto_read() on an empty queue: copy
+ *	straight from our user buffer into its, going through its page
+ *	tables a page at a time, instead of bouncing the data through the
+ *	queue. Called with the peer's data locked, which keeps the reader
+ *	asleep until we are done.
+ */
+
+static int unix_handoff(struct unix_proto_data *pupd, char *ubuf, int size)
+{
+	unsigned long addr = (unsigned long) pupd->rd_buf;
+	unsigned long page;
+	int todo, part;
+
+	if (size > pupd->rd_size)
+		size = pupd->rd_size;
+	todo = size;
+	while (todo)
+	{
+		if (!(page = get_user_page(pupd->rd_task, addr, 1)))
+			break;
+		part = PAGE_SIZE - (addr & ~PAGE_MASK);
+		if (part > todo)
+			part = todo;
+		memcpy_fromfs((char *) page + (addr & ~PAGE_MASK), ubuf, part);
+		free_page(page);
+		addr += part;
+		ubuf += part;
+		todo -= part;
+	}
+	pupd->rd_done = size - todo;
+	return(size - todo);
+}
+
+
 /*
  *	We write to our peer's buf. When we connected we ref'd this
  *	peer so we are safe that the buffer remains, even after the
@@ -678,7 +847,7 @@ static int unix_proto_read(struct socket *sock, char *ubuf, int size, int nonblo
  
 static int unix_proto_write(struct socket *sock, char *ubuf, int size, int nonblock)
 {
-	struct unix_proto_data *pupd;
+	struct unix_proto_data *upd, *pupd;
 	int todo, space;
 
 	if ((todo = size) <= 0)
@@ -692,9 +861,10 @@ static int unix_proto_write(struct socket *sock, char *ubuf, int size, int nonbl
 		}
 		return(-EINVAL);
 	}
-	pupd = UN_DATA(sock)->peerupd;	/* safer than sock->conn */
+	upd = UN_DATA(sock);
+	pupd = upd->peerupd;	/* safer than sock->conn */
 
-	while(!(space = UN_BUF_SPACE(pupd))) 
+	while((space = unix_space(upd, pupd)) <= 0) 
 	{
 		sock->flags |= SO_NOSPACE;
 		if (nonblock) 
@@ -712,23 +882,34 @@ static int unix_proto_write(struct socket *sock, char *ubuf, int size, int nonbl
 		}
 	}
 
-/*
- *	Copy from the user's buffer to the write buffer,
- *	watching for wraparound. Then we wake up the reader.
- */
-   
 	unix_lock(pupd);
 
-	do 
+	/*
+	 *	A reader waiting on an empty queue gets the data directly.
+	 */
+
+	if (pupd->rd_task && !pupd->rd_done && !pupd->q_len)
 	{
-		int part, cando;
+		int done = unix_handoff(pupd, ubuf, todo);
 
-		if (space <= 0) 
+		if (done)
 		{
-			printk("UNIX: write: SPACE IS NEGATIVE!!!\n");
-			send_sig(SIGKILL, current, 1);
-			return(-EPIPE);
+			ubuf += done;
+			todo -= done;
+			wake_up_interruptible(sock->conn->wait);
+			sock_wake_async(sock->conn, 1);
 		}
+	}
+
+/*
+ *	Copy the rest from the user's buffer to the tail of the queue,
+ *	adding pages as we go. Then we wake up the reader.
+ */
+
+	while(todo && (space = unix_space(upd, pupd)) > 0)
+	{
+		struct unix_buf *ub;
+		int part, cando;
 
 		/*
 		 *	We may become disconnected inside this loop, so watch
@@ -741,15 +922,33 @@ static int unix_proto_write(struct socket *sock, char *ubuf, int size, int nonbl
 			unix_unlock(pupd);
 			return(-EPIPE);
 		}
+
+		ub = pupd->q_tail;
+		if (!ub || pupd->q_wr == UN_PAGE_DATA)
+		{
+			ub = (struct unix_buf *) __get_free_page(GFP_KERNEL);
+			if (!ub)
+				break;
+			ub->next = NULL;
+			if (pupd->q_tail)
+				pupd->q_tail->next = ub;
+			else
+			{
+				pupd->q_head = ub;
+				pupd->q_rd = 0;
+			}
+			pupd->q_tail = ub;
+			pupd->q_wr = 0;
+		}
 		
 		if ((cando = todo) > space) 
 			cando = space;
-
-		if (cando >(part = BUF_SIZE - pupd->bp_head))
+		if (cando >(part = UN_PAGE_DATA - pupd->q_wr))
 			cando = part;
 	
-		memcpy_fromfs(pupd->buf + pupd->bp_head, ubuf, cando);
-		pupd->bp_head =(pupd->bp_head + cando) &(BUF_SIZE-1);
+		memcpy_fromfs(UN_BUF_DATA(ub) + pupd->q_wr, ubuf, cando);
+		pupd->q_wr += cando;
+		pupd->q_len += cando;
 		ubuf += cando;
 		todo -= cando;
 		if (sock->state == SS_CONNECTED)
@@ -757,11 +956,11 @@ static int unix_proto_write(struct socket *sock, char *ubuf, int size, int nonbl
 			wake_up_interruptible(sock->conn->wait);
 			sock_wake_async(sock->conn, 1);
 		}
-		space = UN_BUF_SPACE(pupd);
 	}
-	while(todo && space);
 
 	unix_unlock(pupd);
+	if (todo == size)
+		return(-ENOMEM);
 	return(size - todo);
 }
 
@@ -809,7 +1008,7 @@ static int unix_proto_select(struct socket *sock, int sel_type, select_table * w
 			return(1);
 		}
 		peerupd = UN_DATA(sock->conn);
-		if (UN_BUF_SPACE(peerupd) > 0) 
+		if (unix_space(UN_DATA(sock), peerupd) > 0) 
 			return(1);
 		select_wait(sock->wait,wait);
 		return(0);
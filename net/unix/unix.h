@@ -28,6 +28,19 @@
 #ifdef _LINUX_UN_H
 
 
+/*
+ * Data waiting to be read is kept in a queue of pages, each starting with
+ * a small header that links it to the next one.  Pages are allocated by
+ * the writer as the queue grows and freed by the reader as it drains;
+ * the last page is kept for reuse until the socket goes away.
+ */
+struct unix_buf {
+	struct unix_buf	*next;
+};
+
+#define UN_PAGE_DATA		(PAGE_SIZE - sizeof(struct unix_buf))
+#define UN_BUF_DATA(UB)		((char *)((UB) + 1))
+
 struct unix_proto_data {
 	int		refcnt;		/* cnt of reference 0=free	*/
 					/* -1=not initialised	-bgm	*/
@@ -35,10 +48,19 @@ struct unix_proto_data {
 	int		protocol;
 	struct sockaddr_un	sockaddr_un;
 	short		sockaddr_len;	/* >0 if name bound		*/
-	char		*buf;
-	int		bp_head, bp_tail;
+	struct unix_buf	*q_head;	/* page being read from		*/
+	struct unix_buf	*q_tail;	/* page being written to	*/
+	int		q_rd, q_wr;	/* offsets in head and tail page */
+	int		q_len;		/* bytes queued			*/
+	int		rcvbuf;		/* SO_RCVBUF: max bytes queued	*/
+	int		sndbuf;		/* SO_SNDBUF: max we queue at peer */
+	struct task_struct *rd_task;	/* reader blocked for data, and	*/
+	char		*rd_buf;	/* where it wants it		*/
+	int		rd_size;
+	int		rd_done;	/* bytes handed over directly	*/
 	struct inode	*inode;
 	struct unix_proto_data	*peerupd;
+	struct unix_proto_data	*hnext;	/* bound sockets, by inode	*/
 	struct wait_queue *wait;	/* Lock across page faults (FvK) */
 	int		lock_flag;
 };
@@ -54,14 +76,18 @@ extern struct unix_proto_data unix_datas[NSOCKETS_UNIX];
 							->sun_path)
 
 /*
- * Buffer size must be power of 2. buffer mgmt inspired by pipe code.
- * note that buffer contents can wraparound, and we can write one byte less
- * than full size to discern full vs empty.
+ * Buffer limits.  The default lets X clients push a reasonable image
+ * without a context switch every page; SO_RCVBUF/SO_SNDBUF may change
+ * it within [PAGE_SIZE, UN_MAX_BUF].
  */
-#define BUF_SIZE		PAGE_SIZE
-#define UN_BUF_AVAIL(UPD)	(((UPD)->bp_head - (UPD)->bp_tail) & \
-								(BUF_SIZE-1))
-#define UN_BUF_SPACE(UPD)	((BUF_SIZE-1) - UN_BUF_AVAIL(UPD))
+#define UN_DEFAULT_BUF		(4*PAGE_SIZE)
+#define UN_MAX_BUF		(16*PAGE_SIZE)
+#define UN_BUF_AVAIL(UPD)	((UPD)->q_len)
+#define UN_BUF_SPACE(UPD)	((UPD)->rcvbuf - (UPD)->q_len)
+
+#define UN_HASH_SIZE		32
+#define UN_HASH(INODE)		(((unsigned long)(INODE) / sizeof(struct inode)) \
+							% UN_HASH_SIZE)
 
 #endif	/* _LINUX_UN_H */
 